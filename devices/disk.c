@@ -3,10 +3,14 @@
 #include <debug.h>
 #include <stdbool.h>
 #include <stdio.h>
+#include <string.h>
 #include "devices/timer.h"
 #include "threads/io.h"
 #include "threads/interrupt.h"
+#include "threads/palloc.h"
 #include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
 
 /* The code in this file is an interface to an ATA (IDE)
    controller.  It attempts to comply to [ATA-3]. */
@@ -28,10 +32,31 @@
 #define reg_ctl(CHANNEL) ((CHANNEL)->reg_base + 0x206)  /* Control (w/o). */
 #define reg_alt_status(CHANNEL) reg_ctl (CHANNEL)       /* Alt Status (r/o). */
 
+/* Bus master IDE registers, present if a PCI IDE controller
+   capable of bus mastering was found.  They let the controller
+   move data between the disk and memory by itself (DMA) while
+   the CPU runs other threads. */
+#define reg_bm_command(CHANNEL) ((CHANNEL)->bm_base + 0)  /* Command. */
+#define reg_bm_status(CHANNEL) ((CHANNEL)->bm_base + 2)   /* Status. */
+#define reg_bm_prdt(CHANNEL) ((CHANNEL)->bm_base + 4)     /* PRD table. */
+
+/* Bus master Command Register bits. */
+#define BMC_START 0x01          /* Start transfer. */
+#define BMC_READ 0x08           /* Transfer from disk into memory. */
+
+/* Bus master Status Register bits. */
+#define BMS_ERR 0x02            /* Transfer failed. */
+#define BMS_INTR 0x04           /* Disk interrupted. */
+
+/* PCI configuration space ports. */
+#define PCI_CONFIG_ADDR 0xcf8
+#define PCI_CONFIG_DATA 0xcfc
+
 /* Alternate Status Register bits. */
 #define STA_BSY 0x80            /* Busy. */
 #define STA_DRDY 0x40           /* Device Ready. */
 #define STA_DRQ 0x08            /* Data Request. */
+#define STA_ERR 0x01            /* Error. */
 
 /* Control Register bits. */
 #define CTL_SRST 0x04           /* Software Reset. */
@@ -47,6 +72,15 @@
 #define CMD_IDENTIFY_DEVICE 0xec        /* IDENTIFY DEVICE. */
 #define CMD_READ_SECTOR_RETRY 0x20      /* READ SECTOR with retries. */
 #define CMD_WRITE_SECTOR_RETRY 0x30     /* WRITE SECTOR with retries. */
+#define CMD_READ_MULTIPLE 0xc4          /* READ MULTIPLE. */
+#define CMD_WRITE_MULTIPLE 0xc5         /* WRITE MULTIPLE. */
+#define CMD_SET_MULTIPLE_MODE 0xc6      /* SET MULTIPLE MODE. */
+#define CMD_READ_DMA 0xc8               /* READ DMA. */
+#define CMD_WRITE_DMA 0xca              /* WRITE DMA. */
+
+/* Most sectors transferred by one command.  The sector count
+   register is 8 bits wide, and 0 in it means 256. */
+#define CMD_SECTORS_MAX 256
 
 /* An ATA device. */
 struct disk {
@@ -59,8 +93,35 @@ struct disk {
 
 	long long read_cnt;         /* Number of sectors read. */
 	long long write_cnt;        /* Number of sectors written. */
+	long long seek_cnt;         /* Accesses not following the last one. */
+	disk_sector_t next_sector;  /* Sector after the last one accessed. */
+	long long intr_cnt;         /* Number of data transfer interrupts. */
+
+	int multiple;               /* Sectors per interrupt with READ/WRITE
+								   MULTIPLE, or 0 if they are not used. */
+	bool dma;                   /* Does the disk support DMA? */
+	long long dma_cnt;          /* Number of commands done by DMA. */
+	long long merge_cnt;        /* Requests merged into another's command. */
+
+	enum disk_user user;        /* Default user of requests. */
+	struct disk_stats stats;    /* Request statistics, except read_cnt
+								   and write_cnt, which are above. */
 };
 
+/* A physical region descriptor: a piece of memory that a bus
+   master transfer reads or writes.  A transfer works through a
+   table of them. */
+struct prd {
+	uint32_t addr;              /* Physical address, even. */
+	uint16_t size;              /* Size in bytes, 0 meaning 64 kB. */
+	uint16_t flags;             /* PRD_EOT on the last descriptor. */
+};
+#define PRD_EOT 0x8000          /* End of table. */
+
+/* Number of descriptors in one page-sized table, which is plenty
+   for CMD_SECTORS_MAX sectors split at page boundaries. */
+#define PRD_CNT (PGSIZE / sizeof (struct prd))
+
 /* An ATA channel (aka controller).
    Each channel can control up to two disks. */
 struct channel {
@@ -68,11 +129,22 @@ struct channel {
 	uint16_t reg_base;          /* Base I/O port. */
 	uint8_t irq;                /* Interrupt in use. */
 
-	struct lock lock;           /* Must acquire to access the controller. */
 	bool expecting_interrupt;   /* True if an interrupt is expected, false if
 								   any interrupt would be spurious. */
 	struct semaphore completion_wait;   /* Up'd by interrupt handler. */
 
+	/* Request queue.  Changed only with interrupts off. */
+	struct list queue;          /* Requests waiting for a command. */
+	struct semaphore work;      /* Up'd when there may be work to issue. */
+	struct disk_request *active;    /* Requests of the command in progress,
+									   or null if the channel is idle. */
+	size_t cmd_cnt;             /* Sectors the command transfers. */
+	size_t cmd_ofs;             /* Sectors transferred so far by PIO. */
+	bool cmd_dma;               /* Is the command a DMA transfer? */
+
+	uint16_t bm_base;           /* Bus master registers, 0 if none. */
+	struct prd *prdt;           /* PRD table, in its own page. */
+
 	struct disk devices[2];     /* The devices on this channel. */
 };
 
@@ -84,10 +156,13 @@ static void reset_channel (struct channel *);
 static bool check_device_type (struct disk *);
 static void identify_ata_device (struct disk *);
 
-static void select_sector (struct disk *, disk_sector_t);
+static void set_multiple_mode (struct disk *, int cnt);
+static uint16_t find_bus_master (void);
+
+static void select_sector (struct disk *, disk_sector_t, size_t cnt);
 static void issue_pio_command (struct channel *, uint8_t command);
-static void input_sector (struct channel *, void *);
-static void output_sector (struct channel *, const void *);
+static void input_sectors (struct channel *, void *, size_t cnt);
+static void output_sectors (struct channel *, const void *, size_t cnt);
 
 static void wait_until_idle (const struct disk *);
 static bool wait_while_busy (const struct disk *);
@@ -95,10 +170,12 @@ static void select_device (const struct disk *);
 static void select_device_wait (const struct disk *);
 
 static void interrupt_handler (struct intr_frame *);
+static void channel_thread (void *);
 
 /* Initialize the disk subsystem and detect disks. */
 void
 disk_init (void) {
+	uint16_t bm_base = find_bus_master ();
 	size_t chan_no;
 
 	for (chan_no = 0; chan_no < CHANNEL_CNT; chan_no++) {
@@ -119,9 +196,20 @@ disk_init (void) {
 			default:
 				NOT_REACHED ();
 		}
-		lock_init (&c->lock);
 		c->expecting_interrupt = false;
 		sema_init (&c->completion_wait, 0);
+		list_init (&c->queue);
+		sema_init (&c->work, 0);
+		c->active = NULL;
+
+		/* Each channel has its own 8 bus master registers. */
+		c->bm_base = 0;
+		c->prdt = NULL;
+		if (bm_base != 0) {
+			c->prdt = palloc_get_page (0);
+			if (c->prdt != NULL)
+				c->bm_base = bm_base + 8 * chan_no;
+		}
 
 		/* Initialize devices. */
 		for (dev_no = 0; dev_no < 2; dev_no++) {
@@ -134,6 +222,15 @@ disk_init (void) {
 			d->capacity = 0;
 
 			d->read_cnt = d->write_cnt = 0;
+			d->seek_cnt = 0;
+			d->next_sector = 0;
+			d->intr_cnt = 0;
+			d->multiple = 0;
+			d->dma = false;
+			d->dma_cnt = 0;
+			d->merge_cnt = 0;
+			d->user = DISK_USER_OTHER;
+			memset (&d->stats, 0, sizeof d->stats);
 		}
 
 		/* Register interrupt handler. */
@@ -150,12 +247,19 @@ disk_init (void) {
 		for (dev_no = 0; dev_no < 2; dev_no++)
 			if (c->devices[dev_no].is_ata)
 				identify_ata_device (&c->devices[dev_no]);
+
+		/* Start issuing requests. */
+		if ((c->devices[0].is_ata || c->devices[1].is_ata)
+				&& thread_create (c->name, PRI_MAX, channel_thread, c) == TID_ERROR)
+			PANIC ("%s: cannot start request thread", c->name);
 	}
 
 	/* DO NOT MODIFY BELOW LINES. */
 	register_disk_inspect_intr ();
 }
 
+static void print_disk_stats (struct disk *);
+
 /* Prints disk statistics. */
 void
 disk_print_stats (void) {
@@ -166,13 +270,77 @@ disk_print_stats (void) {
 
 		for (dev_no = 0; dev_no < 2; dev_no++) {
 			struct disk *d = disk_get (chan_no, dev_no);
-			if (d != NULL && d->is_ata)
-				printf ("%s: %lld reads, %lld writes\n",
-						d->name, d->read_cnt, d->write_cnt);
+			long long per_intr;
+
+			if (d == NULL || !d->is_ata)
+				continue;
+			/* Sectors moved per interrupt, in tenths. */
+			per_intr = (d->intr_cnt > 0
+					? (d->read_cnt + d->write_cnt) * 10 / d->intr_cnt : 0);
+			printf ("%s: %lld reads, %lld writes, %lld seeks, "
+					"%lld.%lld sectors/interrupt, %lld DMA commands, "
+					"%lld merges\n",
+					d->name, d->read_cnt, d->write_cnt, d->seek_cnt,
+					per_intr / 10, per_intr % 10, d->dma_cnt, d->merge_cnt);
+			print_disk_stats (d);
 		}
 	}
 }
 
+/* Prints the request statistics of disk D, if it served any: the
+   queue depth, the latency histogram, and the requests, bytes and
+   ticks of each user. */
+static void
+print_disk_stats (struct disk *d) {
+	static const char *user_names[DISK_USER_CNT] = {
+		"other", "fs", "swap", "fat",
+	};
+	struct disk_stats st;
+	long long depth;
+	int i;
+
+	disk_get_stats (d, &st);
+	if (st.request_cnt == 0)
+		return;
+
+	/* Average depth, in tenths. */
+	depth = st.depth_sum * 10 / st.request_cnt;
+	printf ("%s: %lld requests, %lld.%lld average depth, %d max depth\n",
+			d->name, st.request_cnt, depth / 10, depth % 10, st.max_in_flight);
+
+	printf ("%s: latency in ticks:", d->name);
+	for (i = 0; i < DISK_LATENCY_BUCKETS; i++)
+		if (st.latency[i] > 0) {
+			if (i == 0)
+				printf (" 0:%lld", st.latency[i]);
+			else if (i == DISK_LATENCY_BUCKETS - 1)
+				printf (" %d+:%lld", 1 << (i - 1), st.latency[i]);
+			else
+				printf (" %d-%d:%lld", 1 << (i - 1), (1 << i) - 1, st.latency[i]);
+		}
+	printf ("\n");
+
+	for (i = 0; i < DISK_USER_CNT; i++)
+		if (st.user_requests[i] > 0)
+			printf ("%s: %s: %lld requests, %lld bytes, %lld ticks\n", d->name,
+					user_names[i], st.user_requests[i], st.user_bytes[i],
+					st.user_ticks[i]);
+}
+
+/* Copies the statistics of disk D into STATS. */
+void
+disk_get_stats (struct disk *d, struct disk_stats *stats) {
+	enum intr_level old_level;
+
+	ASSERT (d != NULL);
+
+	old_level = intr_disable ();
+	*stats = d->stats;
+	stats->read_cnt = d->read_cnt;
+	stats->write_cnt = d->write_cnt;
+	intr_set_level (old_level);
+}
+
 /* Returns the disk numbered DEV_NO--either 0 or 1 for master or
    slave, respectively--within the channel numbered CHAN_NO.
 
@@ -203,27 +371,23 @@ disk_size (struct disk *d) {
 	return d->capacity;
 }
 
+/* Counts the requests of disk D that do not say otherwise as
+   USER's in the statistics. */
+void
+disk_set_user (struct disk *d, enum disk_user user) {
+	ASSERT (d != NULL);
+	ASSERT (user < DISK_USER_CNT);
+
+	d->user = user;
+}
+
 /* Reads sector SEC_NO from disk D into BUFFER, which must have
    room for DISK_SECTOR_SIZE bytes.
    Internally synchronizes accesses to disks, so external
    per-disk locking is unneeded. */
 void
 disk_read (struct disk *d, disk_sector_t sec_no, void *buffer) {
-	struct channel *c;
-
-	ASSERT (d != NULL);
-	ASSERT (buffer != NULL);
-
-	c = d->channel;
-	lock_acquire (&c->lock);
-	select_sector (d, sec_no);
-	issue_pio_command (c, CMD_READ_SECTOR_RETRY);
-	sema_down (&c->completion_wait);
-	if (!wait_while_busy (d))
-		PANIC ("%s: disk read failed, sector=%"PRDSNu, d->name, sec_no);
-	input_sector (c, buffer);
-	d->read_cnt++;
-	lock_release (&c->lock);
+	disk_read_multiple (d, sec_no, buffer, 1);
 }
 
 /* Write sector SEC_NO to disk D from BUFFER, which must contain
@@ -233,23 +397,515 @@ disk_read (struct disk *d, disk_sector_t sec_no, void *buffer) {
    per-disk locking is unneeded. */
 void
 disk_write (struct disk *d, disk_sector_t sec_no, const void *buffer) {
-	struct channel *c;
+	disk_write_multiple (d, sec_no, buffer, 1);
+}
+
+/* Reads the CNT sectors starting at SEC_NO from disk D into
+   BUFFER, which must be in kernel memory and have room for CNT *
+   DISK_SECTOR_SIZE bytes.  Waits for the request to be done.
+   Internally synchronizes accesses to disks, so external
+   per-disk locking is unneeded. */
+void
+disk_read_multiple (struct disk *d, disk_sector_t sec_no, void *buffer,
+		size_t cnt) {
+	struct disk_request r;
+
+	if (cnt == 0)
+		return;
+	disk_request_init (&r, d, sec_no, buffer, cnt, false);
+	disk_submit (&r, NULL, NULL);
+	disk_wait (&r);
+}
+
+/* Writes the CNT sectors starting at SEC_NO on disk D from
+   BUFFER, which must be in kernel memory and contain CNT *
+   DISK_SECTOR_SIZE bytes.  Returns after the disk has
+   acknowledged receiving the data.
+   Internally synchronizes accesses to disks, so external
+   per-disk locking is unneeded. */
+void
+disk_write_multiple (struct disk *d, disk_sector_t sec_no,
+		const void *buffer, size_t cnt) {
+	struct disk_request r;
 
+	if (cnt == 0)
+		return;
+	disk_request_init (&r, d, sec_no, (void *) buffer, cnt, true);
+	disk_submit (&r, NULL, NULL);
+	disk_wait (&r);
+}
+
+/* Block request queue.
+
+   Each channel queues the requests submitted for its disks and
+   has a thread that issues them to the controller, one command
+   at a time.  The interrupt handler moves the data of a PIO
+   command block by block, finishes each command once its data is
+   through, completes the requests it served, and wakes the thread
+   to issue the next one.
+
+   The thread serves requests in one sweep toward higher sector
+   numbers, starting over from the lowest when none is left ahead
+   (C-LOOK), so that the disk seeks little, unless one has waited
+   past its deadline.  Requests that continue the one picked, on
+   the same disk and in the same direction, go into its command. */
+
+/* Ticks a read or a write may wait before it is served out of
+   sweep order.  Reads have someone waiting for them. */
+#define READ_DEADLINE (TIMER_FREQ / 2)
+#define WRITE_DEADLINE (5 * TIMER_FREQ)
+
+/* Initializes R as a request to read, or to write if WRITE is
+   true, the CNT sectors starting at SEC_NO on disk D into or from
+   BUFFER.  BUFFER must be in kernel memory, since the transfer
+   may happen while another process runs, and hold CNT *
+   DISK_SECTOR_SIZE bytes.  The request counts as the default user
+   of D's, which may be changed in R's USER member before
+   submitting it. */
+void
+disk_request_init (struct disk_request *r, struct disk *d,
+		disk_sector_t sec_no, void *buffer, size_t cnt, bool write) {
+	ASSERT (r != NULL);
 	ASSERT (d != NULL);
-	ASSERT (buffer != NULL);
-
-	c = d->channel;
-	lock_acquire (&c->lock);
-	select_sector (d, sec_no);
-	issue_pio_command (c, CMD_WRITE_SECTOR_RETRY);
-	if (!wait_while_busy (d))
-		PANIC ("%s: disk write failed, sector=%"PRDSNu, d->name, sec_no);
-	output_sector (c, buffer);
-	sema_down (&c->completion_wait);
-	d->write_cnt++;
-	lock_release (&c->lock);
+	ASSERT (buffer != NULL && is_kernel_vaddr (buffer));
+	ASSERT (cnt > 0);
+
+	r->disk = d;
+	r->sector = sec_no;
+	r->buffer = buffer;
+	r->cnt = cnt;
+	r->write = write;
+	r->complete = NULL;
+	r->aux = NULL;
+	r->user = d->user;
+	r->done_cnt = 0;
+	r->next = NULL;
+	sema_init (&r->finished, 0);
 }
-
+
+/* Queues request R, initialized by disk_request_init(), and
+   returns without waiting for it.  Once R is done, disk_wait(R)
+   returns and COMPLETE, if not null, is called with R and AUX.
+   COMPLETE runs in the disk interrupt handler, so it must not
+   sleep.  R and its buffer must stay valid until then. */
+void
+disk_submit (struct disk_request *r, disk_request_func *complete,
+		void *aux) {
+	struct channel *c = r->disk->channel;
+	struct disk_stats *st = &r->disk->stats;
+	enum intr_level old_level;
+
+	r->complete = complete;
+	r->aux = aux;
+	r->submitted = timer_ticks ();
+	r->deadline = r->submitted
+		+ (r->write ? WRITE_DEADLINE : READ_DEADLINE);
+
+	old_level = intr_disable ();
+	list_push_back (&c->queue, &r->elem);
+	st->in_flight++;
+	st->in_flight_bytes += r->cnt * DISK_SECTOR_SIZE;
+	st->depth_sum += st->in_flight;
+	if (st->in_flight > st->max_in_flight)
+		st->max_in_flight = st->in_flight;
+	intr_set_level (old_level);
+	sema_up (&c->work);
+}
+
+/* Waits until request R, queued by disk_submit(), is done.  At
+   most one thread may wait for R, once. */
+void
+disk_wait (struct disk_request *r) {
+	sema_down (&r->finished);
+}
+
+/* Returns the first sector of R that is not transferred yet. */
+static disk_sector_t
+request_position (const struct disk_request *r) {
+	return r->sector + r->done_cnt;
+}
+
+/* Returns the number of sectors that disk D transfers per data
+   interrupt. */
+static size_t
+block_size (const struct disk *d) {
+	return d->multiple > 1 ? d->multiple : 1;
+}
+
+/* Chains to R the requests in channel C's queue that continue it
+   on the same disk in the same direction, removing them from the
+   queue, as long as all of them fit in one command.  The caller
+   must have interrupts off. */
+static void
+merge_requests (struct channel *c, struct disk_request *r) {
+	struct disk_request *last = r;
+	size_t cnt = r->cnt - r->done_cnt;
+
+	r->next = NULL;
+	while (cnt < CMD_SECTORS_MAX) {
+		struct disk_request *q = NULL;
+		struct list_elem *e;
+
+		for (e = list_begin (&c->queue); e != list_end (&c->queue);
+				e = list_next (e)) {
+			struct disk_request *cand = list_entry (e, struct disk_request,
+					elem);
+
+			if (cand->disk == r->disk && cand->write == r->write
+					&& cand->done_cnt == 0
+					&& cand->sector == last->sector + last->cnt
+					&& cnt + cand->cnt <= CMD_SECTORS_MAX) {
+				q = cand;
+				break;
+			}
+		}
+		if (q == NULL)
+			break;
+
+		list_remove (&q->elem);
+		q->next = NULL;
+		last->next = q;
+		last = q;
+		cnt += q->cnt;
+		r->disk->merge_cnt++;
+	}
+}
+
+/* Removes the request to serve next from channel C's queue, with
+   the requests merged into it, and returns it.  That is the one
+   furthest past its deadline, if any is, and otherwise the next
+   one in the sweep.  The caller must have interrupts off and C's
+   queue must not be empty. */
+static struct disk_request *
+pick_request (struct channel *c) {
+	int64_t now = timer_ticks ();
+	struct disk_request *late = NULL, *ahead = NULL, *lowest = NULL;
+	struct disk_request *r;
+	struct list_elem *e;
+
+	ASSERT (!list_empty (&c->queue));
+
+	for (e = list_begin (&c->queue); e != list_end (&c->queue);
+			e = list_next (e)) {
+		struct disk_request *q = list_entry (e, struct disk_request, elem);
+		disk_sector_t pos = request_position (q);
+
+		if (q->deadline <= now
+				&& (late == NULL || q->deadline < late->deadline))
+			late = q;
+		if (pos >= q->disk->next_sector
+				&& (ahead == NULL || pos < request_position (ahead)))
+			ahead = q;
+		if (lowest == NULL || pos < request_position (lowest))
+			lowest = q;
+	}
+	r = late != NULL ? late : ahead != NULL ? ahead : lowest;
+	list_remove (&r->elem);
+	merge_requests (c, r);
+	return r;
+}
+
+/* Returns where sector number I of channel C's command is in
+   memory. */
+static uint8_t *
+command_buffer (struct channel *c, size_t i) {
+	struct disk_request *r = c->active;
+	size_t ofs = r->done_cnt + i;
+
+	while (ofs >= r->cnt) {
+		ofs -= r->cnt;
+		r = r->next;
+	}
+	return (uint8_t *) r->buffer + ofs * DISK_SECTOR_SIZE;
+}
+
+/* Moves the next block of channel C's PIO command through the
+   data register. */
+static void
+transfer_block (struct channel *c) {
+	struct disk_request *r = c->active;
+	size_t n = c->cmd_cnt - c->cmd_ofs;
+	size_t i;
+
+	if (n > block_size (r->disk))
+		n = block_size (r->disk);
+	for (i = 0; i < n; i++)
+		if (r->write)
+			output_sectors (c, command_buffer (c, c->cmd_ofs + i), 1);
+		else
+			input_sectors (c, command_buffer (c, c->cmd_ofs + i), 1);
+	c->cmd_ofs += n;
+}
+
+static void build_prdt (struct channel *);
+
+/* Issues one command on channel C for request R and the requests
+   merged into it.  The command transfers them all, or as much of R
+   as one command can.  By DMA, if the disk supports it, the
+   controller moves the data by itself; otherwise the interrupt
+   handler moves it by PIO. */
+static void
+issue_request (struct channel *c, struct disk_request *r) {
+	struct disk *d = r->disk;
+	struct disk_request *q;
+	size_t cnt = 0;
+	bool dma = d->dma;
+
+	/* A bus master needs even addresses. */
+	for (q = r; q != NULL; q = q->next) {
+		cnt += q->cnt - q->done_cnt;
+		if (((uintptr_t) q->buffer & 1) != 0)
+			dma = false;
+	}
+	if (cnt > CMD_SECTORS_MAX)
+		cnt = CMD_SECTORS_MAX;
+
+	c->active = r;
+	c->cmd_cnt = cnt;
+	c->cmd_ofs = 0;
+	c->cmd_dma = dma;
+
+	select_sector (d, request_position (r), cnt);
+	if (dma) {
+		uint8_t direction = r->write ? 0 : BMC_READ;
+
+		build_prdt (c);
+		outl (reg_bm_prdt (c), vtop (c->prdt));
+		outb (reg_bm_command (c), direction);
+		outb (reg_bm_status (c), BMS_ERR | BMS_INTR);   /* Clear old state. */
+		issue_pio_command (c, r->write ? CMD_WRITE_DMA : CMD_READ_DMA);
+		outb (reg_bm_command (c), direction | BMC_START);
+		d->dma_cnt++;
+	} else if (!r->write)
+		issue_pio_command (c, d->multiple > 1
+				? CMD_READ_MULTIPLE : CMD_READ_SECTOR_RETRY);
+	else {
+		enum intr_level old_level;
+
+		issue_pio_command (c, d->multiple > 1
+				? CMD_WRITE_MULTIPLE : CMD_WRITE_SECTOR_RETRY);
+		if (!wait_while_busy (d))
+			PANIC ("%s: disk write failed, sector=%"PRDSNu, d->name,
+					request_position (r));
+
+		/* The disk interrupts once it has taken the first block, and
+		   the handler sends the others. */
+		old_level = intr_disable ();
+		transfer_block (c);
+		intr_set_level (old_level);
+	}
+}
+
+/* Returns the latency histogram bucket for a request that took
+   TICKS ticks. */
+static int
+latency_bucket (int64_t ticks) {
+	int bucket = 0;
+
+	while (ticks > 0 && bucket < DISK_LATENCY_BUCKETS - 1) {
+		ticks >>= 1;
+		bucket++;
+	}
+	return bucket;
+}
+
+/* Completes request R: counts it in its disk's statistics, wakes
+   its waiter and calls its completion function.  R may be gone
+   afterward. */
+static void
+complete_request (struct disk_request *r) {
+	struct disk_stats *st = &r->disk->stats;
+	disk_request_func *complete = r->complete;
+	void *aux = r->aux;
+	int64_t ticks = timer_elapsed (r->submitted);
+
+	st->in_flight--;
+	st->in_flight_bytes -= r->cnt * DISK_SECTOR_SIZE;
+	st->request_cnt++;
+	st->latency[latency_bucket (ticks)]++;
+	st->user_requests[r->user]++;
+	st->user_bytes[r->user] += r->cnt * DISK_SECTOR_SIZE;
+	st->user_ticks[r->user] += ticks;
+
+	sema_up (&r->finished);
+	if (complete != NULL)
+		complete (r, aux);
+}
+
+/* Credits the sectors of channel C's finished command to its
+   requests, completes the ones that are done, puts back one that
+   is not, and wakes C's thread to issue the next command. */
+static void
+finish_command (struct channel *c) {
+	struct disk_request *r = c->active;
+	struct disk *d = r->disk;
+	size_t cnt = c->cmd_cnt;
+
+	if (r->write)
+		d->write_cnt += cnt;
+	else
+		d->read_cnt += cnt;
+
+	c->active = NULL;
+	while (r != NULL) {
+		struct disk_request *next = r->next;
+		size_t n = r->cnt - r->done_cnt;
+
+		if (n > cnt)
+			n = cnt;
+		r->done_cnt += n;
+		cnt -= n;
+		if (r->done_cnt < r->cnt)
+			list_push_front (&c->queue, &r->elem);
+		else
+			complete_request (r);
+		r = next;
+	}
+	sema_up (&c->work);
+}
+
+/* Handles an interrupt for channel C's command in progress.
+   Moves the next block of a PIO command, or finishes the command
+   once all of its data has gone through. */
+static void
+service_interrupt (struct channel *c) {
+	struct disk_request *r = c->active;
+	struct disk *d = r->disk;
+	uint8_t bm_status = 0;
+	uint8_t status;
+
+	d->intr_cnt++;
+	if (c->cmd_dma) {
+		outb (reg_bm_command (c), 0);
+		bm_status = inb (reg_bm_status (c));
+		outb (reg_bm_status (c), BMS_ERR | BMS_INTR);
+	}
+	status = inb (reg_status (c));          /* Acknowledge interrupt. */
+	if ((bm_status & BMS_ERR) != 0 || (status & STA_ERR) != 0)
+		PANIC ("%s: disk %s failed, sector=%"PRDSNu, d->name,
+				r->write ? "write" : "read", request_position (r));
+
+	if (!c->cmd_dma && (!r->write || c->cmd_ofs < c->cmd_cnt)) {
+		/* A read interrupts when a block is ready, a write when it
+		   is ready for the next one. */
+		if ((status & STA_DRQ) == 0)
+			PANIC ("%s: disk %s failed, sector=%"PRDSNu, d->name,
+					r->write ? "write" : "read", request_position (r));
+		transfer_block (c);
+		if (r->write || c->cmd_ofs < c->cmd_cnt)
+			return;
+	}
+	finish_command (c);
+}
+
+/* Issues the requests queued on channel C_, one command at a
+   time, as the interrupt handler finishes the previous one. */
+static void
+channel_thread (void *c_) {
+	struct channel *c = c_;
+
+	for (;;) {
+		struct disk_request *r = NULL;
+		enum intr_level old_level;
+
+		sema_down (&c->work);
+		old_level = intr_disable ();
+		if (c->active == NULL && !list_empty (&c->queue))
+			r = pick_request (c);
+		intr_set_level (old_level);
+		if (r != NULL)
+			issue_request (c, r);
+	}
+}
+
+/* Bus master DMA. */
+
+/* Returns the 32-bit register at byte offset REG in the PCI
+   configuration space of function FUNC of device DEV on bus 0. */
+static uint32_t
+pci_read_config (int dev, int func, int reg) {
+	outl (PCI_CONFIG_ADDR, 0x80000000u | dev << 11 | func << 8 | reg);
+	return inl (PCI_CONFIG_DATA);
+}
+
+/* Writes VALUE to the 32-bit register at byte offset REG in the
+   PCI configuration space of function FUNC of device DEV on
+   bus 0. */
+static void
+pci_write_config (int dev, int func, int reg, uint32_t value) {
+	outl (PCI_CONFIG_ADDR, 0x80000000u | dev << 11 | func << 8 | reg);
+	outl (PCI_CONFIG_DATA, value);
+}
+
+/* Looks on PCI bus 0 for an IDE controller that can act as a bus
+   master.  If there is one, enables bus mastering on it and
+   returns the base I/O port of its bus master registers.
+   Otherwise returns 0, and disks are accessed by PIO only. */
+static uint16_t
+find_bus_master (void) {
+	int dev, func;
+
+	for (dev = 0; dev < 32; dev++)
+		for (func = 0; func < 8; func++) {
+			uint32_t class, bar4;
+
+			if ((pci_read_config (dev, func, 0x00) & 0xffff) == 0xffff)
+				continue;
+
+			/* Class 1, subclass 1 is an IDE controller.  Bit 7 of its
+			   programming interface says it can be a bus master. */
+			class = pci_read_config (dev, func, 0x08);
+			if ((class >> 16) != 0x0101 || (class & 0x8000) == 0)
+				continue;
+
+			/* BAR 4 holds the bus master registers, in I/O space. */
+			bar4 = pci_read_config (dev, func, 0x20);
+			if ((bar4 & 1) == 0 || (bar4 & 0xfffc) == 0)
+				continue;
+
+			/* Enable I/O space access and bus mastering. */
+			pci_write_config (dev, func, 0x04,
+					(pci_read_config (dev, func, 0x04) & 0xffff) | 0x05);
+			return bar4 & 0xfffc;
+		}
+	return 0;
+}
+
+/* Fills in the PRD table of channel C to describe the memory of
+   its command, one descriptor per page touched, since a
+   descriptor must not cross a 64 kB boundary. */
+static void
+build_prdt (struct channel *c) {
+	struct disk_request *r;
+	size_t left = c->cmd_cnt * DISK_SECTOR_SIZE;
+	size_t i = 0;
+
+	for (r = c->active; left > 0; r = r->next) {
+		const uint8_t *p = (uint8_t *) r->buffer
+			+ r->done_cnt * DISK_SECTOR_SIZE;
+		size_t size = (r->cnt - r->done_cnt) * DISK_SECTOR_SIZE;
+
+		if (size > left)
+			size = left;
+		left -= size;
+		while (size > 0) {
+			size_t chunk = PGSIZE - pg_ofs (p);
+
+			if (chunk > size)
+				chunk = size;
+			ASSERT (i < PRD_CNT);
+			ASSERT (vtop (p) + chunk <= UINT32_MAX);
+			c->prdt[i].addr = vtop (p);
+			c->prdt[i].size = chunk;
+			c->prdt[i].flags = 0;
+			p += chunk;
+			size -= chunk;
+			i++;
+		}
+	}
+	c->prdt[i - 1].flags = PRD_EOT;
+}
+
 /* Disk detection and identification. */
 
 static void print_ata_string (char *string, size_t size);
@@ -359,11 +1015,18 @@ identify_ata_device (struct disk *d) {
 		d->is_ata = false;
 		return;
 	}
-	input_sector (c, id);
+	input_sectors (c, id, 1);
 
 	/* Calculate capacity. */
 	d->capacity = id[60] | ((uint32_t) id[61] << 16);
 
+	/* Use DMA if the disk supports it and there is a bus master. */
+	d->dma = (id[49] & 0x0100) != 0 && c->bm_base != 0;
+
+	/* Transfer as many sectors per interrupt as the disk can. */
+	if ((id[47] & 0xff) > 1)
+		set_multiple_mode (d, id[47] & 0xff);
+
 	/* Print identification message. */
 	printf ("%s: detected %'"PRDSNu" sector (", d->name, d->capacity);
 	if (d->capacity > 1024 / DISK_SECTOR_SIZE * 1024 * 1024)
@@ -382,6 +1045,22 @@ identify_ata_device (struct disk *d) {
 	printf ("\"\n");
 }
 
+/* Makes disk D transfer CNT sectors per interrupt with READ
+   MULTIPLE and WRITE MULTIPLE.  Leaves D using READ SECTOR and
+   WRITE SECTOR, one sector per interrupt, if it refuses. */
+static void
+set_multiple_mode (struct disk *d, int cnt) {
+	struct channel *c = d->channel;
+
+	select_device_wait (d);
+	outb (reg_nsect (c), cnt);
+	issue_pio_command (c, CMD_SET_MULTIPLE_MODE);
+	sema_down (&c->completion_wait);
+	wait_while_busy (d);
+	if ((inb (reg_alt_status (c)) & STA_ERR) == 0)
+		d->multiple = cnt;
+}
+
 /* Prints STRING, which consists of SIZE bytes in a funky format:
    each pair of bytes is in reverse order.  Does not print
    trailing whitespace and/or nulls. */
@@ -402,17 +1081,24 @@ print_ata_string (char *string, size_t size) {
 }
 
 /* Selects device D, waiting for it to become ready, and then
-   writes SEC_NO to the disk's sector selection registers.  (We
-   use LBA mode.) */
+   writes SEC_NO to the disk's sector selection registers and CNT,
+   between 1 and CMD_SECTORS_MAX, to its sector count register.
+   (We use LBA mode.) */
 static void
-select_sector (struct disk *d, disk_sector_t sec_no) {
+select_sector (struct disk *d, disk_sector_t sec_no, size_t cnt) {
 	struct channel *c = d->channel;
 
-	ASSERT (sec_no < d->capacity);
-	ASSERT (sec_no < (1UL << 28));
+	ASSERT (cnt >= 1 && cnt <= CMD_SECTORS_MAX);
+	ASSERT (sec_no + cnt <= d->capacity);
+	ASSERT (sec_no + cnt <= (1UL << 28));
+
+	/* Count the accesses that a real disk would have to seek for. */
+	if (sec_no != d->next_sector)
+		d->seek_cnt++;
+	d->next_sector = sec_no + cnt;
 
 	select_device_wait (d);
-	outb (reg_nsect (c), 1);
+	outb (reg_nsect (c), cnt % CMD_SECTORS_MAX);
 	outb (reg_lbal (c), sec_no);
 	outb (reg_lbam (c), sec_no >> 8);
 	outb (reg_lbah (c), (sec_no >> 16));
@@ -432,18 +1118,19 @@ issue_pio_command (struct channel *c, uint8_t command) {
 	outb (reg_command (c), command);
 }
 
-/* Reads a sector from channel C's data register in PIO mode into
-   SECTOR, which must have room for DISK_SECTOR_SIZE bytes. */
+/* Reads CNT sectors from channel C's data register in PIO mode
+   into SECTORS, which must have room for CNT * DISK_SECTOR_SIZE
+   bytes. */
 static void
-input_sector (struct channel *c, void *sector) {
-	insw (reg_data (c), sector, DISK_SECTOR_SIZE / 2);
+input_sectors (struct channel *c, void *sectors, size_t cnt) {
+	insw (reg_data (c), sectors, cnt * DISK_SECTOR_SIZE / 2);
 }
 
-/* Writes SECTOR to channel C's data register in PIO mode.
-   SECTOR must contain DISK_SECTOR_SIZE bytes. */
+/* Writes CNT sectors from SECTORS to channel C's data register in
+   PIO mode.  SECTORS must contain CNT * DISK_SECTOR_SIZE bytes. */
 static void
-output_sector (struct channel *c, const void *sector) {
-	outsw (reg_data (c), sector, DISK_SECTOR_SIZE / 2);
+output_sectors (struct channel *c, const void *sectors, size_t cnt) {
+	outsw (reg_data (c), sectors, cnt * DISK_SECTOR_SIZE / 2);
 }
 
 /* Low-level ATA primitives. */
@@ -518,7 +1205,9 @@ interrupt_handler (struct intr_frame *f) {
 
 	for (c = channels; c < channels + CHANNEL_CNT; c++)
 		if (f->vec_no == c->irq) {
-			if (c->expecting_interrupt) {
+			if (c->active != NULL)
+				service_interrupt (c);
+			else if (c->expecting_interrupt) {
 				inb (reg_status (c));               /* Acknowledge interrupt. */
 				sema_up (&c->completion_wait);      /* Wake up waiter. */
 			} else
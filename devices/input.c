@@ -1,40 +1,109 @@
 #include "devices/input.h"
 #include <debug.h>
-#include "devices/intq.h"
+#include <string.h>
 #include "devices/serial.h"
+#include "threads/interrupt.h"
+#include "threads/synch.h"
 
-/* Stores keys from the keyboard and serial port. */
-static struct intq buffer;
+/* Keys from the keyboard and serial port, in a ring buffer large
+   enough to hold input pasted or piped in faster than programs
+   read it.  HEAD and TAIL count the bytes ever added and removed,
+   so HEAD - TAIL are buffered.  Changed only with interrupts off. */
+#define INPUT_BUF_SIZE 4096
+static uint8_t buffer[INPUT_BUF_SIZE];
+static size_t head, tail;
+
+/* Readers take turns, so that each line goes to one of them. */
+static struct lock read_lock;
+
+/* Whether the reader holding READ_LOCK waits for input, and the
+   semaphore it waits on, up'd when a key arrives. */
+static bool reader_waiting;
+static struct semaphore input_ready;
+
+/* Bytes input_read() moves out of BUFFER at a time with interrupts
+   off. */
+#define READ_CHUNK 64
 
 /* Initializes the input buffer. */
 void
 input_init (void) {
-	intq_init (&buffer);
+	head = tail = 0;
+	lock_init (&read_lock);
+	reader_waiting = false;
+	sema_init (&input_ready, 0);
 }
 
 /* Adds a key to the input buffer.
-   Interrupts must be off and the buffer must not be full. */
+   Interrupts must be off and the buffer must not be full.
+
+   This is the line discipline: the carriage return that Enter
+   sends, from the keyboard and from most terminals, becomes a
+   new-line. */
 void
 input_putc (uint8_t key) {
 	ASSERT (intr_get_level () == INTR_OFF);
-	ASSERT (!intq_full (&buffer));
+	ASSERT (!input_full ());
 
-	intq_putc (&buffer, key);
+	if (key == '\r')
+		key = '\n';
+	buffer[head++ % INPUT_BUF_SIZE] = key;
+	if (reader_waiting) {
+		reader_waiting = false;
+		sema_up (&input_ready);
+	}
 	serial_notify ();
 }
 
+/* Reads up to SIZE bytes of input into DST and returns the number
+   read.  Waits until at least one byte is available, then returns
+   what is buffered, but no more than one line, whose new-line is
+   included.  DST may be in user memory. */
+size_t
+input_read (void *dst_, size_t size) {
+	uint8_t *dst = dst_;
+	size_t cnt = 0;
+	bool more = size > 0;
+
+	ASSERT (!intr_context ());
+
+	lock_acquire (&read_lock);
+	while (more) {
+		uint8_t chunk[READ_CHUNK];
+		enum intr_level old_level;
+		size_t n = 0;
+
+		old_level = intr_disable ();
+		while (cnt == 0 && head == tail) {
+			reader_waiting = true;
+			sema_down (&input_ready);
+		}
+		while (n < READ_CHUNK && cnt + n < size && head != tail) {
+			chunk[n] = buffer[tail++ % INPUT_BUF_SIZE];
+			if (chunk[n++] == '\n')
+				break;
+		}
+		more = (n == 0 || chunk[n - 1] != '\n') && cnt + n < size
+			&& head != tail;
+		serial_notify ();
+		intr_set_level (old_level);
+
+		/* With interrupts on, since DST may have to be paged in. */
+		memcpy (dst + cnt, chunk, n);
+		cnt += n;
+	}
+	lock_release (&read_lock);
+
+	return cnt;
+}
+
 /* Retrieves a key from the input buffer.
    If the buffer is empty, waits for a key to be pressed. */
 uint8_t
 input_getc (void) {
-	enum intr_level old_level;
 	uint8_t key;
 
-	old_level = intr_disable ();
-	key = intq_getc (&buffer);
-	serial_notify ();
-	intr_set_level (old_level);
-
+	input_read (&key, 1);
 	return key;
 }
 
@@ -44,5 +113,5 @@ input_getc (void) {
 bool
 input_full (void) {
 	ASSERT (intr_get_level () == INTR_OFF);
-	return intq_full (&buffer);
+	return head - tail == INPUT_BUF_SIZE;
 }
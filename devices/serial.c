@@ -1,7 +1,6 @@
 #include "devices/serial.h"
 #include <debug.h>
 #include "devices/input.h"
-#include "devices/intq.h"
 #include "devices/timer.h"
 #include "threads/io.h"
 #include "threads/interrupt.h"
@@ -37,6 +36,15 @@
 #define IER_RECV 0x01           /* Interrupt when data received. */
 #define IER_XMIT 0x02           /* Interrupt when transmit finishes. */
 
+/* FIFO Control Register bits. */
+#define FCR_ENABLE 0x01         /* Enable the FIFOs. */
+#define FCR_CLEAR_RECV 0x02     /* Empty the receive FIFO. */
+#define FCR_CLEAR_XMIT 0x04     /* Empty the transmit FIFO. */
+
+/* Bytes the transmit FIFO holds when it is empty, that is, when
+   LSR_THRE is set. */
+#define XMIT_FIFO_SIZE 16
+
 /* Line Control Register bits. */
 #define LCR_N81 0x03            /* No parity, 8 data bits, 1 stop bit. */
 #define LCR_DLAB 0x80           /* Divisor Latch Access Bit (DLAB). */
@@ -51,11 +59,24 @@
 /* Transmission mode. */
 static enum { UNINIT, POLL, QUEUE } mode;
 
-/* Data to be transmitted. */
-static struct intq txq;
+/* Data to be transmitted, in a ring buffer large enough that
+   writers rarely wait for the port.  The interrupt handler moves
+   it into the transmit FIFO.  TX_HEAD and TX_TAIL count the bytes
+   ever added and removed, so TX_HEAD - TX_TAIL are queued.
+   Changed only with interrupts off. */
+#define TXBUF_SIZE 16384
+static uint8_t txbuf[TXBUF_SIZE];
+static size_t tx_head, tx_tail;
+
+/* Threads waiting for room in TXBUF, and the semaphore they wait
+   on, up'd once for each of them when TXBUF is half empty. */
+static int tx_waiters;
+static struct semaphore tx_room;
 
 static void set_serial (int bps);
 static void putc_poll (uint8_t);
+static size_t tx_queued (void);
+static uint8_t tx_getc (void);
 static void write_ier (void);
 static intr_handler_func serial_interrupt;
 
@@ -70,7 +91,9 @@ init_poll (void) {
 	outb (FCR_REG, 0);                    /* Disable FIFO. */
 	set_serial (115200);                  /* 115.2 kbps, N-8-1. */
 	outb (MCR_REG, MCR_OUT2);             /* Required to enable interrupts. */
-	intq_init (&txq);
+	tx_head = tx_tail = 0;
+	tx_waiters = 0;
+	sema_init (&tx_room, 0);
 	mode = POLL;
 }
 
@@ -86,6 +109,7 @@ serial_init_queue (void) {
 	ASSERT (mode == POLL);
 
 	intr_register_ext (0x20 + 4, serial_interrupt, "serial");
+	outb (FCR_REG, FCR_ENABLE | FCR_CLEAR_RECV | FCR_CLEAR_XMIT);
 	mode = QUEUE;
 	old_level = intr_disable ();
 	write_ier ();
@@ -95,28 +119,50 @@ serial_init_queue (void) {
 /* Sends BYTE to the serial port. */
 void
 serial_putc (uint8_t byte) {
+	serial_putbuf (&byte, 1);
+}
+
+/* Sends the N bytes in BUFFER to the serial port.  Returns as
+   soon as they are queued for the transmit interrupt, waiting
+   only if the queue is full.  BUFFER must not be in user memory,
+   since it is read with interrupts off. */
+void
+serial_putbuf (const void *buffer_, size_t n) {
+	const uint8_t *buffer = buffer_;
 	enum intr_level old_level = intr_disable ();
 
 	if (mode != QUEUE) {
 		/* If we're not set up for interrupt-driven I/O yet,
-		   use dumb polling to transmit a byte. */
+		   use dumb polling to transmit the bytes. */
 		if (mode == UNINIT)
 			init_poll ();
-		putc_poll (byte);
+		while (n-- > 0)
+			putc_poll (*buffer++);
 	} else {
-		/* Otherwise, queue a byte and update the interrupt enable
-		   register. */
-		if (old_level == INTR_OFF && intq_full (&txq)) {
-			/* Interrupts are off and the transmit queue is full.
-			   If we wanted to wait for the queue to empty,
-			   we'd have to reenable interrupts.
-			   That's impolite, so we'll send a character via
-			   polling instead. */
-			putc_poll (intq_getc (&txq));
+		/* Otherwise, queue as many bytes as fit and update the
+		   interrupt enable register, until all are queued. */
+		while (n > 0) {
+			size_t room = TXBUF_SIZE - tx_queued ();
+
+			if (room == 0) {
+				if (old_level == INTR_OFF) {
+					/* Interrupts are off and the transmit queue is
+					   full.  If we wanted to wait for the queue to
+					   empty, we'd have to reenable interrupts.
+					   That's impolite, so we'll send a character via
+					   polling instead. */
+					putc_poll (tx_getc ());
+				} else {
+					tx_waiters++;
+					sema_down (&tx_room);
+				}
+				continue;
+			}
+
+			for (; room > 0 && n > 0; room--, n--)
+				txbuf[tx_head++ % TXBUF_SIZE] = *buffer++;
+			write_ier ();
 		}
-
-		intq_putc (&txq, byte);
-		write_ier ();
 	}
 
 	intr_set_level (old_level);
@@ -127,8 +173,8 @@ serial_putc (uint8_t byte) {
 void
 serial_flush (void) {
 	enum intr_level old_level = intr_disable ();
-	while (!intq_empty (&txq))
-		putc_poll (intq_getc (&txq));
+	while (tx_queued () > 0)
+		putc_poll (tx_getc ());
 	intr_set_level (old_level);
 }
 
@@ -171,7 +217,7 @@ write_ier (void) {
 
 	/* Enable transmit interrupt if we have any characters to
 	   transmit. */
-	if (!intq_empty (&txq))
+	if (tx_queued () > 0)
 		ier |= IER_XMIT;
 
 	/* Enable receive interrupt if we have room to store any
@@ -193,6 +239,19 @@ putc_poll (uint8_t byte) {
 	outb (THR_REG, byte);
 }
 
+/* Returns the number of bytes queued for transmission. */
+static size_t
+tx_queued (void) {
+	return tx_head - tx_tail;
+}
+
+/* Removes and returns the oldest byte queued for transmission. */
+static uint8_t
+tx_getc (void) {
+	ASSERT (tx_queued () > 0);
+	return txbuf[tx_tail++ % TXBUF_SIZE];
+}
+
 /* Serial interrupt handler. */
 static void
 serial_interrupt (struct intr_frame *f UNUSED) {
@@ -205,10 +264,18 @@ serial_interrupt (struct intr_frame *f UNUSED) {
 	while (!input_full () && (inb (LSR_REG) & LSR_DR) != 0)
 		input_putc (inb (RBR_REG));
 
-	/* As long as we have a byte to transmit, and the hardware is
-	   ready to accept a byte for transmission, transmit a byte. */
-	while (!intq_empty (&txq) && (inb (LSR_REG) & LSR_THRE) != 0)
-		outb (THR_REG, intq_getc (&txq));
+	/* Once the transmit FIFO is empty, fill it from the queue. */
+	if ((inb (LSR_REG) & LSR_THRE) != 0) {
+		int i;
+
+		for (i = 0; i < XMIT_FIFO_SIZE && tx_queued () > 0; i++)
+			outb (THR_REG, tx_getc ());
+	}
+
+	/* Let writers waiting for room go on. */
+	if (tx_waiters > 0 && tx_queued () <= TXBUF_SIZE / 2)
+		for (; tx_waiters > 0; tx_waiters--)
+			sema_up (&tx_room);
 
 	/* Update interrupt enable register based on queue status. */
 	write_ier ();
@@ -3,6 +3,7 @@
 #include <inttypes.h>
 #include <round.h>
 #include <stdio.h>
+#include "intrinsic.h"
 #include "threads/interrupt.h"
 #include "threads/io.h"
 #include "threads/synch.h"
@@ -24,20 +25,95 @@ static int64_t ticks;
    timer_calibrate()에 의해 초기화됩니다. */
 static unsigned loops_per_tick;
 
+/* 초당 TSC 사이클 수와 보정을 시작할 때의 TSC 값입니다.
+   timer_calibrate()에 의해 초기화됩니다. */
+static uint64_t tsc_freq;
+static uint64_t tsc_start;
+
+/* TSC를 보정할 때 재는 타이머 틱 수입니다. */
+#define TSC_CALIBRATE_TICKS 4
+
+/* 틱당 TSC 사이클 수입니다.  timer_calibrate()에 의해 초기화됩니다. */
+static uint64_t cycles_per_tick;
+
+/* 8254 입력 주파수와, 이를 TIMER_FREQ로 나눈 틱당 카운트 수를 가장
+   가까운 값으로 반올림한 것입니다. */
+#define PIT_FREQ 1193180
+#define PIT_COUNT_PER_TICK ((PIT_FREQ + TIMER_FREQ / 2) / TIMER_FREQ)
+
+/* 원샷 한 번으로 건너뛸 수 있는 최대 틱 수입니다.  8254 카운터는
+   16비트입니다. */
+#define ONESHOT_MAX_TICKS (0xffff / PIT_COUNT_PER_TICK)
+
+/* 8254를 틱마다 인터럽트를 거는 주기 모드(모드 2)로 쓰고 있는지,
+   아니면 TSC 값 oneshot_tsc에 한 번 인터럽트를 거는 원샷 모드(모드 0)로
+   쓰고 있는지 나타냅니다.
+
+   원샷 모드는 두 경우에 씁니다.  유휴 스레드만 실행할 수 있을 때는
+   틱마다 인터럽트를 받는 것이 낭비이므로 다음 타임아웃의 틱 경계까지
+   인터럽트 없이 지나가고, 그 사이 틱은 TSC로 셉니다.  또 틱보다 짧은
+   타임아웃은 그 시각에 인터럽트가 와야 합니다.  원샷 인터럽트는 지나간
+   틱을 세고, 틱 경계에 있으며 더 기다릴 짧은 타임아웃이 없으면 주기
+   모드로 되돌립니다. */
+static bool periodic;
+static uint64_t oneshot_tsc;
+
+/* 틱 ticks가 시작된 시점의 TSC 값입니다. */
+static uint64_t tick_tsc;
+
+/* 통계: 원샷 인터럽트 수와 그동안 인터럽트 없이 지나간 틱 수. */
+static long long oneshot_cnt;
+static long long skipped_ticks;
+
+/* 타임아웃을 담는 계층적 타이머 휠입니다.
+
+   단계 L의 슬롯 하나는 64**L 틱을 맡고, 만료까지 64**(L + 1) 틱이
+   남지 않은 타임아웃은 그 틱이 속한 단계 L의 슬롯에 들어갑니다.
+   그래서 추가와 취소는 O(1)입니다.  매 틱에는 그 틱의 단계 0 슬롯에
+   있는 타임아웃이 만료되고, 틱 수가 64**L의 배수가 될 때마다 단계 L의
+   슬롯 하나를 아래 단계로 옮깁니다.  가장 높은 단계가 맡는 것보다 먼
+   타임아웃은 그 끝에 넣었다가 다시 넣습니다. */
+#define WHEEL_BITS 6
+#define WHEEL_SLOTS (1 << WHEEL_BITS)
+#define WHEEL_LEVELS 4
+#define WHEEL_SPAN(LEVEL) ((int64_t) 1 << (WHEEL_BITS * ((LEVEL) + 1)))
+static struct list wheel[WHEEL_LEVELS][WHEEL_SLOTS];
+
+/* 이번 틱 안에 만료될 타임아웃들을 TSC 값 순서로 담습니다. */
+static struct list subtick_list;
+
+/* 이보다 짧은 timer_usleep()/timer_nsleep()은 재우지 않고 TSC를 보며
+   기다립니다.  인터럽트와 문맥 전환이 더 오래 걸리기 때문입니다. */
+#define SPIN_NS 20000
+
 static intr_handler_func timer_interrupt;
+static void tick (void);
+static void wheel_insert (struct timeout *, int64_t base);
+static int64_t wheel_next (int64_t limit);
+static void subtick_insert (struct timeout *);
+static void fire (struct timeout *);
+static void arm (uint64_t when);
+static void oneshot_at (uint64_t when);
+static void pit_program (uint8_t pit_mode, uint16_t count);
+static uint16_t cycles_to_count (uint64_t cycles);
+static uint64_t ns_to_cycles (int64_t ns);
 static bool too_many_loops (unsigned loops);
+static void calibrate_tsc (void);
 static void busy_wait (int64_t loops);
 static void real_time_sleep (int64_t num, int32_t denom);
 
 /* 8254 프로그래머블 인터벌 타이머(PIT)가 초당 PIT_FREQ 횟수를 인터럽트하도록 설정하고 해당 인터럽트를 등록합니다. */
 void
 timer_init (void) {
-	/* 8254 입력 주파수를 TIMER_FREQ로 나눈 값, 가장 가까운 값으로 반올림. */
-	uint16_t count = (1193180 + TIMER_FREQ / 2) / TIMER_FREQ;
+	int level, slot;
 
-	outb (0x43, 0x34);    /* CW: counter 0, LSB then MSB, mode 2, binary. */
-	outb (0x40, count & 0xff);
-	outb (0x40, count >> 8);
+	for (level = 0; level < WHEEL_LEVELS; level++)
+		for (slot = 0; slot < WHEEL_SLOTS; slot++)
+			list_init (&wheel[level][slot]);
+	list_init (&subtick_list);
+
+	pit_program (2, PIT_COUNT_PER_TICK);
+	periodic = true;
 
 	intr_register_ext (0x20, timer_interrupt, "8254 Timer");
 }
@@ -64,6 +140,62 @@ timer_calibrate (void) {
 			loops_per_tick |= test_bit;
 
 	printf ("%'"PRIu64" loops/s.\n", (uint64_t) loops_per_tick * TIMER_FREQ);
+
+	calibrate_tsc ();
+	printf ("TSC: %'"PRIu64" cycles/s.\n", tsc_freq);
+}
+
+/* 틱 경계에서 TSC_CALIBRATE_TICKS 틱 동안 TSC가 얼마나 증가하는지 재서
+   tsc_freq를 구합니다.  PIT가 기준 시계입니다. */
+static void
+calibrate_tsc (void) {
+	int64_t start;
+	uint64_t begin;
+	enum intr_level old_level;
+
+	/* 틱 경계를 기다립니다. */
+	start = ticks;
+	while (ticks == start)
+		barrier ();
+	begin = rdtsc ();
+
+	start = ticks;
+	while (ticks - start < TSC_CALIBRATE_TICKS)
+		barrier ();
+	tsc_freq = (rdtsc () - begin) * TIMER_FREQ / TSC_CALIBRATE_TICKS;
+	tsc_start = begin;
+
+	/* 여기서부터 유휴 상태에서 틱을 건너뛸 수 있습니다. */
+	old_level = intr_disable ();
+	tick_tsc = rdtsc ();
+	cycles_per_tick = tsc_freq / TIMER_FREQ;
+	intr_set_level (old_level);
+}
+
+/* 초당 TSC 사이클 수를 반환합니다.  timer_calibrate() 전에는 0입니다. */
+uint64_t
+timer_tsc_freq (void) {
+	return tsc_freq;
+}
+
+/* TSC 사이클 수 CYCLES를 나노초로 바꿔 반환합니다.
+   timer_calibrate() 전에는 0을 반환합니다. */
+int64_t
+timer_tsc_to_ns (uint64_t cycles) {
+	if (tsc_freq == 0)
+		return 0;
+
+	/* CYCLES * 10억은 넘칠 수 있으므로 초 단위와 나머지를 따로
+	   바꿉니다. */
+	return (cycles / tsc_freq) * 1000000000
+		+ (cycles % tsc_freq) * 1000000000 / tsc_freq;
+}
+
+/* TSC 보정 이후 경과한 시간을 나노초 단위로 반환합니다.
+   틱보다 훨씬 세밀하므로 짧은 구간을 재는 데 씁니다. */
+int64_t
+timer_ns (void) {
+	return timer_tsc_to_ns (rdtsc () - tsc_start);
 }
 
 /* OS 부팅 이후 타이머 틱 횟수를 반환합니다. */
@@ -71,6 +203,9 @@ int64_t
 timer_ticks (void) {
 	enum intr_level old_level = intr_disable ();
 	int64_t t = ticks;
+	/* 유휴 상태에서 인터럽트 없이 지나간 틱도 셉니다. */
+	if (!periodic)
+		t += (rdtsc () - tick_tsc) / cycles_per_tick;
 	intr_set_level (old_level);
 	barrier ();
 	return t;
@@ -87,6 +222,8 @@ void
 timer_sleep (int64_t ticks) {
 	int64_t start = timer_ticks();
 	ASSERT (intr_get_level () == INTR_ON);
+	if (ticks <= 0)
+		return;
 	thread_sleep(start + ticks);	
 	// while(timer_elapsed(start)<ticks)
 	// 	thread_yield()
@@ -110,20 +247,308 @@ timer_nsleep (int64_t ns) {
 	real_time_sleep (ns, 1000 * 1000 * 1000);
 }
 
+/* 타임아웃 T가 만료되면 인터럽트 문맥에서 FUNC(AUX)를 부르도록
+   초기화합니다. */
+void
+timeout_init (struct timeout *t, timeout_func *func, void *aux) {
+	t->func = func;
+	t->aux = aux;
+	t->tsc = 0;
+	t->pending = false;
+}
+
+/* T가 틱 TICK에 만료되게 합니다.  TICK이 이미 지났으면 다음 틱에
+   만료됩니다. */
+void
+timeout_add (struct timeout *t, int64_t tick) {
+	enum intr_level old_level = intr_disable ();
+
+	ASSERT (!t->pending);
+	t->tick = tick;
+	t->tsc = 0;
+	t->pending = true;
+	wheel_insert (t, ticks + 1);
+	if (!periodic)
+		arm (tick_tsc + (tick > ticks ? tick - ticks : 1) * cycles_per_tick);
+	intr_set_level (old_level);
+}
+
+/* T가 timer_ns()가 NS가 될 때 만료되게 합니다.  그 틱까지는 휠에서
+   기다리고, 틱 안의 남은 시간은 원샷 인터럽트로 맞춥니다.
+   timer_calibrate() 전에는 쓸 수 없습니다. */
+void
+timeout_add_ns (struct timeout *t, int64_t ns) {
+	enum intr_level old_level;
+	uint64_t tsc;
+
+	ASSERT (cycles_per_tick != 0);
+
+	old_level = intr_disable ();
+	ASSERT (!t->pending);
+	tsc = tsc_start + ns_to_cycles (ns);
+	t->tick = ticks;
+	if (tsc > tick_tsc)
+		t->tick += (tsc - tick_tsc) / cycles_per_tick;
+	t->tsc = tsc;
+	t->pending = true;
+	if (t->tick > ticks) {
+		wheel_insert (t, ticks + 1);
+		if (!periodic)
+			arm (tick_tsc + (t->tick - ticks) * cycles_per_tick);
+	} else {
+		subtick_insert (t);
+		arm (tsc);
+	}
+	intr_set_level (old_level);
+}
+
+/* T를 취소합니다.  T가 아직 만료되지 않았으면 참을 반환합니다. */
+bool
+timeout_cancel (struct timeout *t) {
+	enum intr_level old_level = intr_disable ();
+	bool pending = t->pending;
+
+	if (pending) {
+		list_remove (&t->elem);
+		t->pending = false;
+	}
+	intr_set_level (old_level);
+	return pending;
+}
+
+/* 유휴 스레드가 hlt 하기 직전에 인터럽트를 끈 채로 호출합니다.
+   다음 타임아웃이 두 틱 이상 뒤라면 그 틱 경계까지 틱 인터럽트를
+   받지 않도록 8254를 원샷으로 설정합니다. */
+void
+timer_idle_enter (void) {
+	int64_t delta;
+	uint64_t now, when;
+
+	ASSERT (intr_get_level () == INTR_OFF);
+	if (cycles_per_tick == 0 || !list_empty (&subtick_list))
+		return;
+
+	/* 틱 인터럽트가 이미 와 있으면 그것부터 처리합니다. */
+	now = rdtsc ();
+	if (periodic ? now - tick_tsc >= cycles_per_tick : now >= oneshot_tsc)
+		return;
+
+	delta = wheel_next (ONESHOT_MAX_TICKS);
+	when = tick_tsc + delta * cycles_per_tick;
+	if (delta >= 2 && (periodic || when > oneshot_tsc))
+		oneshot_at (when);
+}
+
+/* 유휴 스레드가 다른 스레드에게 CPU를 넘기기 직전에 인터럽트를 끈
+   채로 호출합니다.  원샷이 다음 틱 경계보다 뒤에 있으면 그 경계까지로
+   줄여서, 깨어난 스레드가 곧 다시 틱마다 선점될 수 있게 합니다. */
+void
+timer_idle_exit (void) {
+	uint64_t boundary;
+
+	ASSERT (intr_get_level () == INTR_OFF);
+	if (periodic)
+		return;
+
+	boundary = tick_tsc + ((rdtsc () - tick_tsc) / cycles_per_tick + 1)
+		* cycles_per_tick;
+	if (oneshot_tsc > boundary)
+		oneshot_at (boundary);
+}
+
 /* 타이머 통계를 인쇄합니다. */
 void
 timer_print_stats (void) {
 	printf ("Timer: %"PRId64" ticks\n", timer_ticks ());
+	printf ("Timer: %lld one-shot interrupts, %lld ticks skipped\n",
+			oneshot_cnt, skipped_ticks);
 }
 
 /* 타이머 인터럽트 핸들러. */
 static void
 timer_interrupt (struct intr_frame *args UNUSED) {
+	struct list_elem *e;
+	uint64_t now;
+
+	if (cycles_per_tick == 0) {
+		/* 아직 TSC를 보정하지 않았습니다. */
+		tick ();
+		return;
+	}
+
+	now = rdtsc ();
+	if (periodic) {
+		tick_tsc = now;
+		tick ();
+	} else {
+		/* 원샷은 목표보다 조금 늦게 오도록 설정하므로 지난 틱 경계는
+		   모두 now 이전에 있습니다. */
+		int64_t n = (now - tick_tsc) / cycles_per_tick;
+
+		oneshot_cnt++;
+		if (n > 1)
+			skipped_ticks += n - 1;
+		while (n-- > 0) {
+			tick_tsc += cycles_per_tick;
+			tick ();
+		}
+	}
+
+	/* 틱 안의 타임아웃을 만료시킵니다. */
+	while (!list_empty (&subtick_list)) {
+		struct timeout *t = list_entry (list_front (&subtick_list),
+				struct timeout, elem);
+		if (t->tsc > now)
+			break;
+		list_pop_front (&subtick_list);
+		fire (t);
+	}
+
+	/* 다음 인터럽트를 정합니다. */
+	e = list_begin (&subtick_list);
+	if (e != list_end (&subtick_list))
+		arm (list_entry (e, struct timeout, elem)->tsc);
+	else if (!periodic) {
+		if (now - tick_tsc < cycles_per_tick / 4) {
+			pit_program (2, PIT_COUNT_PER_TICK);
+			periodic = true;
+		} else
+			oneshot_at (tick_tsc + cycles_per_tick);
+	}
+}
+
+/* 틱 하나를 세고 그 틱에 만료되는 타임아웃을 처리합니다. */
+static void
+tick (void) {
+	struct list *slot;
+	int level;
+
 	ticks++;
 	thread_tick ();
-	if (get_next_tick_to_awake() <= ticks) { // 매 틱마다 깨우는 것이 아니라 깨울 틱을 확인하고 깨움.
-		thread_awake(ticks);
+
+	/* 틱 수가 64**LEVEL의 배수가 되면 단계 LEVEL에서 지금부터
+	   시작하는 슬롯을 아래 단계로 옮깁니다. */
+	for (level = 1; level < WHEEL_LEVELS; level++) {
+		struct list cascade;
+
+		if (ticks % WHEEL_SPAN (level - 1) != 0)
+			break;
+		slot = &wheel[level][(ticks >> (WHEEL_BITS * level)) & (WHEEL_SLOTS - 1)];
+		if (list_empty (slot))
+			continue;
+
+		list_init (&cascade);
+		list_splice (list_end (&cascade), list_begin (slot), list_end (slot));
+		while (!list_empty (&cascade))
+			wheel_insert (list_entry (list_pop_front (&cascade),
+						struct timeout, elem), ticks);
 	}
+
+	slot = &wheel[0][ticks & (WHEEL_SLOTS - 1)];
+	while (!list_empty (slot)) {
+		struct timeout *t = list_entry (list_pop_front (slot),
+				struct timeout, elem);
+
+		ASSERT (t->tick <= ticks);
+		if (t->tsc != 0 && t->tsc > rdtsc ())
+			subtick_insert (t);
+		else
+			fire (t);
+	}
+}
+
+/* T를 휠에 넣습니다.  BASE보다 이른 틱에 만료되는 타임아웃은 BASE에
+   만료됩니다.  BASE는 ticks 또는 ticks + 1입니다. */
+static void
+wheel_insert (struct timeout *t, int64_t base) {
+	int64_t when = t->tick > base ? t->tick : base;
+	int level = 0;
+
+	while (level < WHEEL_LEVELS - 1 && when - ticks >= WHEEL_SPAN (level))
+		level++;
+	if (when - ticks >= WHEEL_SPAN (level))
+		when = ticks + WHEEL_SPAN (level) - 1;
+	list_push_back (&wheel[level][(when >> (WHEEL_BITS * level))
+			& (WHEEL_SLOTS - 1)], &t->elem);
+}
+
+/* 다음 LIMIT 틱 가운데 처리할 것이 있는 첫 틱이 몇 틱 뒤인지
+   반환합니다.  없으면 LIMIT을 반환합니다.  위 단계에서 슬롯을 옮기는
+   틱도 처리할 것이 있는 틱으로 칩니다. */
+static int64_t
+wheel_next (int64_t limit) {
+	int64_t delta;
+
+	ASSERT (limit < WHEEL_SLOTS);
+	for (delta = 1; delta < limit; delta++)
+		if (!list_empty (&wheel[0][(ticks + delta) & (WHEEL_SLOTS - 1)])
+				|| (ticks + delta) % WHEEL_SLOTS == 0)
+			break;
+	return delta;
+}
+
+/* T를 subtick_list에 TSC 값 순서로 넣습니다.  이 목록은 짧습니다. */
+static void
+subtick_insert (struct timeout *t) {
+	struct list_elem *e;
+
+	for (e = list_begin (&subtick_list); e != list_end (&subtick_list);
+			e = list_next (e))
+		if (list_entry (e, struct timeout, elem)->tsc > t->tsc)
+			break;
+	list_insert (e, &t->elem);
+}
+
+/* 만료된 T의 함수를 부릅니다.  T는 어느 목록에도 들어 있지 않습니다. */
+static void
+fire (struct timeout *t) {
+	t->pending = false;
+	t->func (t->aux);
+}
+
+/* 늦어도 TSC 값 WHEN에는 타이머 인터럽트가 오게 합니다. */
+static void
+arm (uint64_t when) {
+	if (periodic ? when < tick_tsc + cycles_per_tick : when < oneshot_tsc)
+		oneshot_at (when);
+}
+
+/* 8254를 TSC 값 WHEN 직후에 한 번 인터럽트를 걸도록 설정합니다. */
+static void
+oneshot_at (uint64_t when) {
+	uint64_t now = rdtsc ();
+
+	periodic = false;
+	oneshot_tsc = when;
+	pit_program (0, cycles_to_count (when > now ? when - now : 0));
+}
+
+/* 8254 카운터 0을 PIT_MODE로 설정하고 COUNT부터 세게 합니다.
+   모드 0은 한 번, 모드 2는 COUNT마다 인터럽트를 겁니다. */
+static void
+pit_program (uint8_t pit_mode, uint16_t count) {
+	/* CW: counter 0, LSB then MSB, PIT_MODE, binary. */
+	outb (0x43, 0x30 | (pit_mode << 1));
+	outb (0x40, count & 0xff);
+	outb (0x40, count >> 8);
+}
+
+/* TSC 사이클 수 CYCLES를 8254 카운트로 바꿉니다.  인터럽트가 목표보다
+   일찍 오지 않도록 올림하고 하나를 더합니다. */
+static uint16_t
+cycles_to_count (uint64_t cycles) {
+	uint64_t count = DIV_ROUND_UP (cycles * PIT_FREQ, tsc_freq) + 1;
+
+	return count > 0xffff ? 0xffff : count;
+}
+
+/* 나노초 NS를 TSC 사이클 수로 바꿉니다. */
+static uint64_t
+ns_to_cycles (int64_t ns) {
+	if (ns <= 0)
+		return 0;
+	return (ns / 1000000000) * tsc_freq
+		+ (ns % 1000000000) * tsc_freq / 1000000000;
 }
 
 /* LOOPS 반복이 타이머 틱을 두 번 이상 기다리면 참을 반환하고, 그렇지 않으면 거짓을 반환합니다. */
@@ -165,7 +590,20 @@ real_time_sleep (int64_t num, int32_t denom) {
 	int64_t ticks = num * TIMER_FREQ / denom;
 
 	ASSERT (intr_get_level () == INTR_ON);
-	if (ticks > 0) {
+	if (cycles_per_tick != 0) {
+		/* TSC를 보정한 뒤에는 나노초 단위로 맞춥니다.  짧으면 TSC를 보며
+		   기다리고, 아니면 그 시각까지 잠듭니다. */
+		int64_t ns, end;
+
+		ASSERT (1000000000 % denom == 0);
+		ns = num * (1000000000 / denom);
+		end = timer_ns () + ns;
+		if (ns >= SPIN_NS)
+			thread_sleep_ns (end);
+		else
+			while (timer_ns () < end)
+				barrier ();
+	} else if (ticks > 0) {
 		/* 적어도 한 번의 전체 타이머 틱을 기다리고 있습니다.  
 			timer_sleep()을 사용하면 다른 프로세스에 CPU를 양보하게 되므로 주의하세요. */
 		timer_sleep (ticks);
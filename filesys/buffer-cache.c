@@ -0,0 +1,352 @@
+#include "filesys/buffer-cache.h"
+#include <debug.h>
+#include <string.h>
+#include "filesys/filesys.h"
+#include "filesys/journal.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+
+/* Number of sectors the cache holds. */
+#define BUFFER_CACHE_SIZE 64
+
+/* Sector number of a buffer that caches nothing. */
+#define NO_SECTOR ((disk_sector_t) -1)
+
+/* A cached sector.
+ *
+ * LOCK is held by whoever reads or writes DATA, including while
+ * the buffer is filled from or written back to disk, so accesses
+ * to different sectors proceed in parallel.  SECTOR changes only
+ * while both LOCK and cache_lock are held, so it may be read while
+ * holding either.
+ *
+ * Callers pass kernel buffers only.  Data is copied to and from
+ * them with LOCK held, and a page fault there could need the same
+ * buffer again, for example to load an mmap of the file. */
+struct buffer {
+	struct lock lock;                   /* Guards the members below. */
+	disk_sector_t sector;               /* Cached sector, or NO_SECTOR. */
+	bool valid;                         /* Does DATA hold SECTOR yet? */
+	bool dirty;                         /* Must DATA be written back? */
+	bool accessed;                      /* Used since the clock hand passed? */
+	struct disk_request request;        /* Write back in progress, if any. */
+	uint8_t data[DISK_SECTOR_SIZE];     /* Sector contents. */
+};
+
+static struct buffer *buffers;
+
+/* Guards the mapping from sectors to buffers and the clock hand. */
+static struct lock cache_lock;
+static size_t clock_hand;
+
+/* Initializes the buffer cache. */
+void
+buffer_cache_init (void) {
+	size_t i;
+
+	buffers = malloc (BUFFER_CACHE_SIZE * sizeof *buffers);
+	if (buffers == NULL)
+		PANIC ("buffer cache allocation failed");
+	for (i = 0; i < BUFFER_CACHE_SIZE; i++) {
+		lock_init (&buffers[i].lock);
+		buffers[i].sector = NO_SECTOR;
+		buffers[i].valid = false;
+		buffers[i].dirty = false;
+		buffers[i].accessed = false;
+	}
+	lock_init (&cache_lock);
+	clock_hand = 0;
+}
+
+/* Returns the buffer that caches SECTOR, or a null pointer if
+ * there is none.  The caller must hold cache_lock. */
+static struct buffer *
+find (disk_sector_t sector) {
+	size_t i;
+
+	for (i = 0; i < BUFFER_CACHE_SIZE; i++)
+		if (buffers[i].sector == sector)
+			return &buffers[i];
+	return NULL;
+}
+
+/* Picks a buffer to reuse with the clock algorithm, skipping
+ * buffers that are in use, and returns it locked.  Returns a null
+ * pointer if every buffer is in use.  The caller must hold
+ * cache_lock. */
+static struct buffer *
+evict (void) {
+	size_t i;
+
+	for (i = 0; i < 2 * BUFFER_CACHE_SIZE; i++) {
+		struct buffer *b = &buffers[clock_hand];
+		clock_hand = (clock_hand + 1) % BUFFER_CACHE_SIZE;
+
+		if (!lock_try_acquire (&b->lock))
+			continue;
+		if (b->sector == NO_SECTOR || !b->accessed)
+			return b;
+		b->accessed = false;
+		lock_release (&b->lock);
+	}
+	return NULL;
+}
+
+/* Returns the buffer for SECTOR, locked, assigning one to SECTOR if
+ * none is.  A newly assigned buffer is not yet valid. */
+static struct buffer *
+buffer_acquire (disk_sector_t sector) {
+	for (;;) {
+		struct buffer *b;
+
+		lock_acquire (&cache_lock);
+		b = find (sector);
+		if (b != NULL) {
+			lock_release (&cache_lock);
+			lock_acquire (&b->lock);
+			if (b->sector == sector)
+				return b;
+
+			/* Reused for another sector while we waited. */
+			lock_release (&b->lock);
+			continue;
+		}
+
+		b = evict ();
+		if (b == NULL) {
+			lock_release (&cache_lock);
+			thread_yield ();
+			continue;
+		}
+
+		/* Write back the old contents without cache_lock, so that
+		 * lookups of other sectors need not wait for the disk.  The
+		 * buffer keeps its old sector and stays locked meanwhile, so
+		 * that anyone who looks up the old sector waits for the write
+		 * instead of reading stale data from disk, and so that
+		 * evict() passes it over.  Uncommitted metadata is not
+		 * written in place; the journal keeps it and hands it back on
+		 * the next read. */
+		if (b->dirty) {
+			lock_release (&cache_lock);
+			if (journal_may_write_back (b->sector)) {
+				disk_write (filesys_disk, b->sector, b->data);
+				journal_written_back (b->sector);
+			}
+			b->dirty = false;
+			lock_acquire (&cache_lock);
+			if (find (sector) != NULL) {
+				/* Another buffer took SECTOR meanwhile.  B stays cached,
+				 * now clean. */
+				lock_release (&cache_lock);
+				lock_release (&b->lock);
+				continue;
+			}
+		}
+		b->sector = sector;
+		b->valid = false;
+		lock_release (&cache_lock);
+		return b;
+	}
+}
+
+/* Reads the contents of B's sector into B, from the journal if it
+ * holds newer contents than the disk. */
+static void
+fill (struct buffer *b) {
+	if (!journal_read (b->sector, b->data))
+		disk_read (filesys_disk, b->sector, b->data);
+}
+
+/* Reads SIZE bytes starting at byte offset OFS within SECTOR into
+ * BUFFER. */
+void
+buffer_cache_read (disk_sector_t sector, void *buffer, int ofs, int size) {
+	struct buffer *b;
+
+	ASSERT (ofs >= 0 && size >= 0 && ofs + size <= DISK_SECTOR_SIZE);
+	ASSERT (is_kernel_vaddr (buffer));
+
+	b = buffer_acquire (sector);
+	if (!b->valid) {
+		fill (b);
+		b->valid = true;
+	}
+	memcpy (buffer, b->data + ofs, size);
+	b->accessed = true;
+	lock_release (&b->lock);
+}
+
+/* Writes SIZE bytes from BUFFER into SECTOR starting at byte offset
+ * OFS, and logs the new contents in the journal if META is true. */
+static void
+write (disk_sector_t sector, const void *buffer, int ofs, int size,
+		bool meta) {
+	struct buffer *b;
+
+	ASSERT (ofs >= 0 && size >= 0 && ofs + size <= DISK_SECTOR_SIZE);
+	ASSERT (is_kernel_vaddr (buffer));
+
+	b = buffer_acquire (sector);
+	if (!b->valid) {
+		/* No need to read a sector that is about to be overwritten
+		 * entirely. */
+		if (size < DISK_SECTOR_SIZE)
+			fill (b);
+		b->valid = true;
+	}
+	memcpy (b->data + ofs, buffer, size);
+	b->accessed = true;
+	b->dirty = true;
+	if (meta)
+		journal_log (sector, b->data);
+	lock_release (&b->lock);
+}
+
+/* Copies SECTOR's cached contents into BUFFER, if it is cached. */
+static void
+copy_if_cached (disk_sector_t sector, void *buffer) {
+	struct buffer *b;
+
+	lock_acquire (&cache_lock);
+	b = find (sector);
+	lock_release (&cache_lock);
+	if (b == NULL)
+		return;
+
+	lock_acquire (&b->lock);
+	if (b->sector == sector && b->valid)
+		memcpy (buffer, b->data, DISK_SECTOR_SIZE);
+	lock_release (&b->lock);
+}
+
+/* Replaces SECTOR's cached contents by BUFFER, if it is cached. */
+static void
+update_if_cached (disk_sector_t sector, const void *buffer) {
+	struct buffer *b;
+
+	lock_acquire (&cache_lock);
+	b = find (sector);
+	lock_release (&cache_lock);
+	if (b == NULL)
+		return;
+
+	lock_acquire (&b->lock);
+	if (b->sector == sector) {
+		memcpy (b->data, buffer, DISK_SECTOR_SIZE);
+		b->valid = true;
+	}
+	lock_release (&b->lock);
+}
+
+/* Reads the CNT whole sectors starting at SECTOR, which hold file
+ * data, into BUFFER.  Sectors that are cached are copied from the
+ * cache, and each run of sectors that are not is read from disk
+ * with one command, around the cache, so that a large read neither
+ * costs a command per sector nor pushes everything else out.  The
+ * journal never holds file data, so it need not be consulted. */
+void
+buffer_cache_read_multiple (disk_sector_t sector, void *buffer_, size_t cnt) {
+	uint8_t *buffer = buffer_;
+	size_t i = 0;
+
+	ASSERT (is_kernel_vaddr (buffer));
+
+	while (i < cnt) {
+		size_t run = 0;
+		size_t j;
+
+		lock_acquire (&cache_lock);
+		while (i + run < cnt && find (sector + i + run) == NULL)
+			run++;
+		lock_release (&cache_lock);
+
+		if (run == 0) {
+			buffer_cache_read (sector + i, buffer + i * DISK_SECTOR_SIZE, 0,
+					DISK_SECTOR_SIZE);
+			i++;
+			continue;
+		}
+
+		disk_read_multiple (filesys_disk, sector + i,
+				buffer + i * DISK_SECTOR_SIZE, run);
+		/* A sector written into the cache meanwhile is newer than
+		 * what was read. */
+		for (j = i; j < i + run; j++)
+			copy_if_cached (sector + j, buffer + j * DISK_SECTOR_SIZE);
+		i += run;
+	}
+}
+
+/* Writes the CNT whole sectors starting at SECTOR, which hold file
+ * data, from BUFFER straight to disk with as few commands as
+ * possible, and brings any cached copies of them up to date.  The
+ * caller must make sure that nobody else reads or writes the
+ * sectors meanwhile. */
+void
+buffer_cache_write_multiple (disk_sector_t sector, const void *buffer_,
+		size_t cnt) {
+	const uint8_t *buffer = buffer_;
+	size_t i;
+
+	ASSERT (is_kernel_vaddr (buffer));
+
+	for (i = 0; i < cnt; i++)
+		update_if_cached (sector + i, buffer + i * DISK_SECTOR_SIZE);
+	disk_write_multiple (filesys_disk, sector, buffer, cnt);
+}
+
+/* Writes SIZE bytes of file data from BUFFER into SECTOR starting
+ * at byte offset OFS.  The sector reaches the disk when it is
+ * evicted or flushed. */
+void
+buffer_cache_write (disk_sector_t sector, const void *buffer, int ofs,
+		int size) {
+	write (sector, buffer, ofs, size, false);
+}
+
+/* Like buffer_cache_write(), but for a metadata sector, whose new
+ * contents become part of the running journal transaction and reach
+ * their place on disk only after it commits. */
+void
+buffer_cache_write_meta (disk_sector_t sector, const void *buffer, int ofs,
+		int size) {
+	write (sector, buffer, ofs, size, true);
+}
+
+/* Writes every dirty buffer back to disk.  All of the writes are
+ * queued before waiting for any, so that the disk serves them in
+ * sector order and merges neighbors into one command.  Each buffer
+ * stays locked until its write is done. */
+void
+buffer_cache_flush (void) {
+	bool writing[BUFFER_CACHE_SIZE];
+	size_t i;
+
+	for (i = 0; i < BUFFER_CACHE_SIZE; i++) {
+		struct buffer *b = &buffers[i];
+
+		lock_acquire (&b->lock);
+		writing[i] = (b->sector != NO_SECTOR && b->dirty
+				&& journal_may_write_back (b->sector));
+		if (writing[i]) {
+			disk_request_init (&b->request, filesys_disk, b->sector, b->data,
+					1, true);
+			disk_submit (&b->request, NULL, NULL);
+		} else
+			lock_release (&b->lock);
+	}
+
+	for (i = 0; i < BUFFER_CACHE_SIZE; i++) {
+		struct buffer *b = &buffers[i];
+
+		if (writing[i]) {
+			disk_wait (&b->request);
+			journal_written_back (b->sector);
+			b->dirty = false;
+			lock_release (&b->lock);
+		}
+	}
+}
@@ -0,0 +1,218 @@
+#include "filesys/dcache.h"
+#include <debug.h>
+#include <hash.h>
+#include <list.h>
+#include <string.h>
+#include "filesys/directory.h"
+#include "filesys/inode.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+
+/* Maximum number of cached entries.  Once it is reached, the least
+ * recently used entry makes room for a new one. */
+#define DCACHE_SIZE 512
+
+/* A cached directory entry. */
+struct dentry {
+	struct hash_elem hash_elem;         /* Element in dentries. */
+	struct list_elem lru_elem;          /* Element in lru_list. */
+	disk_sector_t parent;               /* Directory's inode sector. */
+	char name[NAME_MAX + 1];            /* Name within the directory. */
+	disk_sector_t sector;               /* Inode sector, 0 if no such name. */
+	int type;                           /* DT_REG, DT_DIR or DT_LNK. */
+	char *target;                       /* Symbolic link's target, if known. */
+};
+
+/* Cached entries, keyed by PARENT and NAME, and the same entries
+ * from most to least recently used. */
+static struct hash dentries;
+static struct list lru_list;
+static struct lock dcache_lock;
+
+static uint64_t
+dentry_hash (const struct hash_elem *e, void *aux UNUSED) {
+	const struct dentry *d = hash_entry (e, struct dentry, hash_elem);
+	return hash_string (d->name) ^ hash_int (d->parent);
+}
+
+static bool
+dentry_less (const struct hash_elem *a_, const struct hash_elem *b_,
+		void *aux UNUSED) {
+	const struct dentry *a = hash_entry (a_, struct dentry, hash_elem);
+	const struct dentry *b = hash_entry (b_, struct dentry, hash_elem);
+	if (a->parent != b->parent)
+		return a->parent < b->parent;
+	return strcmp (a->name, b->name) < 0;
+}
+
+/* Initializes the directory entry cache. */
+void
+dcache_init (void) {
+	if (!hash_init (&dentries, dentry_hash, dentry_less, NULL))
+		PANIC ("dentry cache creation failed");
+	list_init (&lru_list);
+	lock_init (&dcache_lock);
+}
+
+/* Returns the cached entry for NAME in PARENT, or a null pointer if
+ * there is none.  The caller must hold dcache_lock. */
+static struct dentry *
+find (disk_sector_t parent, const char *name) {
+	struct dentry key;
+	struct hash_elem *e;
+
+	if (strlen (name) > NAME_MAX)
+		return NULL;
+	key.parent = parent;
+	strlcpy (key.name, name, sizeof key.name);
+	e = hash_find (&dentries, &key.hash_elem);
+	return e != NULL ? hash_entry (e, struct dentry, hash_elem) : NULL;
+}
+
+/* Drops D from the cache.  The caller must hold dcache_lock. */
+static void
+evict (struct dentry *d) {
+	hash_delete (&dentries, &d->hash_elem);
+	list_remove (&d->lru_elem);
+	free (d->target);
+	free (d);
+}
+
+/* Looks up NAME in the directory whose inode is in PARENT.
+ * Returns false if the cache does not know about NAME.  Otherwise,
+ * returns true and sets *INODE to NAME's inode, opened, and *TYPE
+ * to its type, or *INODE to a null pointer if PARENT is known not
+ * to contain NAME.
+ * The inode is referenced before dcache_lock is released, since
+ * the entry is dropped before a removed inode can be freed, so its
+ * sector cannot have been reused for another file meanwhile. */
+bool
+dcache_lookup (disk_sector_t parent, const char *name,
+		struct inode **inode, int *type) {
+	struct dentry *d;
+	bool found = false;
+
+	lock_acquire (&dcache_lock);
+	d = find (parent, name);
+	if (d != NULL) {
+		list_remove (&d->lru_elem);
+		list_push_front (&lru_list, &d->lru_elem);
+		*inode = d->sector != 0 ? inode_get (d->sector) : NULL;
+		*type = d->type;
+		found = d->sector == 0 || *inode != NULL;
+	}
+	lock_release (&dcache_lock);
+	if (found)
+		inode_load (*inode);
+	return found;
+}
+
+/* Records that NAME in the directory whose inode is in PARENT
+ * refers to the inode in SECTOR, of type TYPE.  A SECTOR of 0
+ * records that PARENT has no entry NAME. */
+void
+dcache_insert (disk_sector_t parent, const char *name,
+		disk_sector_t sector, int type) {
+	struct dentry *d;
+
+	if (strlen (name) > NAME_MAX)
+		return;
+
+	lock_acquire (&dcache_lock);
+	d = find (parent, name);
+	if (d == NULL) {
+		if (hash_size (&dentries) >= DCACHE_SIZE)
+			evict (list_entry (list_back (&lru_list), struct dentry, lru_elem));
+		d = malloc (sizeof *d);
+		if (d == NULL) {
+			lock_release (&dcache_lock);
+			return;
+		}
+		d->parent = parent;
+		strlcpy (d->name, name, sizeof d->name);
+		d->target = NULL;
+		hash_insert (&dentries, &d->hash_elem);
+	} else {
+		list_remove (&d->lru_elem);
+		if (d->sector != sector) {
+			free (d->target);
+			d->target = NULL;
+		}
+	}
+	list_push_front (&lru_list, &d->lru_elem);
+	d->sector = sector;
+	d->type = type;
+	lock_release (&dcache_lock);
+}
+
+/* Returns a copy, which the caller must free, of the target of the
+ * symbolic link in SECTOR that NAME in the directory whose inode is
+ * in PARENT refers to.  Returns a null pointer if the target is not
+ * cached or memory allocation fails. */
+char *
+dcache_get_link (disk_sector_t parent, const char *name,
+		disk_sector_t sector) {
+	struct dentry *d;
+	char *target = NULL;
+
+	lock_acquire (&dcache_lock);
+	d = find (parent, name);
+	if (d != NULL && d->sector == sector && d->target != NULL) {
+		size_t size = strlen (d->target) + 1;
+		target = malloc (size);
+		if (target != NULL)
+			memcpy (target, d->target, size);
+	}
+	lock_release (&dcache_lock);
+	return target;
+}
+
+/* Records TARGET as the target of the symbolic link in SECTOR that
+ * NAME in the directory whose inode is in PARENT refers to, so that
+ * following the link again does not read its inode.  A link's
+ * target never changes, so it stays valid as long as the entry. */
+void
+dcache_set_link (disk_sector_t parent, const char *name,
+		disk_sector_t sector, const char *target) {
+	struct dentry *d;
+
+	lock_acquire (&dcache_lock);
+	d = find (parent, name);
+	if (d != NULL && d->sector == sector && d->target == NULL) {
+		size_t size = strlen (target) + 1;
+		d->target = malloc (size);
+		if (d->target != NULL)
+			memcpy (d->target, target, size);
+	}
+	lock_release (&dcache_lock);
+}
+
+/* Forgets whatever is known about NAME in the directory whose inode
+ * is in PARENT.  Called whenever the entry is added or removed. */
+void
+dcache_remove (disk_sector_t parent, const char *name) {
+	struct dentry *d;
+
+	lock_acquire (&dcache_lock);
+	d = find (parent, name);
+	if (d != NULL)
+		evict (d);
+	lock_release (&dcache_lock);
+}
+
+/* Forgets every entry of the directory whose inode is in PARENT.
+ * Called when the directory is removed or its sector is given a
+ * new directory. */
+void
+dcache_purge (disk_sector_t parent) {
+	struct list_elem *e;
+
+	lock_acquire (&dcache_lock);
+	for (e = list_begin (&lru_list); e != list_end (&lru_list); ) {
+		struct dentry *d = list_entry (e, struct dentry, lru_elem);
+		e = list_next (e);
+		if (d->parent == parent)
+			evict (d);
+	}
+	lock_release (&dcache_lock);
+}
@@ -1,29 +1,298 @@
 #include "filesys/directory.h"
 #include <stdio.h>
 #include <string.h>
+#include <hash.h>
 #include <list.h>
+#include "filesys/dcache.h"
 #include "filesys/filesys.h"
 #include "filesys/inode.h"
 #include "threads/malloc.h"
+#include "threads/synch.h"
 
 /* A directory. */
 struct dir {
 	struct inode *inode;                /* Backing store. */
 	off_t pos;                          /* Current position. */
+	struct dir_index *index;            /* Index of the entries. */
 };
 
 /* A single directory entry. */
 struct dir_entry {
 	disk_sector_t inode_sector;         /* Sector number of header. */
 	char name[NAME_MAX + 1];            /* Null terminated file name. */
-	bool in_use;                        /* In use or free? */
+	uint8_t type;                       /* DT_REG, DT_DIR or DT_LNK, 0 if free. */
 };
 
+/* In-memory index of one directory's entries.
+ * It is built by reading the directory once, the first time it is
+ * opened, and is then kept in sync by dir_add() and dir_remove(),
+ * so that looking up, adding or removing a name never scans the
+ * directory on disk.  LOCK is held for reading by lookups and for
+ * writing by dir_add() and dir_remove(). */
+struct dir_index {
+	struct list_elem elem;              /* Element in dir_indexes. */
+	disk_sector_t sector;               /* Directory's inode sector. */
+	int open_cnt;                       /* Number of struct dirs using it. */
+	bool loaded;                        /* Built from the directory yet? */
+	bool failed;                        /* Ran out of memory building it? */
+	struct rwlock lock;                 /* Guards the members below. */
+	struct hash entries;                /* In-use entries, keyed by name. */
+	struct list free_slots;             /* Entries not in use. */
+};
+
+/* A directory entry in a struct dir_index. */
+struct dir_index_entry {
+	struct hash_elem hash_elem;         /* Element in entries, if in use. */
+	struct list_elem list_elem;         /* Element in free_slots, if not. */
+	off_t ofs;                          /* Byte offset of the entry. */
+	disk_sector_t inode_sector;         /* Sector number of header. */
+	char name[NAME_MAX + 1];            /* Null terminated file name. */
+	uint8_t type;                       /* DT_REG, DT_DIR or DT_LNK. */
+};
+
+/* Maximum number of indexes of directories that nobody has open to
+ * keep around, so that reopening a recently used directory does not
+ * rebuild its index. */
+#define DIR_INDEX_CACHE_CNT 16
+
+/* Number of directory entries read at a time while building an
+ * index.  128 entries are exactly 5 sectors. */
+#define DIR_INDEX_READ_CNT 128
+
+/* Indexes of directories, most recently opened first.
+ * dir_index_lock guards the list and the open_cnt, loaded and
+ * failed of every index in it.  An index is put in the list before
+ * it is built, which happens without the lock; dir_index_built is
+ * signaled once it has been. */
+static struct list dir_indexes;
+static size_t dir_index_cnt;
+static struct lock dir_index_lock;
+static struct condition dir_index_built;
+
+/* Initializes the directory module. */
+void
+dir_init (void) {
+	list_init (&dir_indexes);
+	dir_index_cnt = 0;
+	lock_init (&dir_index_lock);
+	cond_init (&dir_index_built);
+}
+
+static uint64_t
+dir_index_entry_hash (const struct hash_elem *e, void *aux UNUSED) {
+	const struct dir_index_entry *ie =
+		hash_entry (e, struct dir_index_entry, hash_elem);
+	return hash_string (ie->name);
+}
+
+static bool
+dir_index_entry_less (const struct hash_elem *a_, const struct hash_elem *b_,
+		void *aux UNUSED) {
+	const struct dir_index_entry *a =
+		hash_entry (a_, struct dir_index_entry, hash_elem);
+	const struct dir_index_entry *b =
+		hash_entry (b_, struct dir_index_entry, hash_elem);
+	return strcmp (a->name, b->name) < 0;
+}
+
+static void
+dir_index_entry_free (struct hash_elem *e, void *aux UNUSED) {
+	free (hash_entry (e, struct dir_index_entry, hash_elem));
+}
+
+/* Frees INDEX, which must not be in dir_indexes. */
+static void
+dir_index_free (struct dir_index *index) {
+	while (!list_empty (&index->free_slots))
+		free (list_entry (list_pop_front (&index->free_slots),
+					struct dir_index_entry, list_elem));
+	hash_destroy (&index->entries, dir_index_entry_free);
+	free (index);
+}
+
+/* Returns a new, empty index for the directory whose inode is in
+ * SECTOR, or a null pointer if memory allocation fails. */
+static struct dir_index *
+dir_index_new (disk_sector_t sector) {
+	struct dir_index *index = malloc (sizeof *index);
+
+	if (index == NULL
+			|| !hash_init (&index->entries, dir_index_entry_hash,
+				dir_index_entry_less, NULL)) {
+		free (index);
+		return NULL;
+	}
+	index->sector = sector;
+	index->open_cnt = 0;
+	index->loaded = false;
+	index->failed = false;
+	rwlock_init (&index->lock);
+	list_init (&index->free_slots);
+	return index;
+}
+
+/* Reads the directory in INODE into INDEX, a new index.  Returns
+ * false if memory allocation fails. */
+static bool
+dir_index_build (struct dir_index *index, struct inode *inode) {
+	struct dir_entry *entries;
+	off_t ofs = 0;
+	off_t bytes_read;
+
+	entries = malloc (DIR_INDEX_READ_CNT * sizeof *entries);
+	if (entries == NULL)
+		return false;
+
+	/* Read whole sectors' worth of entries at a time. */
+	while ((bytes_read = inode_read_at (inode, entries,
+					DIR_INDEX_READ_CNT * sizeof *entries, ofs))
+			>= (off_t) sizeof *entries) {
+		size_t cnt = bytes_read / sizeof *entries;
+		size_t i;
+
+		for (i = 0; i < cnt; i++, ofs += sizeof *entries) {
+			struct dir_index_entry *ie = malloc (sizeof *ie);
+			if (ie == NULL) {
+				free (entries);
+				return false;
+			}
+			ie->ofs = ofs;
+			ie->inode_sector = entries[i].inode_sector;
+			strlcpy (ie->name, entries[i].name, sizeof ie->name);
+			ie->type = entries[i].type;
+			if (entries[i].type != 0)
+				hash_insert (&index->entries, &ie->hash_elem);
+			else
+				list_push_back (&index->free_slots, &ie->list_elem);
+		}
+	}
+	free (entries);
+	return true;
+}
+
+/* Returns the index of the directory in INODE, building it if it is
+ * not cached, and marks it in use.  Returns a null pointer if
+ * memory allocation fails.
+ * The directory is read without dir_index_lock, so that opening
+ * other directories need not wait for the disk.  Whoever opens the
+ * same directory meanwhile waits until its index is built. */
+static struct dir_index *
+dir_index_get (struct inode *inode) {
+	disk_sector_t sector = inode_get_inumber (inode);
+	struct dir_index *index = NULL;
+	struct list_elem *e;
+	bool build = false;
+
+	lock_acquire (&dir_index_lock);
+	for (e = list_begin (&dir_indexes); e != list_end (&dir_indexes);
+			e = list_next (e))
+		if (list_entry (e, struct dir_index, elem)->sector == sector) {
+			index = list_entry (e, struct dir_index, elem);
+			list_remove (&index->elem);
+			break;
+		}
+
+	if (index == NULL) {
+		index = dir_index_new (sector);
+		if (index == NULL) {
+			lock_release (&dir_index_lock);
+			return NULL;
+		}
+		dir_index_cnt++;
+		build = true;
+	}
+	list_push_front (&dir_indexes, &index->elem);
+	index->open_cnt++;
+
+	/* Drop the least recently used indexes that nobody has open. */
+	for (e = list_rbegin (&dir_indexes);
+			e != list_rend (&dir_indexes) && dir_index_cnt > DIR_INDEX_CACHE_CNT; ) {
+		struct dir_index *victim = list_entry (e, struct dir_index, elem);
+		e = list_prev (e);
+		if (victim->open_cnt == 0) {
+			list_remove (&victim->elem);
+			dir_index_free (victim);
+			dir_index_cnt--;
+		}
+	}
+
+	if (build) {
+		bool success;
+
+		lock_release (&dir_index_lock);
+		success = dir_index_build (index, inode);
+		lock_acquire (&dir_index_lock);
+		index->loaded = true;
+		if (!success) {
+			/* Nobody else may find it from now on. */
+			index->failed = true;
+			list_remove (&index->elem);
+			dir_index_cnt--;
+		}
+		cond_broadcast (&dir_index_built, &dir_index_lock);
+	}
+	while (!index->loaded)
+		cond_wait (&dir_index_built, &dir_index_lock);
+	if (index->failed) {
+		if (--index->open_cnt == 0)
+			dir_index_free (index);
+		index = NULL;
+	}
+	lock_release (&dir_index_lock);
+	return index;
+}
+
+/* Marks INDEX as no longer used by one struct dir. */
+static void
+dir_index_put (struct dir_index *index) {
+	lock_acquire (&dir_index_lock);
+	ASSERT (index->open_cnt > 0);
+	index->open_cnt--;
+	lock_release (&dir_index_lock);
+}
+
+/* Discards the cached index, if any, of the directory whose inode
+ * is in SECTOR.  Called when SECTOR is given a new directory. */
+static void
+dir_index_invalidate (disk_sector_t sector) {
+	struct list_elem *e;
+
+	lock_acquire (&dir_index_lock);
+	for (e = list_begin (&dir_indexes); e != list_end (&dir_indexes);
+			e = list_next (e)) {
+		struct dir_index *index = list_entry (e, struct dir_index, elem);
+		if (index->sector == sector) {
+			ASSERT (index->open_cnt == 0);
+			list_remove (&index->elem);
+			dir_index_free (index);
+			dir_index_cnt--;
+			break;
+		}
+	}
+	lock_release (&dir_index_lock);
+}
+
 /* Creates a directory with space for ENTRY_CNT entries in the
- * given SECTOR.  Returns true if successful, false on failure. */
+ * given SECTOR, whose parent directory's inode is in sector PARENT.
+ * The new directory holds the entries "." and "..", which refer to
+ * itself and to PARENT.
+ * Returns true if successful, false on failure. */
 bool
-dir_create (disk_sector_t sector, size_t entry_cnt) {
-	return inode_create (sector, entry_cnt * sizeof (struct dir_entry));
+dir_create (disk_sector_t sector, size_t entry_cnt, disk_sector_t parent) {
+	struct dir *dir;
+	bool success;
+
+	dir_index_invalidate (sector);
+	dcache_purge (sector);
+	if (!inode_create (sector, entry_cnt * sizeof (struct dir_entry), true))
+		return false;
+
+	dir = dir_open (inode_open (sector));
+	success = (dir != NULL
+			&& dir_add (dir, ".", sector, DT_DIR)
+			&& dir_add (dir, "..", parent, DT_DIR));
+	dir_close (dir);
+	return success;
 }
 
 /* Opens and returns the directory for the given INODE, of which
@@ -31,7 +300,8 @@ dir_create (disk_sector_t sector, size_t entry_cnt) {
 struct dir *
 dir_open (struct inode *inode) {
 	struct dir *dir = calloc (1, sizeof *dir);
-	if (inode != NULL && dir != NULL) {
+	if (inode != NULL && dir != NULL
+			&& (dir->index = dir_index_get (inode)) != NULL) {
 		dir->inode = inode;
 		dir->pos = 0;
 		return dir;
@@ -60,6 +330,7 @@ dir_reopen (struct dir *dir) {
 void
 dir_close (struct dir *dir) {
 	if (dir != NULL) {
+		dir_index_put (dir->index);
 		inode_close (dir->inode);
 		free (dir);
 	}
@@ -72,61 +343,69 @@ dir_get_inode (struct dir *dir) {
 }
 
 /* Searches DIR for a file with the given NAME.
- * If successful, returns true, sets *EP to the directory entry
- * if EP is non-null, and sets *OFSP to the byte offset of the
- * directory entry if OFSP is non-null.
- * otherwise, returns false and ignores EP and OFSP. */
-static bool
-lookup (const struct dir *dir, const char *name,
-		struct dir_entry *ep, off_t *ofsp) {
-	struct dir_entry e;
-	size_t ofs;
+ * Returns its entry in DIR's index if successful, otherwise a null
+ * pointer. */
+static struct dir_index_entry *
+lookup (const struct dir *dir, const char *name) {
+	struct dir_index_entry key;
+	struct hash_elem *e;
 
 	ASSERT (dir != NULL);
 	ASSERT (name != NULL);
 
-	for (ofs = 0; inode_read_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
-			ofs += sizeof e)
-		if (e.in_use && !strcmp (name, e.name)) {
-			if (ep != NULL)
-				*ep = e;
-			if (ofsp != NULL)
-				*ofsp = ofs;
-			return true;
-		}
-	return false;
+	if (strlen (name) > NAME_MAX)
+		return NULL;
+	strlcpy (key.name, name, sizeof key.name);
+	e = hash_find (&dir->index->entries, &key.hash_elem);
+	return e != NULL ? hash_entry (e, struct dir_index_entry, hash_elem) : NULL;
 }
 
 /* Searches DIR for a file with the given NAME
  * and returns true if one exists, false otherwise.
+ * A directory that has been removed contains nothing, not even
+ * "." and "..".
  * On success, sets *INODE to an inode for the file, otherwise to
- * a null pointer.  The caller must close *INODE. */
+ * a null pointer.  The caller must close *INODE.
+ * The answer is recorded in the directory entry cache while DIR's
+ * index is still locked, so that it cannot overtake the
+ * dcache_remove() of a dir_add() or dir_remove() that changes it. */
 bool
 dir_lookup (const struct dir *dir, const char *name,
 		struct inode **inode) {
-	struct dir_entry e;
+	disk_sector_t sector;
+	struct dir_index_entry *ie;
 
 	ASSERT (dir != NULL);
 	ASSERT (name != NULL);
 
-	if (lookup (dir, name, &e, NULL))
-		*inode = inode_open (e.inode_sector);
-	else
+	sector = inode_get_inumber (dir->inode);
+	rwlock_acquire_read (&dir->index->lock);
+	ie = inode_is_removed (dir->inode) ? NULL : lookup (dir, name);
+	if (ie != NULL) {
+		*inode = inode_open (ie->inode_sector);
+		if (*inode != NULL)
+			dcache_insert (sector, name, ie->inode_sector, ie->type);
+	} else {
 		*inode = NULL;
+		dcache_insert (sector, name, 0, DT_REG);
+	}
+	rwlock_release_read (&dir->index->lock);
 
 	return *inode != NULL;
 }
 
 /* Adds a file named NAME to DIR, which must not already contain a
  * file by that name.  The file's inode is in sector
- * INODE_SECTOR.
+ * INODE_SECTOR, and TYPE is DT_REG, DT_DIR or DT_LNK.
  * Returns true if successful, false on failure.
- * Fails if NAME is invalid (i.e. too long) or a disk or memory
- * error occurs. */
+ * Fails if NAME is invalid (i.e. too long), if DIR has been
+ * removed, or if a disk or memory error occurs. */
 bool
-dir_add (struct dir *dir, const char *name, disk_sector_t inode_sector) {
+dir_add (struct dir *dir, const char *name, disk_sector_t inode_sector,
+		int type) {
+	struct dir_index_entry *ie;
 	struct dir_entry e;
-	off_t ofs;
+	bool append;
 	bool success = false;
 
 	ASSERT (dir != NULL);
@@ -136,81 +415,194 @@ dir_add (struct dir *dir, const char *name, disk_sector_t inode_sector) {
 	if (*name == '\0' || strlen (name) > NAME_MAX)
 		return false;
 
-	/* Check that NAME is not in use. */
-	if (lookup (dir, name, NULL, NULL))
+	rwlock_acquire_write (&dir->index->lock);
+
+	/* Nothing may be added to a removed directory. */
+	if (inode_is_removed (dir->inode))
 		goto done;
 
-	/* Set OFS to offset of free slot.
-	 * If there are no free slots, then it will be set to the
-	 * current end-of-file.
+	/* Check that NAME is not in use. */
+	if (lookup (dir, name) != NULL)
+		goto done;
 
-	 * inode_read_at() will only return a short read at end of file.
-	 * Otherwise, we'd need to verify that we didn't get a short
-	 * read due to something intermittent such as low memory. */
-	for (ofs = 0; inode_read_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
-			ofs += sizeof e)
-		if (!e.in_use)
-			break;
+	/* Take a free slot, or if there are none, append a new one at
+	 * the current end-of-file. */
+	append = list_empty (&dir->index->free_slots);
+	if (append) {
+		ie = malloc (sizeof *ie);
+		if (ie == NULL)
+			goto done;
+		ie->ofs = inode_length (dir->inode);
+	} else
+		ie = list_entry (list_front (&dir->index->free_slots),
+				struct dir_index_entry, list_elem);
 
 	/* Write slot. */
-	e.in_use = true;
+	e.type = type;
 	strlcpy (e.name, name, sizeof e.name);
 	e.inode_sector = inode_sector;
-	success = inode_write_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
+	if (inode_write_at (dir->inode, &e, sizeof e, ie->ofs) != sizeof e) {
+		if (append)
+			free (ie);
+		goto done;
+	}
+
+	/* Move the slot into the index. */
+	if (!append)
+		list_remove (&ie->list_elem);
+	strlcpy (ie->name, name, sizeof ie->name);
+	ie->inode_sector = inode_sector;
+	ie->type = type;
+	hash_insert (&dir->index->entries, &ie->hash_elem);
+	dcache_remove (inode_get_inumber (dir->inode), name);
+	success = true;
 
 done:
+	rwlock_release_write (&dir->index->lock);
 	return success;
 }
 
+/* Returns true if DIR contains no entries but "." and "..". */
+static bool
+dir_is_empty (struct dir *dir) {
+	return hash_size (&dir->index->entries) <= 2;
+}
+
 /* Removes any entry for NAME in DIR.
  * Returns true if successful, false on failure,
- * which occurs only if there is no file with the given NAME. */
+ * which occurs if there is no file with the given NAME, if NAME is
+ * "." or "..", or if NAME is a directory that is not empty. */
 bool
 dir_remove (struct dir *dir, const char *name) {
+	struct dir_index_entry *ie;
 	struct dir_entry e;
 	struct inode *inode = NULL;
+	struct dir *child = NULL;
 	bool success = false;
-	off_t ofs;
 
 	ASSERT (dir != NULL);
 	ASSERT (name != NULL);
 
+	if (!strcmp (name, ".") || !strcmp (name, ".."))
+		return false;
+
+	rwlock_acquire_write (&dir->index->lock);
+
 	/* Find directory entry. */
-	if (!lookup (dir, name, &e, &ofs))
+	ie = lookup (dir, name);
+	if (ie == NULL)
 		goto done;
 
 	/* Open inode. */
-	inode = inode_open (e.inode_sector);
+	inode = inode_open (ie->inode_sector);
 	if (inode == NULL)
 		goto done;
 
+	/* Only empty directories may be removed.  Keep the directory
+	 * locked until it is marked removed, so that nothing can be
+	 * added to it in the meantime. */
+	if (inode_is_dir (inode)) {
+		child = dir_open (inode_reopen (inode));
+		if (child == NULL)
+			goto done;
+		rwlock_acquire_write (&child->index->lock);
+		if (!dir_is_empty (child))
+			goto done;
+	}
+
 	/* Erase directory entry. */
-	e.in_use = false;
-	if (inode_write_at (dir->inode, &e, sizeof e, ofs) != sizeof e)
+	e.type = 0;
+	e.inode_sector = ie->inode_sector;
+	strlcpy (e.name, ie->name, sizeof e.name);
+	if (inode_write_at (dir->inode, &e, sizeof e, ie->ofs) != sizeof e)
 		goto done;
-
-	/* Remove inode. */
-	inode_remove (inode);
+	hash_delete (&dir->index->entries, &ie->hash_elem);
+	list_push_front (&dir->index->free_slots, &ie->list_elem);
+	dcache_remove (inode_get_inumber (dir->inode), name);
+
+	/* Remove the inode if this was its last name. */
+	inode_unlink (inode);
+	if (child != NULL)
+		dcache_purge (inode_get_inumber (inode));
 	success = true;
 
 done:
+	if (child != NULL) {
+		rwlock_release_write (&child->index->lock);
+		dir_close (child);
+	}
+	rwlock_release_write (&dir->index->lock);
 	inode_close (inode);
 	return success;
 }
 
 /* Reads the next directory entry in DIR and stores the name in
  * NAME.  Returns true if successful, false if the directory
- * contains no more entries. */
+ * contains no more entries.  "." and ".." are skipped. */
 bool
 dir_readdir (struct dir *dir, char name[NAME_MAX + 1]) {
 	struct dir_entry e;
 
 	while (inode_read_at (dir->inode, &e, sizeof e, dir->pos) == sizeof e) {
 		dir->pos += sizeof e;
-		if (e.in_use) {
+		if (e.type != 0 && strcmp (e.name, ".") && strcmp (e.name, "..")) {
 			strlcpy (name, e.name, NAME_MAX + 1);
 			return true;
 		}
 	}
 	return false;
 }
+
+/* Reads up to CNT of the next entries in DIR into ENTS, like
+ * dir_readdir() but a run of whole sectors at a time, and returns
+ * the number read, 0 if the directory contains no more entries, or
+ * -1 if memory allocation fails.  "." and ".." are skipped. */
+int
+dir_read_entries (struct dir *dir, struct dirent *ents, size_t cnt) {
+	struct dir_entry *entries;
+	size_t n = 0;
+
+	entries = malloc (DIR_INDEX_READ_CNT * sizeof *entries);
+	if (entries == NULL)
+		return -1;
+	while (n < cnt) {
+		off_t bytes_read = inode_read_at (dir->inode, entries,
+				DIR_INDEX_READ_CNT * sizeof *entries, dir->pos);
+		size_t read_cnt = bytes_read / sizeof *entries;
+		size_t i;
+
+		if (read_cnt == 0)
+			break;
+		for (i = 0; i < read_cnt && n < cnt; i++) {
+			struct dir_entry *e = &entries[i];
+
+			dir->pos += sizeof *e;
+			if (e->type == 0 || !strcmp (e->name, ".")
+					|| !strcmp (e->name, ".."))
+				continue;
+			ents[n].d_ino = e->inode_sector;
+			ents[n].d_type = e->type;
+			strlcpy (ents[n].d_name, e->name, sizeof ents[n].d_name);
+			n++;
+		}
+	}
+	free (entries);
+	return n;
+}
+
+/* Sets the position from which dir_readdir() reads DIR's next
+ * entry to POS, a value previously returned by dir_tell(). */
+void
+dir_seek (struct dir *dir, off_t pos) {
+	ASSERT (dir != NULL);
+	ASSERT (pos >= 0);
+	dir->pos = pos;
+}
+
+/* Returns the position from which dir_readdir() reads DIR's next
+ * entry. */
+off_t
+dir_tell (struct dir *dir) {
+	ASSERT (dir != NULL);
+	return dir->pos;
+}
@@ -31,6 +31,21 @@ static struct fat_fs *fat_fs;
 void fat_boot_create (void);
 void fat_fs_init (void);
 
+// Reads, or writes if WRITE is true, CNT sectors of the FAT area
+// starting at SECTOR, counting them as FAT accesses in the disk
+// statistics.
+static void
+fat_disk_io (disk_sector_t sector, void *buffer, size_t cnt, bool write) {
+	struct disk_request r;
+
+	if (cnt == 0)
+		return;
+	disk_request_init (&r, filesys_disk, sector, buffer, cnt, write);
+	r.user = DISK_USER_FAT;
+	disk_submit (&r, NULL, NULL);
+	disk_wait (&r);
+}
+
 void
 fat_init (void) {
 	fat_fs = calloc (1, sizeof (struct fat_fs));
@@ -41,7 +56,7 @@ fat_init (void) {
 	unsigned int *bounce = malloc (DISK_SECTOR_SIZE);
 	if (bounce == NULL)
 		PANIC ("FAT init failed");
-	disk_read (filesys_disk, FAT_BOOT_SECTOR, bounce);
+	fat_disk_io (FAT_BOOT_SECTOR, bounce, 1, false);
 	memcpy (&fat_fs->bs, bounce, sizeof (fat_fs->bs));
 	free (bounce);
 
@@ -57,26 +72,21 @@ fat_open (void) {
 	if (fat_fs->fat == NULL)
 		PANIC ("FAT load failed");
 
-	// Load FAT directly from the disk
+	// Load FAT directly from the disk, all of its whole sectors with
+	// as few commands as possible, and then the partial sector at its
+	// end, if any.
 	uint8_t *buffer = (uint8_t *) fat_fs->fat;
-	off_t bytes_read = 0;
-	off_t bytes_left = sizeof (fat_fs->fat);
 	const off_t fat_size_in_bytes = fat_fs->fat_length * sizeof (cluster_t);
-	for (unsigned i = 0; i < fat_fs->bs.fat_sectors; i++) {
-		bytes_left = fat_size_in_bytes - bytes_read;
-		if (bytes_left >= DISK_SECTOR_SIZE) {
-			disk_read (filesys_disk, fat_fs->bs.fat_start + i,
-			           buffer + bytes_read);
-			bytes_read += DISK_SECTOR_SIZE;
-		} else {
-			uint8_t *bounce = malloc (DISK_SECTOR_SIZE);
-			if (bounce == NULL)
-				PANIC ("FAT load failed");
-			disk_read (filesys_disk, fat_fs->bs.fat_start + i, bounce);
-			memcpy (buffer + bytes_read, bounce, bytes_left);
-			bytes_read += bytes_left;
-			free (bounce);
-		}
+	const size_t whole = fat_size_in_bytes / DISK_SECTOR_SIZE;
+	const off_t bytes_left = fat_size_in_bytes % DISK_SECTOR_SIZE;
+	fat_disk_io (fat_fs->bs.fat_start, buffer, whole, false);
+	if (bytes_left > 0) {
+		uint8_t *bounce = malloc (DISK_SECTOR_SIZE);
+		if (bounce == NULL)
+			PANIC ("FAT load failed");
+		fat_disk_io (fat_fs->bs.fat_start + whole, bounce, 1, false);
+		memcpy (buffer + whole * DISK_SECTOR_SIZE, bounce, bytes_left);
+		free (bounce);
 	}
 }
 
@@ -87,29 +97,22 @@ fat_close (void) {
 	if (bounce == NULL)
 		PANIC ("FAT close failed");
 	memcpy (bounce, &fat_fs->bs, sizeof (fat_fs->bs));
-	disk_write (filesys_disk, FAT_BOOT_SECTOR, bounce);
+	fat_disk_io (FAT_BOOT_SECTOR, bounce, 1, true);
 	free (bounce);
 
-	// Write FAT directly to the disk
+	// Write FAT directly to the disk, the same way fat_open() reads it
 	uint8_t *buffer = (uint8_t *) fat_fs->fat;
-	off_t bytes_wrote = 0;
-	off_t bytes_left = sizeof (fat_fs->fat);
 	const off_t fat_size_in_bytes = fat_fs->fat_length * sizeof (cluster_t);
-	for (unsigned i = 0; i < fat_fs->bs.fat_sectors; i++) {
-		bytes_left = fat_size_in_bytes - bytes_wrote;
-		if (bytes_left >= DISK_SECTOR_SIZE) {
-			disk_write (filesys_disk, fat_fs->bs.fat_start + i,
-			            buffer + bytes_wrote);
-			bytes_wrote += DISK_SECTOR_SIZE;
-		} else {
-			bounce = calloc (1, DISK_SECTOR_SIZE);
-			if (bounce == NULL)
-				PANIC ("FAT close failed");
-			memcpy (bounce, buffer + bytes_wrote, bytes_left);
-			disk_write (filesys_disk, fat_fs->bs.fat_start + i, bounce);
-			bytes_wrote += bytes_left;
-			free (bounce);
-		}
+	const size_t whole = fat_size_in_bytes / DISK_SECTOR_SIZE;
+	const off_t bytes_left = fat_size_in_bytes % DISK_SECTOR_SIZE;
+	fat_disk_io (fat_fs->bs.fat_start, buffer, whole, true);
+	if (bytes_left > 0) {
+		bounce = calloc (1, DISK_SECTOR_SIZE);
+		if (bounce == NULL)
+			PANIC ("FAT close failed");
+		memcpy (bounce, buffer + whole * DISK_SECTOR_SIZE, bytes_left);
+		fat_disk_io (fat_fs->bs.fat_start + whole, bounce, 1, true);
+		free (bounce);
 	}
 }
 
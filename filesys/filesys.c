@@ -2,11 +2,20 @@
 #include <debug.h>
 #include <stdio.h>
 #include <string.h>
+#include "filesys/buffer-cache.h"
 #include "filesys/file.h"
 #include "filesys/free-map.h"
 #include "filesys/inode.h"
+#include "filesys/journal.h"
 #include "filesys/directory.h"
+#include "filesys/dcache.h"
 #include "devices/disk.h"
+#include "threads/malloc.h"
+#include "threads/thread.h"
+
+/* Most symbolic links followed while resolving one path, so that
+ * links that refer to each other in a loop are detected. */
+#define SYMLOOP_MAX 8
 
 /* The disk that contains the file system. */
 struct disk *filesys_disk;
@@ -20,8 +29,12 @@ filesys_init (bool format) {
 	filesys_disk = disk_get (0, 1);
 	if (filesys_disk == NULL)
 		PANIC ("hd0:1 (hdb) not present, file system initialization failed");
+	disk_set_user (filesys_disk, DISK_USER_FS);
 
+	buffer_cache_init ();
 	inode_init ();
+	dir_init ();
+	dcache_init ();
 
 #ifdef EFILESYS
 	fat_init ();
@@ -32,6 +45,7 @@ filesys_init (bool format) {
 	fat_open ();
 #else
 	/* Original FS */
+	journal_init (format);
 	free_map_init ();
 
 	if (format)
@@ -49,59 +63,428 @@ filesys_done (void) {
 #ifdef EFILESYS
 	fat_close ();
 #else
+	inode_flush ();
 	free_map_close ();
+	journal_done ();
 #endif
+	buffer_cache_flush ();
+}
+
+/* Extracts a file name part from *SRCP into PART, and updates *SRCP
+ * so that the next call will return the next file name part.
+ * Returns 1 if successful, 0 at end of string, -1 for a too-long
+ * file name part. */
+static int
+get_next_part (char part[NAME_MAX + 1], const char **srcp) {
+	const char *src = *srcp;
+	char *dst = part;
+
+	/* Skip leading slashes.  If it's all slashes, we're done. */
+	while (*src == '/')
+		src++;
+	if (*src == '\0')
+		return 0;
+
+	/* Copy up to NAME_MAX character from SRC to DST.  Add null
+	 * terminator. */
+	while (*src != '/' && *src != '\0') {
+		if (dst < part + NAME_MAX)
+			*dst++ = *src;
+		else
+			return -1;
+		src++;
+	}
+	*dst = '\0';
+
+	/* Advance source pointer. */
+	*srcp = src;
+	return 1;
+}
+
+/* Returns the inode of the running thread's working directory,
+ * which relative paths start from, or a null pointer for the root
+ * directory.  The reference is the working directory's own. */
+static struct inode *
+cwd_inode (void) {
+	struct dir *cwd = thread_current ()->cwd;
+
+	return cwd != NULL ? dir_get_inode (cwd) : NULL;
+}
+
+/* Returns the type of the file in INODE: DT_REG, DT_DIR or
+ * DT_LNK. */
+static int
+inode_type (const struct inode *inode) {
+	if (inode_is_dir (inode))
+		return DT_DIR;
+	return inode_is_symlink (inode) ? DT_LNK : DT_REG;
+}
+
+/* Looks up NAME in the directory PARENT.  If it exists, sets *TYPE
+ * to its type and returns its inode, opened, which the caller must
+ * close.  Otherwise, returns a null pointer.  A symbolic link is
+ * not followed.
+ * Answers come from the directory entry cache when possible, and
+ * dir_lookup() adds them to it when not, so that resolving the
+ * same path again does not touch the disk.  Either way the inode
+ * is opened while the entry is known to refer to it, so that a
+ * file removed meanwhile cannot be confused with another file that
+ * reuses its sector. */
+static struct inode *
+lookup_child (struct inode *parent, const char *name, int *type) {
+	struct inode *inode;
+	struct dir *dir;
+
+	if (dcache_lookup (inode_get_inumber (parent), name, &inode, type))
+		return inode;
+
+	dir = dir_open (inode_reopen (parent));
+	if (dir == NULL || !dir_lookup (dir, name, &inode))
+		inode = NULL;
+	else
+		*type = inode_type (inode);
+	dir_close (dir);
+	return inode;
+}
+
+/* Returns the target of the symbolic link LINK that NAME in the
+ * directory PARENT refers to, as a new string that the caller must
+ * free, or a null pointer on failure.
+ * The target is cached along with the directory entry, so that
+ * following the link again does not read its data. */
+static char *
+read_link (struct inode *parent, const char *name, struct inode *link) {
+	disk_sector_t dir = inode_get_inumber (parent);
+	disk_sector_t sector = inode_get_inumber (link);
+	char *target;
+
+	target = dcache_get_link (dir, name, sector);
+	if (target != NULL || !inode_is_symlink (link))
+		return target;
+
+	target = inode_read_link (link);
+	if (target != NULL)
+		dcache_set_link (dir, name, sector, target);
+	return target;
+}
+
+static struct inode *resolve_parent_at (struct inode *start, const char *path,
+		char name[NAME_MAX + 1], int *links);
+
+/* Looks up NAME in the directory PARENT as lookup_child() does,
+ * but if NAME is a symbolic link, follows it, and any link it leads
+ * to, to the file it refers to, and returns that file's inode.
+ * *LINKS counts the links followed so far while resolving a path;
+ * there may be at most SYMLOOP_MAX. */
+static struct inode *
+lookup_follow (struct inode *parent, const char *name_, int *type,
+		int *links) {
+	char name[NAME_MAX + 1];
+	struct inode *dir = inode_reopen (parent);
+
+	strlcpy (name, name_, sizeof name);
+	for (;;) {
+		struct inode *inode = lookup_child (dir, name, type);
+		char *target;
+
+		if (inode == NULL || *type != DT_LNK) {
+			inode_close (dir);
+			return inode;
+		}
+
+		/* Follow a chain of links one at a time rather than
+		 * recursively, to save stack.  A relative target is relative
+		 * to the link's directory. */
+		target = ++*links <= SYMLOOP_MAX ? read_link (dir, name, inode) : NULL;
+		inode_close (inode);
+		inode = target != NULL
+			? resolve_parent_at (dir, target, name, links) : NULL;
+		free (target);
+		inode_close (dir);
+		if (inode == NULL)
+			return NULL;
+		dir = inode;
+		if (name[0] == '\0') {
+			*type = DT_DIR;
+			return dir;
+		}
+	}
+}
+
+/* Resolves all but the last component of PATH, starting from the
+ * directory START, or the root directory if START is null or PATH
+ * is absolute, and following symbolic links along the way.  On
+ * success, copies the last component into NAME and returns the
+ * inode of the directory that it belongs in, which the caller must
+ * close.  If PATH has no last component, as with "/", NAME is the
+ * empty string and the directory returned is the one PATH names.
+ * Returns a null pointer if the directory does not exist.  *LINKS
+ * counts the symbolic links followed, as for lookup_follow(). */
+static struct inode *
+resolve_parent_at (struct inode *start, const char *path,
+		char name[NAME_MAX + 1], int *links) {
+	char part[NAME_MAX + 1];
+	struct inode *dir;
+	int type;
+	int result = 0;
+
+	dir = *path == '/' || start == NULL
+		? inode_open (ROOT_DIR_SECTOR) : inode_reopen (start);
+	name[0] = '\0';
+	while (dir != NULL && (result = get_next_part (part, &path)) > 0) {
+		if (name[0] != '\0') {
+			struct inode *next = lookup_follow (dir, name, &type, links);
+
+			inode_close (dir);
+			if (next != NULL && type != DT_DIR) {
+				inode_close (next);
+				next = NULL;
+			}
+			dir = next;
+		}
+		strlcpy (name, part, NAME_MAX + 1);
+	}
+	if (dir != NULL && result < 0) {
+		inode_close (dir);
+		dir = NULL;
+	}
+	return dir;
+}
+
+/* Resolves PATH, following symbolic links, including one that PATH
+ * itself names.  On success, sets *TYPE to the type of the file
+ * PATH names and returns its inode, which the caller must close.
+ * Returns a null pointer if PATH does not name a file. */
+static struct inode *
+resolve (const char *path, int *type) {
+	char name[NAME_MAX + 1];
+	struct inode *parent;
+	struct inode *inode;
+	int links = 0;
+
+	parent = resolve_parent_at (cwd_inode (), path, name, &links);
+	if (parent == NULL || name[0] == '\0') {
+		*type = DT_DIR;
+		return parent;
+	}
+	inode = lookup_follow (parent, name, type, &links);
+	inode_close (parent);
+	return inode;
+}
+
+/* Resolves all but the last component of PATH, as
+ * resolve_parent_at() does, from the running thread's working
+ * directory.  Fails if PATH has no last component.  The last
+ * component itself is not followed even if it is a symbolic link,
+ * so that the link itself can be created or removed. */
+static struct inode *
+resolve_parent (const char *path, char name[NAME_MAX + 1]) {
+	struct inode *parent;
+	int links = 0;
+
+	parent = resolve_parent_at (cwd_inode (), path, name, &links);
+	if (parent != NULL && name[0] == '\0') {
+		inode_close (parent);
+		parent = NULL;
+	}
+	return parent;
+}
+
+/* Creates a file of type TYPE at PATH: a regular file INITIAL_SIZE
+ * bytes long, a directory, or a symbolic link to TARGET. */
+static bool
+create (const char *path, off_t initial_size, int type, const char *target) {
+	char name[NAME_MAX + 1];
+	struct inode *parent;
+	disk_sector_t parent_sector;
+	disk_sector_t inode_sector = 0;
+	struct dir *dir;
+	bool created = false;
+	bool success;
+
+	parent = resolve_parent (path, name);
+	if (parent == NULL)
+		return false;
+	parent_sector = inode_get_inumber (parent);
+
+	/* Allocating the inode, writing it and adding it to the
+	 * directory happen together or not at all. */
+	journal_begin ();
+	/* Put a file next to its directory, but start a directory in
+	 * the emptiest part of the disk. */
+	dir = dir_open (parent);
+	success = (dir != NULL
+			&& free_map_allocate (1,
+				type == DT_DIR ? free_map_dir_goal () : parent_sector,
+				&inode_sector)
+			&& (created = (type == DT_DIR
+					? dir_create (inode_sector, 16, parent_sector)
+					: type == DT_LNK
+					? inode_create_symlink (inode_sector, target)
+					: inode_create (inode_sector, initial_size, false)))
+			&& dir_add (dir, name, inode_sector, type));
+	if (!success && created) {
+		/* Removing the new inode releases its sector along with
+		 * its data. */
+		struct inode *inode = inode_open (inode_sector);
+		if (inode != NULL)
+			inode_remove (inode);
+		inode_close (inode);
+	} else if (!success && inode_sector != 0)
+		free_map_release (inode_sector, 1);
+	dir_close (dir);
+	journal_end ();
+
+	return success;
 }
 
 /* Creates a file named NAME with the given INITIAL_SIZE.
+ * NAME may be an absolute path or relative to the running
+ * thread's working directory.
  * Returns true if successful, false otherwise.
  * Fails if a file named NAME already exists,
  * or if internal memory allocation fails. */
 bool
 filesys_create (const char *name, off_t initial_size) {
-	disk_sector_t inode_sector = 0;
-	struct dir *dir = dir_open_root ();
-	bool success = (dir != NULL
-			&& free_map_allocate (1, &inode_sector)
-			&& inode_create (inode_sector, initial_size)
-			&& dir_add (dir, name, inode_sector));
-	if (!success && inode_sector != 0)
-		free_map_release (inode_sector, 1);
+	return create (name, initial_size, DT_REG, NULL);
+}
+
+/* Creates a directory named NAME.
+ * Returns true if successful, false otherwise.
+ * Fails if a file named NAME already exists,
+ * or if internal memory allocation fails. */
+bool
+filesys_mkdir (const char *name) {
+	return create (name, 0, DT_DIR, NULL);
+}
+
+/* Creates a symbolic link named NAME that refers to TARGET, which
+ * need not exist.  A relative TARGET is resolved from the
+ * directory that contains NAME each time the link is followed.
+ * Returns true if successful, false otherwise.
+ * Fails if TARGET is empty, if a file named NAME already exists,
+ * or if internal memory allocation fails. */
+bool
+filesys_symlink (const char *target, const char *name) {
+	if (*target == '\0')
+		return false;
+	return create (name, 0, DT_LNK, target);
+}
+
+/* Creates a new name NAME for the existing file OLD, which must not
+ * be a directory.  If OLD is a symbolic link, the new name refers
+ * to the link itself, not to its target.
+ * Returns true if successful, false otherwise.
+ * Fails if OLD does not exist, if a file named NAME already exists,
+ * or if internal memory allocation fails. */
+bool
+filesys_link (const char *old, const char *name) {
+	char part[NAME_MAX + 1];
+	struct inode *parent;
+	struct inode *inode = NULL;
+	struct dir *dir;
+	int type;
+	bool success;
+
+	parent = resolve_parent (old, part);
+	if (parent != NULL)
+		inode = lookup_child (parent, part, &type);
+	inode_close (parent);
+	if (inode == NULL || type == DT_DIR
+			|| (parent = resolve_parent (name, part)) == NULL) {
+		inode_close (inode);
+		return false;
+	}
+
+	/* The link count and the new entry change together. */
+	journal_begin ();
+	dir = dir_open (parent);
+	success = dir != NULL && inode_link (inode);
+	if (success && !dir_add (dir, part, inode_get_inumber (inode), type)) {
+		inode_unlink (inode);
+		success = false;
+	}
 	dir_close (dir);
+	inode_close (inode);
+	journal_end ();
 
 	return success;
 }
 
-/* Opens the file with the given NAME.
+/* Opens the file, or directory, with the given NAME.
  * Returns the new file if successful or a null pointer
  * otherwise.
  * Fails if no file named NAME exists,
  * or if an internal memory allocation fails. */
 struct file *
 filesys_open (const char *name) {
-	struct dir *dir = dir_open_root ();
 	struct inode *inode = NULL;
+	int type;
 
-	if (dir != NULL)
-		dir_lookup (dir, name, &inode);
-	dir_close (dir);
+	if (*name != '\0') {
+		inode = resolve (name, &type);
+		if (inode != NULL && inode_is_removed (inode)) {
+			inode_close (inode);
+			inode = NULL;
+		}
+	}
 
 	return file_open (inode);
 }
 
-/* Deletes the file named NAME.
+/* Deletes the file named NAME.  If it is a symbolic link, the link
+ * itself is deleted.  A file with other names lives on under them.
  * Returns true if successful, false on failure.
- * Fails if no file named NAME exists,
- * or if an internal memory allocation fails. */
+ * Fails if no file named NAME exists, if NAME is a directory that
+ * is not empty, or if an internal memory allocation fails. */
 bool
 filesys_remove (const char *name) {
-	struct dir *dir = dir_open_root ();
-	bool success = dir != NULL && dir_remove (dir, name);
+	char part[NAME_MAX + 1];
+	struct inode *parent;
+	struct dir *dir;
+	bool success;
+
+	parent = resolve_parent (name, part);
+	if (parent == NULL)
+		return false;
+	journal_begin ();
+	dir = dir_open (parent);
+	success = dir != NULL && dir_remove (dir, part);
 	dir_close (dir);
+	journal_end ();
 
 	return success;
 }
 
+/* Changes the running thread's working directory to NAME.
+ * Returns true if successful, false on failure. */
+bool
+filesys_chdir (const char *name) {
+	struct thread *t = thread_current ();
+	struct inode *inode;
+	struct dir *dir;
+	int type;
+
+	if (*name == '\0')
+		return false;
+	inode = resolve (name, &type);
+	if (inode == NULL || type != DT_DIR) {
+		inode_close (inode);
+		return false;
+	}
+	dir = dir_open (inode);
+	if (dir == NULL)
+		return false;
+	if (inode_is_removed (dir_get_inode (dir))) {
+		dir_close (dir);
+		return false;
+	}
+
+	dir_close (t->cwd);
+	t->cwd = dir;
+	return true;
+}
+
 /* Formats the file system. */
 static void
 do_format (void) {
@@ -113,9 +496,10 @@ do_format (void) {
 	fat_close ();
 #else
 	free_map_create ();
-	if (!dir_create (ROOT_DIR_SECTOR, 16))
+	if (!dir_create (ROOT_DIR_SECTOR, 16, ROOT_DIR_SECTOR))
 		PANIC ("root directory creation failed");
 	free_map_close ();
+	journal_commit ();
 #endif
 
 	printf ("done.\n");
@@ -1,12 +1,110 @@
 #include "filesys/free-map.h"
 #include <bitmap.h>
 #include <debug.h>
+#include <round.h>
 #include "filesys/file.h"
 #include "filesys/filesys.h"
 #include "filesys/inode.h"
+#include "filesys/journal.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
 
 static struct file *free_map_file;   /* Free map file. */
 static struct bitmap *free_map;      /* Free map, one bit per disk sector. */
+static bool free_map_dirty;          /* Free map changed since last written? */
+static struct lock free_map_lock;    /* Guards the free map and its file. */
+
+/* The disk is divided into locality groups of GROUP_SIZE sectors.
+ * Counting the free sectors of each group lets allocation skip
+ * groups that are full without scanning their bits. */
+#define GROUP_SIZE 512
+static size_t group_cnt;             /* Number of groups. */
+static size_t *group_free_cnt;       /* Free sectors in each group. */
+
+/* Free sectors on the whole disk, and how many of them are
+ * reserved for data whose allocation is delayed.  Only
+ * free_map_claim() may allocate reserved sectors. */
+static size_t free_cnt;
+static size_t reserved_cnt;
+
+/* Recounts the free sectors of every group. */
+static void
+count_groups (void) {
+	size_t g;
+
+	free_cnt = 0;
+	for (g = 0; g < group_cnt; g++) {
+		size_t start = g * GROUP_SIZE;
+		size_t cnt = bitmap_size (free_map) - start;
+		if (cnt > GROUP_SIZE)
+			cnt = GROUP_SIZE;
+		group_free_cnt[g] = bitmap_count (free_map, start, cnt, false);
+		free_cnt += group_free_cnt[g];
+	}
+}
+
+/* Marks the CNT sectors starting at SECTOR as in use if USED is
+ * true, or as free otherwise, keeping the group counts in step. */
+static void
+set_sectors (disk_sector_t sector, size_t cnt, bool used) {
+	size_t i;
+
+	bitmap_set_multiple (free_map, sector, cnt, used);
+	if (used)
+		free_cnt -= cnt;
+	else
+		free_cnt += cnt;
+	for (i = sector; i < sector + cnt; i++) {
+		if (used)
+			group_free_cnt[i / GROUP_SIZE]--;
+		else
+			group_free_cnt[i / GROUP_SIZE]++;
+	}
+	free_map_dirty = true;
+}
+
+/* Returns the first sector of a run of CNT free sectors in
+ * [START, END), or BITMAP_ERROR if there is none. */
+static size_t
+scan_range (size_t start, size_t end, size_t cnt) {
+	size_t i;
+
+	for (i = start; i + cnt <= end; i++)
+		if (!bitmap_test (free_map, i)
+				&& (cnt == 1 || !bitmap_any (free_map, i, cnt)))
+			return i;
+	return BITMAP_ERROR;
+}
+
+/* Finds CNT free consecutive sectors, as close after GOAL as
+ * possible, and returns the first, or BITMAP_ERROR if there are
+ * none.  Searches the rest of GOAL's group first, then each
+ * following group in turn, wrapping around at the end of the disk,
+ * and skips the groups that do not have CNT free sectors. */
+static size_t
+find_free (disk_sector_t goal, size_t cnt) {
+	size_t size = bitmap_size (free_map);
+	size_t first, i;
+
+	if (goal >= size)
+		goal = 0;
+	first = goal / GROUP_SIZE;
+	for (i = 0; i <= group_cnt; i++) {
+		size_t g = (first + i) % group_cnt;
+		size_t start = i == 0 ? goal : g * GROUP_SIZE;
+		size_t end = (g + 1) * GROUP_SIZE < size ? (g + 1) * GROUP_SIZE : size;
+		size_t sector;
+
+		if (group_free_cnt[g] < cnt && cnt <= GROUP_SIZE)
+			continue;
+		sector = scan_range (start, cnt <= GROUP_SIZE ? end : size, cnt);
+		if (sector != BITMAP_ERROR)
+			return sector;
+	}
+
+	/* A run may still straddle two groups. */
+	return bitmap_scan (free_map, 0, cnt, false);
+}
 
 /* Initializes the free map. */
 void
@@ -14,34 +112,128 @@ free_map_init (void) {
 	free_map = bitmap_create (disk_size (filesys_disk));
 	if (free_map == NULL)
 		PANIC ("bitmap creation failed--disk is too large");
+	group_cnt = DIV_ROUND_UP (bitmap_size (free_map), GROUP_SIZE);
+	group_free_cnt = calloc (group_cnt, sizeof *group_free_cnt);
+	if (group_free_cnt == NULL)
+		PANIC ("free map group allocation failed");
+	lock_init (&free_map_lock);
 	bitmap_mark (free_map, FREE_MAP_SECTOR);
 	bitmap_mark (free_map, ROOT_DIR_SECTOR);
+	bitmap_set_multiple (free_map, disk_size (filesys_disk) - JOURNAL_SECTORS,
+			JOURNAL_SECTORS, true);
+	count_groups ();
 }
 
-/* Allocates CNT consecutive sectors from the free map and stores
- * the first into *SECTORP.
- * Returns true if successful, false if all sectors were
- * available. */
+/* Allocates CNT consecutive sectors from the free map, as close
+ * after GOAL as possible, and stores the first into *SECTORP.
+ * Callers pass a sector related to the new one, such as the
+ * previous sector of the same file, as GOAL, so that related
+ * sectors end up near each other.
+ * Returns true if successful, false if not enough consecutive
+ * sectors were available.
+ * The free map reaches the disk only when free_map_flush() is
+ * called. */
 bool
-free_map_allocate (size_t cnt, disk_sector_t *sectorp) {
-	disk_sector_t sector = bitmap_scan_and_flip (free_map, 0, cnt, false);
-	if (sector != BITMAP_ERROR
-			&& free_map_file != NULL
-			&& !bitmap_write (free_map, free_map_file)) {
-		bitmap_set_multiple (free_map, sector, cnt, false);
-		sector = BITMAP_ERROR;
+free_map_allocate (size_t cnt, disk_sector_t goal, disk_sector_t *sectorp) {
+	size_t sector = BITMAP_ERROR;
+
+	lock_acquire (&free_map_lock);
+	if (free_cnt - reserved_cnt >= cnt)
+		sector = find_free (goal, cnt);
+	if (sector != BITMAP_ERROR)
+		set_sectors (sector, cnt, true);
+	lock_release (&free_map_lock);
+	if (sector != BITMAP_ERROR)
+		*sectorp = sector;
+	return sector != BITMAP_ERROR;
+}
+
+/* Like free_map_allocate(), but takes the sectors out of the
+ * caller's reservation of *RESERVED sectors, made with
+ * free_map_reserve(), as far as it goes, and out of the unreserved
+ * sectors beyond that.  Deducts the sectors taken from *RESERVED. */
+bool
+free_map_claim (size_t cnt, disk_sector_t goal, disk_sector_t *sectorp,
+		size_t *reserved) {
+	size_t claimed = cnt < *reserved ? cnt : *reserved;
+	size_t sector = BITMAP_ERROR;
+
+	lock_acquire (&free_map_lock);
+	ASSERT (claimed <= reserved_cnt);
+	if (free_cnt - reserved_cnt >= cnt - claimed)
+		sector = find_free (goal, cnt);
+	if (sector != BITMAP_ERROR) {
+		set_sectors (sector, cnt, true);
+		reserved_cnt -= claimed;
+		*reserved -= claimed;
 	}
+	lock_release (&free_map_lock);
 	if (sector != BITMAP_ERROR)
 		*sectorp = sector;
 	return sector != BITMAP_ERROR;
 }
 
+/* Sets aside CNT free sectors, without choosing which, so that
+ * data written now can be given its sectors later.  Returns true
+ * if successful, false if not enough sectors are free. */
+bool
+free_map_reserve (size_t cnt) {
+	bool success;
+
+	lock_acquire (&free_map_lock);
+	success = free_cnt - reserved_cnt >= cnt;
+	if (success)
+		reserved_cnt += cnt;
+	lock_release (&free_map_lock);
+	return success;
+}
+
+/* Gives back CNT sectors reserved with free_map_reserve() but not
+ * claimed. */
+void
+free_map_unreserve (size_t cnt) {
+	lock_acquire (&free_map_lock);
+	ASSERT (cnt <= reserved_cnt);
+	reserved_cnt -= cnt;
+	lock_release (&free_map_lock);
+}
+
 /* Makes CNT sectors starting at SECTOR available for use. */
 void
 free_map_release (disk_sector_t sector, size_t cnt) {
+	lock_acquire (&free_map_lock);
 	ASSERT (bitmap_all (free_map, sector, cnt));
-	bitmap_set_multiple (free_map, sector, cnt, false);
-	bitmap_write (free_map, free_map_file);
+	set_sectors (sector, cnt, false);
+	lock_release (&free_map_lock);
+}
+
+/* Returns a good place to start a new directory: the beginning of
+ * the group with the most free sectors.  Spreading directories out
+ * leaves room for each one's files to be placed near it. */
+disk_sector_t
+free_map_dir_goal (void) {
+	size_t best = 0;
+	size_t g;
+
+	lock_acquire (&free_map_lock);
+	for (g = 1; g < group_cnt; g++)
+		if (group_free_cnt[g] > group_free_cnt[best])
+			best = g;
+	lock_release (&free_map_lock);
+	return best * GROUP_SIZE;
+}
+
+/* Writes the free map to disk if it has changed since it was last
+ * written. */
+void
+free_map_flush (void) {
+	lock_acquire (&free_map_lock);
+	if (free_map_dirty && free_map_file != NULL) {
+		if (!bitmap_write (free_map, free_map_file))
+			PANIC ("can't write free map");
+		free_map_dirty = false;
+	}
+	lock_release (&free_map_lock);
 }
 
 /* Opens the free map file and reads it from disk. */
@@ -52,26 +244,38 @@ free_map_open (void) {
 		PANIC ("can't open free map");
 	if (!bitmap_read (free_map, free_map_file))
 		PANIC ("can't read free map");
+	count_groups ();
+	free_map_dirty = false;
 }
 
 /* Writes the free map to disk and closes the free map file. */
 void
 free_map_close (void) {
+	free_map_flush ();
 	file_close (free_map_file);
+	free_map_file = NULL;
 }
 
 /* Creates a new free map file on disk and writes the free map to
  * it. */
 void
 free_map_create (void) {
+	struct file *file;
+
 	/* Create inode. */
-	if (!inode_create (FREE_MAP_SECTOR, bitmap_file_size (free_map)))
+	if (!inode_create (FREE_MAP_SECTOR, bitmap_file_size (free_map), false))
 		PANIC ("free map creation failed");
 
-	/* Write bitmap to file. */
-	free_map_file = file_open (inode_open (FREE_MAP_SECTOR));
-	if (free_map_file == NULL)
+	/* Write bitmap to file.  The file starts out as a hole, so the
+	 * first write allocates its sectors, which marks them in the
+	 * bitmap; the second records that.  After this the free map file
+	 * never allocates, which free_map_flush() relies on, so it is not
+	 * made the free map file until then. */
+	file = file_open (inode_open (FREE_MAP_SECTOR));
+	if (file == NULL)
 		PANIC ("can't open free map");
-	if (!bitmap_write (free_map, free_map_file))
+	if (!bitmap_write (free_map, file) || !bitmap_write (free_map, file))
 		PANIC ("can't write free map");
+	free_map_file = file;
+	free_map_dirty = false;
 }
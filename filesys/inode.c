@@ -1,24 +1,94 @@
 #include "filesys/inode.h"
-#include <list.h>
+#include <hash.h>
 #include <debug.h>
 #include <round.h>
+#include <stdlib.h>
 #include <string.h>
+#include "filesys/buffer-cache.h"
 #include "filesys/filesys.h"
 #include "filesys/free-map.h"
+#include "filesys/journal.h"
+#include "filesys/page_cache.h"
 #include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
 
 /* Identifies an inode. */
 #define INODE_MAGIC 0x494e4f44
 
+/* Number of data sectors indexed directly by an inode, and
+ * number of sector indexes held by one index sector. */
+#define DIRECT_CNT 96
+#define INDIRECT_CNT (DISK_SECTOR_SIZE / sizeof (disk_sector_t))
+
+/* Most data sectors allocated in one journal operation, which keeps
+ * the index and free map sectors each operation changes few. */
+#define FILL_CHUNK 1024
+
+/* Most metadata sectors allocated in one journal operation.  Each
+ * of them is logged, along with the index sectors on the way. */
+#define META_CHUNK 8
+
+/* Most index sectors below the inode that one journal operation
+ * changes, which with the inode and the doubly indirect sector
+ * stays within JOURNAL_OP_SECTORS. */
+#define OP_INDEX_MAX (JOURNAL_OP_SECTORS - 8)
+
+/* Most data sectors of one inode whose allocation is delayed at a
+ * time.  Writing more flushes them. */
+#define DELAY_MAX 128
+
+/* Most data sectors read or written with one disk command.  Runs
+ * of sectors that lie next to each other on disk are transferred
+ * together, up to this many at a time. */
+#define RUN_MAX 32
+
+/* Set in the index entry of a data sector that was preallocated by
+ * inode_preallocate() but not yet written.  Such a sector reads as
+ * zeros.  Sector numbers never reach this bit. */
+#define UNWRITTEN 0x80000000u
+
+/* Number of data sectors in the largest file an inode can index. */
+#define MAX_SECTORS (DIRECT_CNT + INDIRECT_CNT + INDIRECT_CNT * INDIRECT_CNT)
+
+/* Longest symbolic link target kept inline, in place of the direct
+ * index, so that reading it takes no more than reading the inode. */
+#define INLINE_LINK_MAX (DIRECT_CNT * sizeof (disk_sector_t))
+
 /* On-disk inode.
- * Must be exactly DISK_SECTOR_SIZE bytes long. */
+ * Must be exactly DISK_SECTOR_SIZE bytes long.
+ * A sector index of 0 means "not allocated": sector 0 always holds
+ * the free map's inode, so it is never a data or index sector.
+ * Files may be sparse: a data sector within the file's length that
+ * is not allocated is a hole, which reads as zeros and is allocated
+ * when it is first written.  A data sector's index entry may also
+ * be marked UNWRITTEN.
+ * A symbolic link's data is its target, without a null terminator.
+ * A target of at most INLINE_LINK_MAX bytes takes the place of the
+ * direct index, and the inode has no data sectors. */
 struct inode_disk {
-	disk_sector_t start;                /* First data sector. */
 	off_t length;                       /* File size in bytes. */
 	unsigned magic;                     /* Magic number. */
-	uint32_t unused[125];               /* Not used. */
+	union {
+		disk_sector_t direct[DIRECT_CNT]; /* Direct data sectors. */
+		char target[INLINE_LINK_MAX];   /* Inline symbolic link target. */
+	};
+	disk_sector_t indirect;             /* Indirect index sector. */
+	disk_sector_t doubly_indirect;      /* Doubly indirect index sector. */
+	uint32_t is_dir;                    /* Nonzero for a directory. */
+	uint32_t is_symlink;                /* Nonzero for a symbolic link. */
+	uint32_t link_cnt;                  /* Directory entries naming it. */
+	uint32_t unused[25];                /* Not used. */
 };
 
+/* Returns true if DISK_INODE is a symbolic link whose target is
+ * kept inline. */
+static inline bool
+is_inline_link (const struct inode_disk *disk_inode) {
+	return disk_inode->is_symlink
+		&& (size_t) disk_inode->length <= INLINE_LINK_MAX;
+}
+
 /* Returns the number of sectors to allocate for an inode SIZE
  * bytes long. */
 static inline size_t
@@ -26,46 +96,580 @@ bytes_to_sectors (off_t size) {
 	return DIV_ROUND_UP (size, DISK_SECTOR_SIZE);
 }
 
-/* In-memory inode. */
+/* In-memory inode.
+ * LOCK is held for reading by every reader and by writers that stay
+ * within the file, and for writing by writers that extend the file
+ * or write into holes and so change DATA or DELAYED.  DATA's
+ * link_cnt is guarded by link_lock instead.  Data sectors
+ * themselves are protected by the buffer cache. */
 struct inode {
-	struct list_elem elem;              /* Element in inode list. */
+	struct hash_elem elem;              /* Element in open_inodes. */
 	disk_sector_t sector;               /* Sector number of disk location. */
 	int open_cnt;                       /* Number of openers. */
+	bool loaded;                        /* Read from disk yet? */
+	bool loading;                       /* Being read from disk now? */
 	bool removed;                       /* True if deleted, false otherwise. */
 	int deny_write_cnt;                 /* 0: writes ok, >0: deny writes. */
+	struct rwlock lock;                 /* Guards the members below. */
 	struct inode_disk data;             /* Inode content. */
+	struct hash delayed;                /* Delayed data sectors, by index. */
+	size_t reserved;                    /* Free sectors reserved for them. */
+};
+
+/* A data sector of a regular file written where the file had a
+ * hole.  Its disk sector is chosen only when the inode's delayed
+ * sectors are flushed, once the whole range written is known, so
+ * that a run of them can be placed in one piece. */
+struct delayed {
+	struct hash_elem elem;              /* Element in inode's delayed. */
+	size_t idx;                         /* Data sector index in the file. */
+	uint8_t data[DISK_SECTOR_SIZE];     /* Sector contents. */
+};
+
+/* The three levels of an inode's sector index: the direct table,
+ * the indirect sector and the doubly indirect sector.  SPAN is the
+ * number of data sectors covered by one entry of the level's top
+ * table and CNT the number of data sectors covered by the whole
+ * level. */
+struct index_level {
+	size_t span;
+	size_t cnt;
+};
+
+static const struct index_level index_levels[] = {
+	{ 1, DIRECT_CNT },
+	{ INDIRECT_CNT, INDIRECT_CNT },
+	{ INDIRECT_CNT * INDIRECT_CNT, INDIRECT_CNT * INDIRECT_CNT },
 };
+#define INDEX_LEVEL_CNT (sizeof index_levels / sizeof *index_levels)
+
+/* Returns the top table of level LEVEL of DISK_INODE's index. */
+static disk_sector_t *
+index_table (const struct inode_disk *disk_inode_, size_t level) {
+	struct inode_disk *disk_inode = (struct inode_disk *) disk_inode_;
+
+	switch (level) {
+		case 0:
+			return disk_inode->direct;
+		case 1:
+			return &disk_inode->indirect;
+		default:
+			return &disk_inode->doubly_indirect;
+	}
+}
+
+/* Returns the sector that holds data sector IDX below TABLE, whose
+ * entries each span SPAN data sectors, or 0 if it is not
+ * allocated. */
+static disk_sector_t
+index_lookup (const disk_sector_t *table, size_t span, size_t idx) {
+	disk_sector_t sector = table[idx / span];
+
+	/* Descend through the index sectors, reading just the one entry
+	 * needed from each. */
+	idx %= span;
+	while (span > 1 && sector != 0) {
+		span /= INDIRECT_CNT;
+		buffer_cache_read (sector, &sector, idx / span * sizeof sector,
+				sizeof sector);
+		idx %= span;
+	}
+	return sector;
+}
+
+/* Makes sure that every data sector in [START, END) below TABLE,
+ * whose entries each span SPAN data sectors, is allocated, along
+ * with the index sectors needed to reach it.  Newly allocated
+ * sectors are zeroed on disk.  Each new sector is placed as close
+ * after *GOAL as possible, and *GOAL is then advanced past it, so
+ * that a file's sectors are laid out in order.  META tells whether
+ * the data sectors hold metadata.
+ * Returns true if successful, false if the disk filled up. */
+static bool
+index_allocate (disk_sector_t *table, size_t span, size_t start, size_t end,
+		disk_sector_t *goal, bool meta) {
+	static char zeros[DISK_SECTOR_SIZE];
+	size_t i;
+
+	for (i = start / span; i * span < end; i++) {
+		bool fresh = table[i] == 0;
+		disk_sector_t *block;
+		bool success;
+
+		if (fresh) {
+			if (!free_map_allocate (1, *goal, &table[i]))
+				return false;
+			*goal = table[i] + 1;
+		}
+		if (span == 1) {
+			if (fresh && meta)
+				buffer_cache_write_meta (table[i], zeros, 0, DISK_SECTOR_SIZE);
+			else if (fresh) {
+				/* The sector may have held metadata before. */
+				journal_forget (table[i]);
+				buffer_cache_write (table[i], zeros, 0, DISK_SECTOR_SIZE);
+			}
+			continue;
+		}
+
+		/* Descend into the index sector. */
+		block = calloc (1, DISK_SECTOR_SIZE);
+		if (block == NULL)
+			return false;
+		if (!fresh)
+			buffer_cache_read (table[i], block, 0, DISK_SECTOR_SIZE);
+		success = index_allocate (block, span / INDIRECT_CNT,
+				start > i * span ? start - i * span : 0,
+				end - i * span < span ? end - i * span : span, goal, meta);
+		buffer_cache_write_meta (table[i], block, 0, DISK_SECTOR_SIZE);
+		free (block);
+		if (!success)
+			return false;
+	}
+	return true;
+}
+
+/* Releases every allocated sector below the CNT entries of TABLE,
+ * whose entries each span SPAN data sectors, including the index
+ * sectors themselves. */
+static void
+index_release (const disk_sector_t *table, size_t span, size_t cnt) {
+	size_t i;
+
+	for (i = 0; i < cnt; i++) {
+		if (table[i] == 0)
+			continue;
+		if (span > 1) {
+			disk_sector_t *block = malloc (DISK_SECTOR_SIZE);
+			if (block != NULL) {
+				buffer_cache_read (table[i], block, 0, DISK_SECTOR_SIZE);
+				index_release (block, span / INDIRECT_CNT, INDIRECT_CNT);
+				free (block);
+			}
+		}
+		free_map_release (table[i] & ~UNWRITTEN, 1);
+	}
+}
+
+/* Allocates the data sectors [START, END) of DISK_INODE, placing
+ * them from GOAL onward if possible.  META tells whether they hold
+ * metadata.
+ * Returns true if successful, false if the disk filled up or END
+ * is beyond the largest file an inode can index.  Sectors
+ * allocated before a failure stay in the index. */
+static bool
+inode_allocate (struct inode_disk *disk_inode, size_t start, size_t end,
+		disk_sector_t goal, bool meta) {
+	size_t base = 0;
+	size_t level;
+
+	for (level = 0; level < INDEX_LEVEL_CNT && base < end; level++) {
+		const struct index_level *l = &index_levels[level];
+		size_t s = start > base ? start - base : 0;
+		size_t e = end - base < l->cnt ? end - base : l->cnt;
+
+		if (s < e && !index_allocate (index_table (disk_inode, level),
+					l->span, s, e, &goal, meta))
+			return false;
+		base += l->cnt;
+	}
+	return base >= end;
+}
+
+/* Makes SECTOR data sector IDX below TABLE, whose entries each
+ * span SPAN data sectors, claiming the index sectors needed to
+ * reach it as close after *GOAL as possible out of the *RESERVED
+ * sectors reserved for it, as free_map_claim() does.
+ * Returns true if successful, false if the disk filled up. */
+static bool
+index_assign (disk_sector_t *table, size_t span, size_t idx,
+		disk_sector_t sector, disk_sector_t *goal, size_t *reserved) {
+	size_t i = idx / span;
+	disk_sector_t *block;
+	bool success;
+
+	if (span == 1) {
+		table[i] = sector;
+		return true;
+	}
+
+	block = calloc (1, DISK_SECTOR_SIZE);
+	if (block == NULL)
+		return false;
+	if (table[i] == 0) {
+		if (!free_map_claim (1, *goal, &table[i], reserved)) {
+			free (block);
+			return false;
+		}
+		*goal = table[i] + 1;
+	} else
+		buffer_cache_read (table[i], block, 0, DISK_SECTOR_SIZE);
+	success = index_assign (block, span / INDIRECT_CNT, idx % span, sector,
+			goal, reserved);
+	buffer_cache_write_meta (table[i], block, 0, DISK_SECTOR_SIZE);
+	free (block);
+	return success;
+}
+
+/* Makes SECTOR data sector IDX of DISK_INODE, as index_assign()
+ * does. */
+static bool
+inode_assign (struct inode_disk *disk_inode, size_t idx,
+		disk_sector_t sector, disk_sector_t *goal, size_t *reserved) {
+	size_t level;
+
+	for (level = 0; level < INDEX_LEVEL_CNT; level++) {
+		const struct index_level *l = &index_levels[level];
+		if (idx < l->cnt)
+			return index_assign (index_table (disk_inode, level), l->span, idx,
+					sector, goal, reserved);
+		idx -= l->cnt;
+	}
+	return false;
+}
+
+/* Releases all of DISK_INODE's data and index sectors. */
+static void
+inode_release (struct inode_disk *disk_inode) {
+	size_t level;
+
+	if (is_inline_link (disk_inode))
+		return;
+	for (level = 0; level < INDEX_LEVEL_CNT; level++) {
+		const struct index_level *l = &index_levels[level];
+		index_release (index_table (disk_inode, level), l->span,
+				l->cnt / l->span);
+	}
+}
+
+/* Returns a number that tells apart the index sectors below the
+ * inode in which the entries of data sectors lie: 0 for data
+ * sector IDX if the inode indexes it directly, and otherwise the
+ * same number for data sectors whose entries share a sector.
+ * Numbers grow with IDX. */
+static size_t
+index_group (size_t idx) {
+	return idx < DIRECT_CNT ? 0 : (idx - DIRECT_CNT) / INDIRECT_CNT + 1;
+}
+
+/* Returns where one journal operation that changes the index of
+ * data sectors from START onward must stop, short of END, so as
+ * to change at most OP_INDEX_MAX index sectors below the inode. */
+static size_t
+op_index_end (size_t start, size_t end) {
+	size_t stop = DIRECT_CNT
+		+ (index_group (start) + OP_INDEX_MAX - 1) * INDIRECT_CNT;
+	return stop < end ? stop : end;
+}
+
+/* Returns the disk sector that holds data sector IDX of
+ * DISK_INODE, 0 if it is not allocated, or -1 if IDX is beyond the
+ * largest file an inode can index.  The UNWRITTEN bit is left as it
+ * is in the index. */
+static disk_sector_t
+index_to_sector (const struct inode_disk *disk_inode, size_t idx) {
+	size_t level;
+
+	for (level = 0; level < INDEX_LEVEL_CNT; level++) {
+		const struct index_level *l = &index_levels[level];
+		if (idx < l->cnt)
+			return index_lookup (index_table (disk_inode, level), l->span, idx);
+		idx -= l->cnt;
+	}
+	return -1;
+}
 
 /* Returns the disk sector that contains byte offset POS within
- * INODE.
+ * INODE, or 0 if POS lies in a hole.
  * Returns -1 if INODE does not contain data for a byte at offset
  * POS. */
 static disk_sector_t
 byte_to_sector (const struct inode *inode, off_t pos) {
 	ASSERT (inode != NULL);
-	if (pos < inode->data.length)
-		return inode->data.start + pos / DISK_SECTOR_SIZE;
-	else
+	if (pos >= inode->data.length)
 		return -1;
+	return index_to_sector (&inode->data, pos / DISK_SECTOR_SIZE);
+}
+
+/* Returns the sector after which data sector IDX of INODE is best
+ * placed: the data sector in front of it if that one is allocated,
+ * or else INODE itself. */
+static disk_sector_t
+goal_for (const struct inode *inode, size_t idx) {
+	disk_sector_t goal = idx > 0 ? index_to_sector (&inode->data, idx - 1) : 0;
+	return goal != 0 ? goal & ~UNWRITTEN : inode->sector;
+}
+
+/* Returns true if INODE's data is metadata, that is, if INODE is a
+ * directory, a symbolic link or the free map. */
+static bool
+inode_is_meta (const struct inode *inode) {
+	return inode->data.is_dir || inode->data.is_symlink
+		|| inode->sector == FREE_MAP_SECTOR;
+}
+
+/* Allocates the holes among data sectors [START, END) of INODE.
+ * The new sectors follow the data sector in front of START on disk
+ * if that one is allocated, or else INODE itself.  Writes back the
+ * on-disk inode, whose index changes.  The caller must hold INODE's
+ * lock for writing.
+ * Each piece of META_CHUNK sectors is one journal operation, so
+ * that its index and free map changes are committed together.
+ * Returns true if successful, false if the disk filled up or END
+ * is beyond the largest file an inode can index. */
+static bool
+inode_fill_holes (struct inode *inode, size_t start, size_t end) {
+	bool success = true;
+
+	while (success && start < end) {
+		size_t chunk_end = end - start < META_CHUNK ? end : start + META_CHUNK;
+		disk_sector_t goal = goal_for (inode, start);
+
+		journal_begin ();
+		success = inode_allocate (&inode->data, start, chunk_end, goal + 1,
+				inode_is_meta (inode));
+		buffer_cache_write_meta (inode->sector, &inode->data, 0,
+				DISK_SECTOR_SIZE);
+		journal_end ();
+		start = chunk_end;
+	}
+	return success;
+}
+
+static uint64_t
+delayed_hash (const struct hash_elem *e, void *aux UNUSED) {
+	return hash_int (hash_entry (e, struct delayed, elem)->idx);
+}
+
+static bool
+delayed_less (const struct hash_elem *a, const struct hash_elem *b,
+		void *aux UNUSED) {
+	return hash_entry (a, struct delayed, elem)->idx
+		< hash_entry (b, struct delayed, elem)->idx;
+}
+
+static void
+delayed_free (struct hash_elem *e, void *aux UNUSED) {
+	free (hash_entry (e, struct delayed, elem));
+}
+
+static int
+delayed_cmp (const void *a_, const void *b_) {
+	const struct delayed *a = *(struct delayed *const *) a_;
+	const struct delayed *b = *(struct delayed *const *) b_;
+	return a->idx < b->idx ? -1 : a->idx > b->idx;
+}
+
+/* Returns INODE's delayed data sector IDX, or a null pointer if it
+ * is not delayed. */
+static struct delayed *
+delayed_find (struct inode *inode, size_t idx) {
+	struct delayed key;
+	struct hash_elem *e;
+
+	key.idx = idx;
+	e = hash_find (&inode->delayed, &key.elem);
+	return e != NULL ? hash_entry (e, struct delayed, elem) : NULL;
+}
+
+/* Returns the number of sectors to reserve for CNT delayed data
+ * sectors: the sectors themselves and, assuming that they are
+ * mostly consecutive, the index sectors that placing them takes. */
+static size_t
+delay_reservation (size_t cnt) {
+	return cnt == 0 ? 0 : cnt + DIV_ROUND_UP (cnt, INDIRECT_CNT) + 2;
+}
+
+/* Gives each delayed data sector of INODE a disk sector and writes
+ * it there.  Each piece of them whose entries lie in at most
+ * OP_INDEX_MAX index sectors is one journal operation.  Each run of consecutive
+ * delayed sectors is placed in one run of free sectors right after
+ * the data sector in front of it, if the disk has one that long.
+ * The caller must hold INODE's lock for writing or be its last
+ * opener.
+ * Returns true if successful, false if the disk filled up or memory
+ * ran out, in which case the sectors not yet placed stay delayed. */
+static bool
+delay_flush (struct inode *inode) {
+	size_t cnt = hash_size (&inode->delayed);
+	struct delayed **blocks;
+	struct hash_iterator it;
+	uint8_t *run;
+	bool success = true;
+	size_t i, j;
+
+	if (cnt == 0)
+		return true;
+	blocks = malloc (cnt * sizeof *blocks);
+	if (blocks == NULL)
+		return false;
+	i = 0;
+	hash_first (&it, &inode->delayed);
+	while (hash_next (&it))
+		blocks[i++] = hash_entry (hash_cur (&it), struct delayed, elem);
+	qsort (blocks, cnt, sizeof *blocks, delayed_cmp);
+
+	run = malloc (RUN_MAX * DISK_SECTOR_SIZE);
+	if (run == NULL) {
+		free (blocks);
+		return false;
+	}
+
+	for (i = 0; success && i < cnt; ) {
+		size_t stop = op_index_end (blocks[i]->idx, blocks[cnt - 1]->idx + 1);
+		size_t end;
+
+		for (end = i + 1; end < cnt && blocks[end]->idx < stop; end++)
+			continue;
+
+		journal_begin ();
+		for (; success && i < end; i = j) {
+			disk_sector_t goal, first;
+			size_t len, k;
+
+			for (j = i + 1; j < end && blocks[j]->idx == blocks[j - 1]->idx + 1;
+					j++)
+				continue;
+			goal = goal_for (inode, blocks[i]->idx);
+
+			/* Settle for a shorter run if need be. */
+			for (len = j - i; len > 0; len /= 2)
+				if (free_map_claim (len, goal + 1, &first, &inode->reserved))
+					break;
+			if (len == 0) {
+				success = false;
+				break;
+			}
+
+			/* Write the data a run of sectors at a time, before the
+			 * index that points to it is committed. */
+			for (k = 0; k < len; k += RUN_MAX) {
+				size_t n = len - k < RUN_MAX ? len - k : RUN_MAX;
+				size_t m;
+
+				for (m = 0; m < n; m++) {
+					/* The sector may have held metadata before. */
+					journal_forget (first + k + m);
+					memcpy (run + m * DISK_SECTOR_SIZE, blocks[i + k + m]->data,
+							DISK_SECTOR_SIZE);
+				}
+				buffer_cache_write_multiple (first + k, run, n);
+			}
+
+			goal = first + len;
+			for (j = i; j < i + len; j++) {
+				struct delayed *d = blocks[j];
+				disk_sector_t sector = first + (j - i);
+
+				if (!inode_assign (&inode->data, d->idx, sector, &goal,
+							&inode->reserved)) {
+					free_map_release (sector, i + len - j);
+					success = false;
+					break;
+				}
+				hash_delete (&inode->delayed, &d->elem);
+				free (d);
+			}
+		}
+		buffer_cache_write_meta (inode->sector, &inode->data, 0,
+				DISK_SECTOR_SIZE);
+		journal_end ();
+	}
+	free (run);
+	free (blocks);
+
+	if (hash_empty (&inode->delayed)) {
+		free_map_unreserve (inode->reserved);
+		inode->reserved = 0;
+	}
+	return success;
+}
+
+/* Writes SIZE bytes from BUFFER into data sector IDX of INODE, a
+ * hole, starting at byte offset OFS within the sector, and delays
+ * choosing a disk sector for it.  The caller must hold INODE's lock
+ * for writing.
+ * Returns true if successful, false if the disk is full or memory
+ * ran out. */
+static bool
+delay_write (struct inode *inode, size_t idx, const void *buffer, int ofs,
+		int size) {
+	struct delayed *d = delayed_find (inode, idx);
+
+	if (d == NULL) {
+		size_t need;
+
+		if (hash_size (&inode->delayed) >= DELAY_MAX && !delay_flush (inode))
+			return false;
+		need = delay_reservation (hash_size (&inode->delayed) + 1);
+		if (need > inode->reserved) {
+			if (!free_map_reserve (need - inode->reserved))
+				return false;
+			inode->reserved = need;
+		}
+		d = calloc (1, sizeof *d);
+		if (d == NULL)
+			return false;
+		d->idx = idx;
+		hash_insert (&inode->delayed, &d->elem);
+	}
+	memcpy (d->data + ofs, buffer, size);
+	return true;
+}
+
+/* Open inodes, keyed by sector, so that opening a single inode
+ * twice returns the same `struct inode'.  open_inodes_lock guards
+ * the table and the open_cnt, loaded and loading of every inode
+ * in it.  An inode is put in the table before it is read from
+ * disk, which happens without the lock; inode_loaded is signaled
+ * once it has been read. */
+static struct hash open_inodes;
+static struct lock open_inodes_lock;
+static struct condition inode_loaded;
+
+/* Guards the link_cnt of every inode.  Links are counted without
+ * the inode's own lock, whose holder may be waiting in
+ * journal_begin() for the operation that links the inode to end.
+ * Writing the on-disk inode meanwhile is safe, because whatever
+ * else changes it does so in an operation that writes it again
+ * before ending, and a transaction commits only once no operation
+ * is in progress. */
+static struct lock link_lock;
+
+static uint64_t
+inode_hash (const struct hash_elem *e, void *aux UNUSED) {
+	const struct inode *inode = hash_entry (e, struct inode, elem);
+	return hash_int (inode->sector);
 }
 
-/* List of open inodes, so that opening a single inode twice
- * returns the same `struct inode'. */
-static struct list open_inodes;
+static bool
+inode_less (const struct hash_elem *a_, const struct hash_elem *b_,
+		void *aux UNUSED) {
+	const struct inode *a = hash_entry (a_, struct inode, elem);
+	const struct inode *b = hash_entry (b_, struct inode, elem);
+	return a->sector < b->sector;
+}
 
 /* Initializes the inode module. */
 void
 inode_init (void) {
-	list_init (&open_inodes);
+	if (!hash_init (&open_inodes, inode_hash, inode_less, NULL))
+		PANIC ("open inode table creation failed");
+	lock_init (&open_inodes_lock);
+	cond_init (&inode_loaded);
+	lock_init (&link_lock);
 }
 
 /* Initializes an inode with LENGTH bytes of data and
  * writes the new inode to sector SECTOR on the file system
- * disk.
+ * disk.  IS_DIR tells whether the inode holds a directory.
+ * The data starts out as one hole, so no data sectors are
+ * allocated or written until the file is written to.
  * Returns true if successful.
- * Returns false if memory or disk allocation fails. */
+ * Returns false if memory allocation fails or LENGTH is more than
+ * an inode can index. */
 bool
-inode_create (disk_sector_t sector, off_t length) {
+inode_create (disk_sector_t sector, off_t length, bool is_dir) {
 	struct inode_disk *disk_inode = NULL;
 	bool success = false;
 
@@ -75,65 +679,160 @@ inode_create (disk_sector_t sector, off_t length) {
 	 * one sector in size, and you should fix that. */
 	ASSERT (sizeof *disk_inode == DISK_SECTOR_SIZE);
 
+	if (bytes_to_sectors (length) > MAX_SECTORS)
+		return false;
+
 	disk_inode = calloc (1, sizeof *disk_inode);
 	if (disk_inode != NULL) {
-		size_t sectors = bytes_to_sectors (length);
 		disk_inode->length = length;
 		disk_inode->magic = INODE_MAGIC;
-		if (free_map_allocate (sectors, &disk_inode->start)) {
-			disk_write (filesys_disk, sector, disk_inode);
-			if (sectors > 0) {
-				static char zeros[DISK_SECTOR_SIZE];
-				size_t i;
-
-				for (i = 0; i < sectors; i++) 
-					disk_write (filesys_disk, disk_inode->start + i, zeros); 
-			}
-			success = true; 
-		} 
+		disk_inode->is_dir = is_dir;
+		disk_inode->link_cnt = 1;
+		buffer_cache_write_meta (sector, disk_inode, 0, DISK_SECTOR_SIZE);
 		free (disk_inode);
+		success = true;
 	}
 	return success;
 }
 
-/* Reads an inode from SECTOR
- * and returns a `struct inode' that contains it.
+/* Writes a new inode to sector SECTOR that is a symbolic link to
+ * TARGET.  A short target is kept in the inode itself; a longer
+ * one is written to data sectors right after it, all of which the
+ * caller's journal operation logs.
+ * Returns true if successful.
+ * Returns false if memory allocation fails, the disk is full or
+ * TARGET takes more than META_CHUNK sectors. */
+bool
+inode_create_symlink (disk_sector_t sector, const char *target) {
+	size_t length = strnlen (target, META_CHUNK * DISK_SECTOR_SIZE + 1);
+	struct inode_disk *disk_inode;
+	bool success = true;
+
+	if (bytes_to_sectors (length) > META_CHUNK)
+		return false;
+
+	disk_inode = calloc (1, sizeof *disk_inode);
+	if (disk_inode == NULL)
+		return false;
+	disk_inode->length = length;
+	disk_inode->magic = INODE_MAGIC;
+	disk_inode->is_symlink = true;
+	disk_inode->link_cnt = 1;
+	if (is_inline_link (disk_inode))
+		memcpy (disk_inode->target, target, length);
+	else {
+		size_t idx;
+
+		success = inode_allocate (disk_inode, 0, bytes_to_sectors (length),
+				sector + 1, true);
+		for (idx = 0; success && idx * DISK_SECTOR_SIZE < length; idx++) {
+			size_t ofs = idx * DISK_SECTOR_SIZE;
+			size_t chunk = length - ofs < DISK_SECTOR_SIZE
+				? length - ofs : DISK_SECTOR_SIZE;
+			buffer_cache_write_meta (index_to_sector (disk_inode, idx),
+					target + ofs, 0, chunk);
+		}
+		if (!success)
+			inode_release (disk_inode);
+	}
+	if (success)
+		buffer_cache_write_meta (sector, disk_inode, 0, DISK_SECTOR_SIZE);
+	free (disk_inode);
+	return success;
+}
+
+/* Returns a new reference to the inode in SECTOR without reading
+ * it from disk, so that it may be called with other locks held.
+ * The caller must pass the inode to inode_load() before using it.
  * Returns a null pointer if memory allocation fails. */
 struct inode *
-inode_open (disk_sector_t sector) {
-	struct list_elem *e;
+inode_get (disk_sector_t sector) {
+	struct inode key;
+	struct hash_elem *e;
 	struct inode *inode;
 
+	lock_acquire (&open_inodes_lock);
+
 	/* Check whether this inode is already open. */
-	for (e = list_begin (&open_inodes); e != list_end (&open_inodes);
-			e = list_next (e)) {
-		inode = list_entry (e, struct inode, elem);
-		if (inode->sector == sector) {
-			inode_reopen (inode);
-			return inode; 
-		}
+	key.sector = sector;
+	e = hash_find (&open_inodes, &key.elem);
+	if (e != NULL) {
+		inode = hash_entry (e, struct inode, elem);
+		inode->open_cnt++;
+		lock_release (&open_inodes_lock);
+		return inode;
 	}
 
 	/* Allocate memory. */
 	inode = malloc (sizeof *inode);
-	if (inode == NULL)
+	if (inode == NULL) {
+		lock_release (&open_inodes_lock);
 		return NULL;
+	}
 
 	/* Initialize. */
-	list_push_front (&open_inodes, &inode->elem);
 	inode->sector = sector;
 	inode->open_cnt = 1;
+	inode->loaded = false;
+	inode->loading = false;
 	inode->deny_write_cnt = 0;
 	inode->removed = false;
-	disk_read (filesys_disk, inode->sector, &inode->data);
+	inode->reserved = 0;
+	if (!hash_init (&inode->delayed, delayed_hash, delayed_less, NULL)) {
+		free (inode);
+		lock_release (&open_inodes_lock);
+		return NULL;
+	}
+	rwlock_init (&inode->lock);
+	hash_insert (&open_inodes, &inode->elem);
+	lock_release (&open_inodes_lock);
 	return inode;
 }
 
+/* Makes sure that INODE, returned by inode_get(), has been read
+ * from disk, reading it if nobody else is, and returns it.
+ * Returns a null pointer if INODE is null. */
+struct inode *
+inode_load (struct inode *inode) {
+	if (inode == NULL)
+		return NULL;
+
+	lock_acquire (&open_inodes_lock);
+	while (!inode->loaded) {
+		if (inode->loading) {
+			cond_wait (&inode_loaded, &open_inodes_lock);
+			continue;
+		}
+		inode->loading = true;
+		lock_release (&open_inodes_lock);
+
+		buffer_cache_read (inode->sector, &inode->data, 0, DISK_SECTOR_SIZE);
+
+		lock_acquire (&open_inodes_lock);
+		inode->loading = false;
+		inode->loaded = true;
+		cond_broadcast (&inode_loaded, &open_inodes_lock);
+	}
+	lock_release (&open_inodes_lock);
+	return inode;
+}
+
+/* Reads an inode from SECTOR
+ * and returns a `struct inode' that contains it.
+ * Returns a null pointer if memory allocation fails. */
+struct inode *
+inode_open (disk_sector_t sector) {
+	return inode_load (inode_get (sector));
+}
+
 /* Reopens and returns INODE. */
 struct inode *
 inode_reopen (struct inode *inode) {
-	if (inode != NULL)
+	if (inode != NULL) {
+		lock_acquire (&open_inodes_lock);
 		inode->open_cnt++;
+		lock_release (&open_inodes_lock);
+	}
 	return inode;
 }
 
@@ -148,43 +847,151 @@ inode_get_inumber (const struct inode *inode) {
  * If INODE was also a removed inode, frees its blocks. */
 void
 inode_close (struct inode *inode) {
+	bool last;
+
 	/* Ignore null pointer. */
 	if (inode == NULL)
 		return;
 
-	/* Release resources if this was the last opener. */
-	if (--inode->open_cnt == 0) {
-		/* Remove from inode list and release lock. */
-		list_remove (&inode->elem);
+	/* The last opener places the delayed data sectors while INODE is
+	 * still in the table, so that whoever opens it meanwhile shares
+	 * them instead of reading the inode from disk without them.  Such
+	 * an opener may write more before closing again. */
+	lock_acquire (&open_inodes_lock);
+	while (inode->open_cnt == 1 && !inode->removed
+			&& !hash_empty (&inode->delayed)) {
+		bool flushed;
+
+		lock_release (&open_inodes_lock);
+		rwlock_acquire_write (&inode->lock);
+		flushed = delay_flush (inode);
+		rwlock_release_write (&inode->lock);
+		lock_acquire (&open_inodes_lock);
+		if (!flushed)
+			break;
+	}
+
+	/* Drop the inode from the table if this was the last opener. */
+	last = --inode->open_cnt == 0;
+	if (last)
+		hash_delete (&open_inodes, &inode->elem);
+	lock_release (&open_inodes_lock);
 
+	/* Release resources if this was the last opener. */
+	if (last) {
 		/* Deallocate blocks if removed. */
 		if (inode->removed) {
 			free_map_release (inode->sector, 1);
-			free_map_release (inode->data.start,
-					bytes_to_sectors (inode->data.length)); 
+			inode_release (&inode->data);
 		}
+		hash_destroy (&inode->delayed, delayed_free);
+		free_map_unreserve (inode->reserved);
 
-		free (inode); 
+		free (inode);
 	}
 }
 
 /* Marks INODE to be deleted when it is closed by the last caller who
- * has it open. */
+ * has it open.  Its cached pages hold it open too, so they are
+ * dropped now. */
 void
 inode_remove (struct inode *inode) {
 	ASSERT (inode != NULL);
 	inode->removed = true;
+	page_cache_drop (inode);
+}
+
+/* Adds a link to INODE, for a new directory entry that names it.
+ * Returns true if successful, false if INODE is a directory, which
+ * may have only one name, or has been removed. */
+bool
+inode_link (struct inode *inode) {
+	bool success = false;
+
+	lock_acquire (&link_lock);
+	if (!inode->data.is_dir && !inode->removed) {
+		inode->data.link_cnt++;
+		buffer_cache_write_meta (inode->sector, &inode->data, 0,
+				DISK_SECTOR_SIZE);
+		success = true;
+	}
+	lock_release (&link_lock);
+	return success;
+}
+
+/* Drops a link to INODE, whose directory entry was erased, and
+ * removes INODE as inode_remove() does once no links are left. */
+void
+inode_unlink (struct inode *inode) {
+	bool last;
+
+	lock_acquire (&link_lock);
+	last = inode->data.link_cnt <= 1;
+	if (!last) {
+		inode->data.link_cnt--;
+		buffer_cache_write_meta (inode->sector, &inode->data, 0,
+				DISK_SECTOR_SIZE);
+	}
+	lock_release (&link_lock);
+
+	if (last)
+		inode_remove (inode);
+}
+
+/* Returns true if INODE has been removed, false otherwise. */
+bool
+inode_is_removed (const struct inode *inode) {
+	return inode->removed;
+}
+
+/* Returns true if INODE holds a directory, false otherwise. */
+bool
+inode_is_dir (const struct inode *inode) {
+	return inode->data.is_dir != 0;
+}
+
+/* Returns true if INODE is a symbolic link, false otherwise. */
+bool
+inode_is_symlink (const struct inode *inode) {
+	return inode->data.is_symlink != 0;
+}
+
+/* Returns the target of symbolic link INODE as a new string, which
+ * the caller must free, or a null pointer if memory allocation
+ * fails or the target cannot be read. */
+char *
+inode_read_link (struct inode *inode) {
+	off_t length = inode->data.length;
+	char *target;
+
+	ASSERT (inode_is_symlink (inode));
+
+	target = malloc (length + 1);
+	if (target == NULL)
+		return NULL;
+	if (is_inline_link (&inode->data))
+		memcpy (target, inode->data.target, length);
+	else if (inode_read_at (inode, target, length, 0) != length) {
+		free (target);
+		return NULL;
+	}
+	target[length] = '\0';
+	return target;
 }
 
 /* Reads SIZE bytes from INODE into BUFFER, starting at position OFFSET.
  * Returns the number of bytes actually read, which may be less
- * than SIZE if an error occurs or end of file is reached. */
+ * than SIZE if an error occurs or end of file is reached.
+ * BUFFER must be in kernel memory, since it is copied into with
+ * INODE's lock held; see page_cache_read(). */
 off_t
 inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset) {
 	uint8_t *buffer = buffer_;
 	off_t bytes_read = 0;
-	uint8_t *bounce = NULL;
 
+	ASSERT (is_kernel_vaddr (buffer));
+
+	rwlock_acquire_read (&inode->lock);
 	while (size > 0) {
 		/* Disk sector to read, starting byte offset within sector. */
 		disk_sector_t sector_idx = byte_to_sector (inode, offset);
@@ -200,45 +1007,143 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset) {
 		if (chunk_size <= 0)
 			break;
 
-		if (sector_ofs == 0 && chunk_size == DISK_SECTOR_SIZE) {
-			/* Read full sector directly into caller's buffer. */
-			disk_read (filesys_disk, sector_idx, buffer + bytes_read); 
-		} else {
-			/* Read sector into bounce buffer, then partially copy
-			 * into caller's buffer. */
-			if (bounce == NULL) {
-				bounce = malloc (DISK_SECTOR_SIZE);
-				if (bounce == NULL)
-					break;
-			}
-			disk_read (filesys_disk, sector_idx, bounce);
-			memcpy (buffer + bytes_read, bounce + sector_ofs, chunk_size);
-		}
+		if (sector_idx == 0) {
+			struct delayed *d = delayed_find (inode, offset / DISK_SECTOR_SIZE);
+			if (d != NULL)
+				memcpy (buffer + bytes_read, d->data + sector_ofs, chunk_size);
+			else
+				memset (buffer + bytes_read, 0, chunk_size);
+		} else if (sector_idx & UNWRITTEN)
+			memset (buffer + bytes_read, 0, chunk_size);
+		else if (chunk_size == DISK_SECTOR_SIZE && !inode_is_meta (inode)) {
+			/* Read whole data sectors that follow each other on disk
+			 * with one command. */
+			size_t cnt = 1;
+
+			while (cnt < RUN_MAX && size >= (off_t) (cnt + 1) * DISK_SECTOR_SIZE
+					&& inode_length (inode) - offset
+						>= (off_t) (cnt + 1) * DISK_SECTOR_SIZE
+					&& byte_to_sector (inode, offset + cnt * DISK_SECTOR_SIZE)
+						== sector_idx + cnt)
+				cnt++;
+			chunk_size = cnt * DISK_SECTOR_SIZE;
+			if (cnt > 1)
+				buffer_cache_read_multiple (sector_idx, buffer + bytes_read, cnt);
+			else
+				buffer_cache_read (sector_idx, buffer + bytes_read, 0,
+						DISK_SECTOR_SIZE);
+		} else
+			buffer_cache_read (sector_idx, buffer + bytes_read, sector_ofs,
+					chunk_size);
 
 		/* Advance. */
 		size -= chunk_size;
 		offset += chunk_size;
 		bytes_read += chunk_size;
 	}
-	free (bounce);
+	rwlock_release_read (&inode->lock);
 
 	return bytes_read;
 }
 
+/* Writes the SIZE bytes at OFFSET in INODE from BUFFER into the
+ * run of unwritten data sectors that starts at OFFSET, zeroing
+ * whatever else those sectors hold, and then marks them as written
+ * in one journal operation.  The data goes straight to disk before
+ * the operation begins, so that after a crash each sector reads as
+ * either zeros or the new data, never as what it held before it was
+ * preallocated.  The caller must hold INODE's lock for writing.
+ * Returns the number of bytes written, which is 0 if memory ran
+ * out. */
+static off_t
+inode_convert_unwritten (struct inode *inode, const uint8_t *buffer,
+		off_t offset, off_t size) {
+	size_t idx = offset / DISK_SECTOR_SIZE;
+	size_t stop = op_index_end (idx, bytes_to_sectors (offset + size));
+	disk_sector_t first = index_to_sector (&inode->data, idx) & ~UNWRITTEN;
+	disk_sector_t goal = first;
+	size_t reserved = 0;
+	uint8_t *run;
+	off_t written;
+	size_t i, n;
+
+	run = malloc (RUN_MAX * DISK_SECTOR_SIZE);
+	if (run == NULL)
+		return 0;
+	for (n = 0; n < RUN_MAX && idx + n < stop
+			&& index_to_sector (&inode->data, idx + n)
+				== ((first + n) | UNWRITTEN); n++) {
+		off_t sector_start = (off_t) (idx + n) * DISK_SECTOR_SIZE;
+		off_t lo = sector_start > offset ? sector_start : offset;
+		off_t hi = sector_start + DISK_SECTOR_SIZE < offset + size
+			? sector_start + DISK_SECTOR_SIZE : offset + size;
+		uint8_t *data = run + n * DISK_SECTOR_SIZE;
+
+		memset (data, 0, DISK_SECTOR_SIZE);
+		memcpy (data + (lo - sector_start), buffer + (lo - offset), hi - lo);
+	}
+	buffer_cache_write_multiple (first, run, n);
+	free (run);
+
+	/* The index sectors on the way exist already, so nothing is
+	 * allocated. */
+	journal_begin ();
+	for (i = 0; i < n; i++)
+		inode_assign (&inode->data, idx + i, first + i, &goal, &reserved);
+	buffer_cache_write_meta (inode->sector, &inode->data, 0,
+			DISK_SECTOR_SIZE);
+	journal_end ();
+
+	written = (off_t) (idx + n) * DISK_SECTOR_SIZE - offset;
+	return written < size ? written : size;
+}
+
 /* Writes SIZE bytes from BUFFER into INODE, starting at OFFSET.
  * Returns the number of bytes actually written, which may be
- * less than SIZE if end of file is reached or an error occurs.
- * (Normally a write at end of file would extend the inode, but
- * growth is not yet implemented.) */
+ * less than SIZE if an error occurs.
+ * A write that ends past end of file first extends the inode,
+ * leaving any gap between the old end of file and OFFSET as a
+ * hole.  Such a write, and one that fills a hole, changes the
+ * inode's index and so excludes all other access to INODE, so that
+ * nobody sees the new end of file before the data in front of it.
+ * Data written into the holes of a regular file is kept in memory,
+ * with room reserved for it on disk, until delay_flush() places it
+ * along with whatever else was written there meanwhile.
+ * BUFFER must be in kernel memory, since it is copied from with
+ * INODE's lock held; see page_cache_write(). */
 off_t
 inode_write_at (struct inode *inode, const void *buffer_, off_t size,
 		off_t offset) {
 	const uint8_t *buffer = buffer_;
 	off_t bytes_written = 0;
-	uint8_t *bounce = NULL;
+	bool exclusive;
+
+	ASSERT (is_kernel_vaddr (buffer));
+
+	/* Writes within the file share the lock with readers. */
+	rwlock_acquire_read (&inode->lock);
+	exclusive = size > 0 && offset + size > inode_length (inode);
+	if (exclusive) {
+		rwlock_release_read (&inode->lock);
+		rwlock_acquire_write (&inode->lock);
+	}
 
 	if (inode->deny_write_cnt)
-		return 0;
+		goto done;
+
+	/* Extend the inode if the write ends past end of file. */
+	if (exclusive && offset + size > inode_length (inode)) {
+		if (bytes_to_sectors (offset + size) > MAX_SECTORS
+				|| (inode_is_meta (inode)
+					&& !inode_fill_holes (inode, offset / DISK_SECTOR_SIZE,
+						bytes_to_sectors (offset + size))))
+			goto done;
+		journal_begin ();
+		inode->data.length = offset + size;
+		buffer_cache_write_meta (inode->sector, &inode->data, 0,
+				DISK_SECTOR_SIZE);
+		journal_end ();
+	}
 
 	while (size > 0) {
 		/* Sector to write, starting byte offset within sector. */
@@ -255,45 +1160,167 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size,
 		if (chunk_size <= 0)
 			break;
 
-		if (sector_ofs == 0 && chunk_size == DISK_SECTOR_SIZE) {
-			/* Write full sector directly to disk. */
-			disk_write (filesys_disk, sector_idx, buffer + bytes_written); 
-		} else {
-			/* We need a bounce buffer. */
-			if (bounce == NULL) {
-				bounce = malloc (DISK_SECTOR_SIZE);
-				if (bounce == NULL)
-					break;
-			}
-
-			/* If the sector contains data before or after the chunk
-			   we're writing, then we need to read in the sector
-			   first.  Otherwise we start with a sector of all zeros. */
-			if (sector_ofs > 0 || chunk_size < sector_left) 
-				disk_read (filesys_disk, sector_idx, bounce);
-			else
-				memset (bounce, 0, DISK_SECTOR_SIZE);
-			memcpy (bounce + sector_ofs, buffer + bytes_written, chunk_size);
-			disk_write (filesys_disk, sector_idx, bounce); 
+		if ((sector_idx == 0 || (sector_idx & UNWRITTEN)) && !exclusive) {
+			/* First write into a hole or an unwritten sector.  Take
+			 * the lock exclusively and look again. */
+			rwlock_release_read (&inode->lock);
+			rwlock_acquire_write (&inode->lock);
+			exclusive = true;
+			continue;
 		}
 
+		if (sector_idx & UNWRITTEN) {
+			chunk_size = inode_convert_unwritten (inode, buffer + bytes_written,
+					offset, size);
+			if (chunk_size == 0)
+				break;
+		} else if (sector_idx == 0 && inode_is_meta (inode)) {
+			/* Allocate the holes in the rest of the range at once. */
+			if (!inode_fill_holes (inode, offset / DISK_SECTOR_SIZE,
+						bytes_to_sectors (offset + size)))
+				break;
+			continue;
+		} else if (sector_idx == 0) {
+			if (!delay_write (inode, offset / DISK_SECTOR_SIZE,
+						buffer + bytes_written, sector_ofs, chunk_size))
+				break;
+		} else if (inode_is_meta (inode))
+			buffer_cache_write_meta (sector_idx, buffer + bytes_written,
+					sector_ofs, chunk_size);
+		else
+			buffer_cache_write (sector_idx, buffer + bytes_written, sector_ofs,
+					chunk_size);
+
 		/* Advance. */
 		size -= chunk_size;
 		offset += chunk_size;
 		bytes_written += chunk_size;
 	}
-	free (bounce);
 
+done:
+	if (exclusive)
+		rwlock_release_write (&inode->lock);
+	else
+		rwlock_release_read (&inode->lock);
 	return bytes_written;
 }
 
+/* Allocates disk sectors for the holes among the LEN bytes of
+ * INODE that start at OFFSET, extending INODE if they end past end
+ * of file.  The holes are filled in runs of consecutive sectors,
+ * each as long as the disk has free, placed after the data in
+ * front of them.  Nothing is written to the new sectors: they are
+ * marked UNWRITTEN, so later writes into them need not allocate.
+ * Returns true if successful, false if the disk filled up, if
+ * writes to INODE are denied, or if the range is beyond the largest
+ * file an inode can index.  Sectors allocated before a failure stay
+ * allocated. */
+bool
+inode_preallocate (struct inode *inode, off_t offset, off_t len) {
+	size_t idx, end;
+	bool success = true;
+
+	if (offset < 0 || len <= 0
+			|| len > (off_t) (MAX_SECTORS * DISK_SECTOR_SIZE) - offset)
+		return false;
+	idx = offset / DISK_SECTOR_SIZE;
+	end = bytes_to_sectors (offset + len);
+
+	rwlock_acquire_write (&inode->lock);
+	if (inode->deny_write_cnt || inode_is_meta (inode))
+		success = false;
+	while (success && idx < end) {
+		disk_sector_t goal, first;
+		size_t run_end, cnt, i;
+		size_t reserved = 0;
+
+		/* Find the next run of holes. */
+		if (index_to_sector (&inode->data, idx) != 0
+				|| delayed_find (inode, idx) != NULL) {
+			idx++;
+			continue;
+		}
+		for (run_end = idx + 1; run_end < end && run_end - idx < FILL_CHUNK
+				&& index_to_sector (&inode->data, run_end) == 0
+				&& delayed_find (inode, run_end) == NULL; run_end++)
+			continue;
+
+		journal_begin ();
+		goal = goal_for (inode, idx);
+		for (cnt = run_end - idx; cnt > 0; cnt /= 2)
+			if (free_map_allocate (cnt, goal + 1, &first))
+				break;
+		success = cnt > 0;
+		if (success)
+			goal = first + cnt;
+		for (i = 0; success && i < cnt; i++) {
+			/* The sector may have held metadata before. */
+			journal_forget (first + i);
+			if (!inode_assign (&inode->data, idx + i, (first + i) | UNWRITTEN,
+						&goal, &reserved)) {
+				free_map_release (first + i, cnt - i);
+				success = false;
+			}
+		}
+		buffer_cache_write_meta (inode->sector, &inode->data, 0,
+				DISK_SECTOR_SIZE);
+		journal_end ();
+		idx += cnt;
+	}
+
+	if (success && offset + len > inode_length (inode)) {
+		journal_begin ();
+		inode->data.length = offset + len;
+		buffer_cache_write_meta (inode->sector, &inode->data, 0,
+				DISK_SECTOR_SIZE);
+		journal_end ();
+	}
+	rwlock_release_write (&inode->lock);
+	return success;
+}
+
+/* Places the delayed data sectors of every open inode on disk, so
+ * that none are lost at shutdown.  open_inodes_lock is not held
+ * while placing them, since journal_begin() may wait for operations
+ * that open and close inodes. */
+void
+inode_flush (void) {
+	for (;;) {
+		struct inode *inode = NULL;
+		struct hash_iterator it;
+		bool flushed;
+
+		lock_acquire (&open_inodes_lock);
+		hash_first (&it, &open_inodes);
+		while (inode == NULL && hash_next (&it)) {
+			struct inode *i = hash_entry (hash_cur (&it), struct inode, elem);
+			if (!hash_empty (&i->delayed)) {
+				inode = i;
+				inode->open_cnt++;
+			}
+		}
+		lock_release (&open_inodes_lock);
+		if (inode == NULL)
+			break;
+
+		rwlock_acquire_write (&inode->lock);
+		flushed = delay_flush (inode);
+		rwlock_release_write (&inode->lock);
+		inode_close (inode);
+		if (!flushed)
+			break;
+	}
+}
+
 /* Disables writes to INODE.
    May be called at most once per inode opener. */
 	void
 inode_deny_write (struct inode *inode) 
 {
+	rwlock_acquire_write (&inode->lock);
 	inode->deny_write_cnt++;
 	ASSERT (inode->deny_write_cnt <= inode->open_cnt);
+	rwlock_release_write (&inode->lock);
 }
 
 /* Re-enables writes to INODE.
@@ -301,9 +1328,11 @@ inode_deny_write (struct inode *inode)
  * inode_deny_write() on the inode, before closing the inode. */
 void
 inode_allow_write (struct inode *inode) {
+	rwlock_acquire_write (&inode->lock);
 	ASSERT (inode->deny_write_cnt > 0);
 	ASSERT (inode->deny_write_cnt <= inode->open_cnt);
 	inode->deny_write_cnt--;
+	rwlock_release_write (&inode->lock);
 }
 
 /* Returns the length, in bytes, of INODE's data. */
@@ -0,0 +1,537 @@
+#include "filesys/journal.h"
+#include <debug.h>
+#include <hash.h>
+#include <round.h>
+#include <string.h>
+#include "devices/timer.h"
+#include "filesys/filesys.h"
+#include "filesys/free-map.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+/* The journal area holds two logs, used in turn, so that the log
+ * of the previous transaction survives while the next one is being
+ * written.  Each log is a header sector naming the sectors that the
+ * transaction changed, their contents, and a commit sector.  A log
+ * counts only if its header and commit sector agree.
+ *
+ * A metadata sector that is freed and comes to hold file data may
+ * still be in a log, and replaying that log would overwrite the
+ * data.  Such a sector is revoked: the commit sector of the running
+ * transaction lists it, and replay skips it in that transaction's
+ * log and in older ones. */
+#define LOG_CNT 2
+#define LOG_SECTORS (JOURNAL_SECTORS / LOG_CNT)
+
+/* Most sectors one transaction may change. */
+#define MAX_BLOCKS 125
+
+/* A transaction is committed at the end of an operation once it
+ * has changed this many sectors or is this many ticks old, so that
+ * many operations share one trip to the log. */
+#define COMMIT_BLOCKS 48
+#define COMMIT_TICKS (5 * TIMER_FREQ)
+
+#define JOURNAL_MAGIC 0x4a524e4c
+
+/* Most sectors one transaction may revoke. */
+#define REVOKE_MAX 124
+
+/* Log header sector. */
+struct log_header {
+	uint32_t magic;                     /* JOURNAL_MAGIC. */
+	uint32_t seq;                       /* Transaction sequence number. */
+	uint32_t cnt;                       /* Number of sectors logged. */
+	disk_sector_t sectors[MAX_BLOCKS];  /* Home of each logged sector. */
+};
+
+/* Log commit sector. */
+struct log_commit {
+	uint32_t magic;                     /* JOURNAL_MAGIC. */
+	uint32_t seq;                       /* Same as in the header. */
+	uint32_t cnt;                       /* Same as in the header. */
+	uint32_t revoke_cnt;                /* Number of sectors revoked. */
+	disk_sector_t revoked[REVOKE_MAX];  /* Sectors not to replay. */
+};
+
+/* The latest contents of a sector changed by a transaction.
+ * CHECKPOINTED is set once the sector has been written in place
+ * with these contents or newer ones. */
+struct jblock {
+	struct hash_elem elem;              /* Element in transaction. */
+	disk_sector_t sector;               /* Home sector. */
+	bool checkpointed;                  /* Written in place? */
+	struct disk_request request;        /* Write in progress, if any. */
+	uint8_t data[DISK_SECTOR_SIZE];     /* Contents. */
+};
+
+/* A transaction: one jblock for each sector it changed, and the
+ * sectors it revoked. */
+struct transaction {
+	struct hash blocks;
+	uint32_t seq;
+	size_t revoke_cnt;
+	disk_sector_t revoked[REVOKE_MAX];
+};
+
+/* The running transaction, the last one committed and the one
+ * before it, whose log has not been overwritten yet.  journal_lock
+ * guards them and everything below. */
+static struct transaction txs[LOG_CNT + 1];
+static struct transaction *running;
+static struct transaction *committed[LOG_CNT];
+static struct lock journal_lock;
+
+static int active_cnt;                  /* Outermost operations in progress. */
+static bool committing;                 /* Commit in progress? */
+static struct condition journal_cond;   /* Signaled when either changes. */
+static int64_t running_start;           /* When RUNNING got its first block. */
+static disk_sector_t journal_start;     /* First sector of the journal. */
+
+/* Sectors of a transaction left for operations, once room is kept
+ * for the free map, which is written at every commit. */
+static size_t op_room;
+
+static uint64_t
+jblock_hash (const struct hash_elem *e, void *aux UNUSED) {
+	return hash_int (hash_entry (e, struct jblock, elem)->sector);
+}
+
+static bool
+jblock_less (const struct hash_elem *a, const struct hash_elem *b,
+		void *aux UNUSED) {
+	return hash_entry (a, struct jblock, elem)->sector
+		< hash_entry (b, struct jblock, elem)->sector;
+}
+
+static void
+jblock_free (struct hash_elem *e, void *aux UNUSED) {
+	free (hash_entry (e, struct jblock, elem));
+}
+
+/* Returns TX's block for SECTOR, or a null pointer if TX did not
+ * change SECTOR. */
+static struct jblock *
+find (struct transaction *tx, disk_sector_t sector) {
+	struct jblock key;
+	struct hash_elem *e;
+
+	key.sector = sector;
+	e = hash_find (&tx->blocks, &key.elem);
+	return e != NULL ? hash_entry (e, struct jblock, elem) : NULL;
+}
+
+/* Returns the first sector of log number LOG. */
+static disk_sector_t
+log_sector (int log) {
+	return journal_start + log * LOG_SECTORS;
+}
+
+/* Reads log number LOG into *H and *C.  Returns true if it holds
+ * a whole transaction. */
+static bool
+read_log (int log, struct log_header *h, struct log_commit *c) {
+	disk_read (filesys_disk, log_sector (log), h);
+	if (h->magic != JOURNAL_MAGIC || h->cnt > MAX_BLOCKS)
+		return false;
+	disk_read (filesys_disk, log_sector (log) + 1 + h->cnt, c);
+	return c->magic == JOURNAL_MAGIC && c->seq == h->seq && c->cnt == h->cnt
+		&& c->revoke_cnt <= REVOKE_MAX;
+}
+
+/* Returns true if the transaction that C commits revoked SECTOR. */
+static bool
+revoked (const struct log_commit *c, disk_sector_t sector) {
+	uint32_t i;
+
+	for (i = 0; i < c->revoke_cnt; i++)
+		if (c->revoked[i] == sector)
+			return true;
+	return false;
+}
+
+/* Writes the sectors logged in log number LOG, described by H, to
+ * their homes, except those that the same transaction or a later
+ * one among the VALID logs, committed by COMMITS, revoked. */
+static void
+replay_log (int log, const struct log_header *h,
+		const struct log_commit commits[], const bool valid[]) {
+	static uint8_t data[DISK_SECTOR_SIZE];
+	uint32_t i;
+	int l;
+
+	for (i = 0; i < h->cnt; i++) {
+		for (l = 0; l < LOG_CNT; l++)
+			if (valid[l] && commits[l].seq >= h->seq
+					&& revoked (&commits[l], h->sectors[i]))
+				break;
+		if (l < LOG_CNT)
+			continue;
+		disk_read (filesys_disk, log_sector (log) + 1 + i, data);
+		disk_write (filesys_disk, h->sectors[i], data);
+	}
+}
+
+/* Marks both logs empty. */
+static void
+clear_logs (void) {
+	static uint8_t zeros[DISK_SECTOR_SIZE];
+	int log;
+
+	for (log = 0; log < LOG_CNT; log++)
+		disk_write (filesys_disk, log_sector (log), zeros);
+}
+
+/* Initializes the journal.  Unless FORMAT is true, first replays
+ * whatever transactions the logs hold, oldest first, so that the
+ * file system reflects every committed transaction. */
+void
+journal_init (bool format) {
+	static struct log_header headers[LOG_CNT];
+	static struct log_commit commits[LOG_CNT];
+	bool valid[LOG_CNT];
+	uint32_t seq = 0;
+	int log;
+
+	ASSERT (sizeof (struct log_header) == DISK_SECTOR_SIZE);
+	ASSERT (sizeof (struct log_commit) == DISK_SECTOR_SIZE);
+
+	journal_start = disk_size (filesys_disk) - JOURNAL_SECTORS;
+	op_room = MAX_BLOCKS - DIV_ROUND_UP (DIV_ROUND_UP (disk_size (filesys_disk),
+				64) * 8, DISK_SECTOR_SIZE);
+	if (op_room > MAX_BLOCKS || op_room < JOURNAL_OP_SECTORS)
+		PANIC ("file system disk too large for the journal");
+	for (log = 0; log < LOG_CNT + 1; log++) {
+		if (!hash_init (&txs[log].blocks, jblock_hash, jblock_less, NULL))
+			PANIC ("journal creation failed");
+		txs[log].revoke_cnt = 0;
+	}
+	running = &txs[0];
+	for (log = 0; log < LOG_CNT; log++)
+		committed[log] = &txs[log + 1];
+	lock_init (&journal_lock);
+	cond_init (&journal_cond);
+	active_cnt = 0;
+	committing = false;
+
+	if (!format) {
+		for (log = 0; log < LOG_CNT; log++)
+			valid[log] = read_log (log, &headers[log], &commits[log]);
+		if (valid[0] && valid[1]) {
+			int first = headers[0].seq < headers[1].seq ? 0 : 1;
+			replay_log (first, &headers[first], commits, valid);
+			replay_log (!first, &headers[!first], commits, valid);
+		} else
+			for (log = 0; log < LOG_CNT; log++)
+				if (valid[log])
+					replay_log (log, &headers[log], commits, valid);
+		for (log = 0; log < LOG_CNT; log++)
+			if (valid[log] && headers[log].seq > seq)
+				seq = headers[log].seq;
+	}
+	clear_logs ();
+	running->seq = seq + 1;
+}
+
+/* Writes the blocks of TX that have not reached their homes yet
+ * there, skipping those that NEWER, if not null, changed too.  The
+ * writes go to the disk queue all at once, for it to sort. */
+static void
+checkpoint (struct transaction *tx, struct transaction *newer) {
+	struct hash_iterator i;
+
+	hash_first (&i, &tx->blocks);
+	while (hash_next (&i)) {
+		struct jblock *b = hash_entry (hash_cur (&i), struct jblock, elem);
+		if (!b->checkpointed && (newer == NULL || find (newer, b->sector) == NULL)) {
+			disk_request_init (&b->request, filesys_disk, b->sector, b->data,
+					1, true);
+			disk_submit (&b->request, NULL, NULL);
+		}
+	}
+
+	hash_first (&i, &tx->blocks);
+	while (hash_next (&i)) {
+		struct jblock *b = hash_entry (hash_cur (&i), struct jblock, elem);
+		if (!b->checkpointed && (newer == NULL || find (newer, b->sector) == NULL))
+			disk_wait (&b->request);
+	}
+	hash_clear (&tx->blocks, jblock_free);
+}
+
+/* Writes the running transaction to the log and starts a new one.
+ * The caller must hold journal_lock and have set COMMITTING.
+ *
+ * The log it goes to holds the transaction before last, so the
+ * sectors of that one which were not changed again since are put
+ * in place first.  The others are covered by the last transaction's
+ * log, which stays intact until this one is committed. */
+static void
+write_log (void) {
+	static struct log_header h;
+	static struct log_commit c;
+	struct transaction *oldest = committed[LOG_CNT - 1];
+	int log = running->seq % LOG_CNT;
+	struct hash_iterator i;
+	uint32_t cnt = 0;
+
+	checkpoint (oldest, committed[0]);
+	if (hash_empty (&running->blocks) && running->revoke_cnt == 0)
+		return;
+
+	/* The blocks go to consecutive log sectors, which the disk
+	 * merges into few commands. */
+	hash_first (&i, &running->blocks);
+	while (hash_next (&i)) {
+		struct jblock *b = hash_entry (hash_cur (&i), struct jblock, elem);
+		disk_request_init (&b->request, filesys_disk,
+				log_sector (log) + 1 + cnt, b->data, 1, true);
+		disk_submit (&b->request, NULL, NULL);
+		h.sectors[cnt++] = b->sector;
+	}
+	hash_first (&i, &running->blocks);
+	while (hash_next (&i))
+		disk_wait (&hash_entry (hash_cur (&i), struct jblock, elem)->request);
+	h.magic = c.magic = JOURNAL_MAGIC;
+	h.seq = c.seq = running->seq;
+	h.cnt = c.cnt = cnt;
+	c.revoke_cnt = running->revoke_cnt;
+	memcpy (c.revoked, running->revoked,
+			running->revoke_cnt * sizeof *running->revoked);
+	disk_write (filesys_disk, log_sector (log), &h);
+	disk_write (filesys_disk, log_sector (log) + 1 + cnt, &c);
+
+	/* Rotate: the running transaction becomes the last committed
+	 * one, and the emptied oldest one starts running. */
+	committed[LOG_CNT - 1] = committed[0];
+	committed[0] = running;
+	oldest->seq = running->seq + 1;
+	oldest->revoke_cnt = 0;
+	running = oldest;
+}
+
+/* Commits the running transaction.  The caller must hold
+ * journal_lock, and no operation may be in progress.
+ * The free map is written first, so that the transaction includes
+ * the allocations made by the operations in it. */
+static void
+commit (void) {
+	ASSERT (active_cnt == 0 && !committing);
+
+	committing = true;
+	lock_release (&journal_lock);
+	free_map_flush ();
+	lock_acquire (&journal_lock);
+	write_log ();
+	committing = false;
+	cond_broadcast (&journal_cond, &journal_lock);
+}
+
+/* Begins an operation whose metadata changes must be committed
+ * together.  Operations may nest; an operation begun inside another
+ * is part of it and so never waits.
+ * An operation may change at most JOURNAL_OP_SECTORS sectors, which
+ * are set aside for it in the running transaction.  If the running
+ * transaction has no room left, waits for the operations in progress
+ * to end and commits it.  The caller must therefore not hold a lock
+ * that an operation in progress may wait for. */
+void
+journal_begin (void) {
+	if (thread_current ()->journal_depth++ > 0)
+		return;
+
+	lock_acquire (&journal_lock);
+	for (;;) {
+		if (!committing && hash_size (&running->blocks)
+				+ (active_cnt + 1) * JOURNAL_OP_SECTORS <= op_room)
+			break;
+		if (!committing && active_cnt == 0)
+			commit ();
+		else
+			cond_wait (&journal_cond, &journal_lock);
+	}
+	active_cnt++;
+	lock_release (&journal_lock);
+}
+
+/* Ends an operation begun with journal_begin().  The last
+ * operation to end commits the running transaction if it has
+ * grown large or old enough. */
+void
+journal_end (void) {
+	struct thread *t = thread_current ();
+
+	ASSERT (t->journal_depth > 0);
+	if (--t->journal_depth > 0)
+		return;
+
+	lock_acquire (&journal_lock);
+	ASSERT (active_cnt > 0);
+	if (--active_cnt == 0) {
+		size_t cnt = hash_size (&running->blocks);
+		if (!committing && (cnt >= COMMIT_BLOCKS
+					|| (cnt > 0 && timer_elapsed (running_start) >= COMMIT_TICKS)))
+			commit ();
+	}
+	/* The room set aside for this operation is free again. */
+	cond_broadcast (&journal_cond, &journal_lock);
+	lock_release (&journal_lock);
+}
+
+/* Commits the running transaction now, waiting for operations in
+ * progress to end first. */
+void
+journal_commit (void) {
+	lock_acquire (&journal_lock);
+	while (active_cnt > 0 || committing)
+		cond_wait (&journal_cond, &journal_lock);
+	commit ();
+	lock_release (&journal_lock);
+}
+
+/* Puts every sector of the committed transactions in place and
+ * empties the logs, so that nothing is replayed at the next boot
+ * and the running transaction need not revoke anything.  The
+ * caller must hold journal_lock. */
+static void
+empty_logs (void) {
+	int log;
+
+	for (log = LOG_CNT - 1; log >= 0; log--)
+		checkpoint (committed[log], NULL);
+	clear_logs ();
+	running->revoke_cnt = 0;
+}
+
+/* Commits the running transaction and puts every logged sector in
+ * place, leaving the logs empty. */
+void
+journal_done (void) {
+	journal_commit ();
+	lock_acquire (&journal_lock);
+	empty_logs ();
+	lock_release (&journal_lock);
+}
+
+/* Takes SECTOR off the running transaction's revoked sectors, since
+ * it holds metadata again.  The caller must hold journal_lock. */
+static void
+unrevoke (disk_sector_t sector) {
+	size_t i;
+
+	for (i = 0; i < running->revoke_cnt; i++)
+		if (running->revoked[i] == sector) {
+			running->revoked[i] = running->revoked[--running->revoke_cnt];
+			return;
+		}
+}
+
+/* Records that SECTOR now holds DATA, a whole sector, as part of
+ * the running transaction. */
+void
+journal_log (disk_sector_t sector, const void *data) {
+	struct jblock *b;
+
+	lock_acquire (&journal_lock);
+	unrevoke (sector);
+	b = find (running, sector);
+	if (b == NULL) {
+		if (hash_size (&running->blocks) >= MAX_BLOCKS)
+			PANIC ("journal transaction overflow");
+		b = malloc (sizeof *b);
+		if (b == NULL)
+			PANIC ("journal block allocation failed");
+		b->sector = sector;
+		b->checkpointed = false;
+		if (hash_empty (&running->blocks))
+			running_start = timer_ticks ();
+		hash_insert (&running->blocks, &b->elem);
+	}
+	memcpy (b->data, data, DISK_SECTOR_SIZE);
+	lock_release (&journal_lock);
+}
+
+/* Copies the latest contents of SECTOR into DATA and returns true,
+ * if they are newer than what is in place on disk. */
+bool
+journal_read (disk_sector_t sector, void *data) {
+	struct jblock *b;
+	int log;
+
+	lock_acquire (&journal_lock);
+	b = find (running, sector);
+	for (log = 0; b == NULL && log < LOG_CNT; log++)
+		b = find (committed[log], sector);
+	if (b != NULL && b->checkpointed)
+		b = NULL;
+	if (b != NULL)
+		memcpy (data, b->data, DISK_SECTOR_SIZE);
+	lock_release (&journal_lock);
+	return b != NULL;
+}
+
+/* Called before the buffer cache writes SECTOR in place.  Returns
+ * false if it must not, because the running transaction changed
+ * it; the journal holds those changes until they are committed. */
+bool
+journal_may_write_back (disk_sector_t sector) {
+	bool may;
+
+	lock_acquire (&journal_lock);
+	may = find (running, sector) == NULL;
+	lock_release (&journal_lock);
+	return may;
+}
+
+/* Called once the buffer cache has written SECTOR in place, after
+ * journal_may_write_back() allowed it.  Only now may the logs of
+ * the committed transactions that changed SECTOR be overwritten
+ * without putting it in place first.  The buffer cache keeps the
+ * sector locked in between, so nothing logged it meanwhile. */
+void
+journal_written_back (disk_sector_t sector) {
+	int log;
+
+	lock_acquire (&journal_lock);
+	for (log = 0; log < LOG_CNT; log++) {
+		struct jblock *b = find (committed[log], sector);
+		if (b != NULL)
+			b->checkpointed = true;
+	}
+	lock_release (&journal_lock);
+}
+
+/* Forgets whatever the journal knows about SECTOR, which is about
+ * to hold file data rather than metadata, and revokes it if a log
+ * holds it, so that replay does not overwrite the data.  If the
+ * running transaction cannot revoke any more sectors, empties the
+ * logs instead. */
+void
+journal_forget (disk_sector_t sector) {
+	struct jblock *b;
+	bool logged = false;
+	int log;
+
+	lock_acquire (&journal_lock);
+	unrevoke (sector);
+	b = find (running, sector);
+	if (b != NULL) {
+		hash_delete (&running->blocks, &b->elem);
+		free (b);
+	}
+	for (log = 0; log < LOG_CNT; log++) {
+		b = find (committed[log], sector);
+		if (b != NULL) {
+			b->checkpointed = true;
+			logged = true;
+		}
+	}
+	if (logged) {
+		if (running->revoke_cnt == REVOKE_MAX)
+			empty_logs ();
+		else
+			running->revoked[running->revoke_cnt++] = sector;
+	}
+	lock_release (&journal_lock);
+}
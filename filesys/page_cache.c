@@ -1,6 +1,17 @@
 /* page_cache.c: Implementation of Page Cache (Buffer Cache). */
 
 #include "vm/vm.h"
+#include <debug.h>
+#include <string.h>
+#include "filesys/filesys.h"
+#include "filesys/inode.h"
+#include "threads/malloc.h"
+#include "threads/mmu.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+
 static bool page_cache_readahead (struct page *page, void *kva);
 static bool page_cache_writeback (struct page *page);
 static void page_cache_destroy (struct page *page);
@@ -13,38 +24,519 @@ static const struct page_operations page_cache_op = {
 	.type = VM_PAGE_CACHE,
 };
 
-tid_t page_cache_workerd;
+/* A user page that maps a cached page's frame. */
+struct mapping {
+	struct list_elem elem;              /* Element in page's mappings. */
+	struct thread *owner;               /* Process that maps the frame. */
+	struct page *page;                  /* Its VM_FILE page. */
+};
+
+/* Cached pages, keyed by inode and offset, and the same pages in
+ * no particular order.  page_cache_lock guards both and every
+ * member of struct page_cache except the data in the frame.
+ * page_cache_cond is signaled whenever a page finishes loading or
+ * leaves the cache. */
+static struct hash pages;
+static struct list all_pages;
+static struct lock page_cache_lock;
+static struct condition page_cache_cond;
+
+/* Set once the VM is up, since the frames come from it. */
+static bool enabled;
+
+static uint64_t
+page_cache_hash (const struct hash_elem *e, void *aux UNUSED) {
+	const struct page *p = hash_entry (e, struct page, page_cache.hash_elem);
+	return hash_bytes (&p->page_cache.inode, sizeof p->page_cache.inode)
+		^ hash_int (p->page_cache.ofs);
+}
+
+static bool
+page_cache_less (const struct hash_elem *a_, const struct hash_elem *b_,
+		void *aux UNUSED) {
+	const struct page_cache *a =
+		&hash_entry (a_, struct page, page_cache.hash_elem)->page_cache;
+	const struct page_cache *b =
+		&hash_entry (b_, struct page, page_cache.hash_elem)->page_cache;
+	if (a->inode != b->inode)
+		return a->inode < b->inode;
+	return a->ofs < b->ofs;
+}
 
 /* The initializer of file vm */
 void
-pagecache_init (void) {
-	/* TODO: Create a worker daemon for page cache with page_cache_kworkerd */
+page_cache_init (void) {
+	if (!hash_init (&pages, page_cache_hash, page_cache_less, NULL))
+		PANIC ("page cache creation failed");
+	list_init (&all_pages);
+	lock_init (&page_cache_lock);
+	cond_init (&page_cache_cond);
+	enabled = true;
 }
 
 /* Initialize the page cache */
 bool
-page_cache_initializer (struct page *page, enum vm_type type, void *kva) {
+page_cache_initializer (struct page *page, enum vm_type type UNUSED,
+		void *kva UNUSED) {
 	/* Set up the handler */
 	page->operations = &page_cache_op;
+	return true;
+}
+
+/* Returns true if INODE's data goes through the page cache.
+ * Directories and the free map are only ever accessed a sector at
+ * a time through the buffer cache. */
+static bool
+cacheable (struct inode *inode) {
+	return enabled && !inode_is_dir (inode)
+		&& inode_get_inumber (inode) != FREE_MAP_SECTOR;
+}
+
+/* Returns the cached page for OFS in INODE, or a null pointer if
+ * there is none.  The caller must hold page_cache_lock. */
+static struct page *
+find (struct inode *inode, off_t ofs) {
+	struct page key;
+	struct hash_elem *e;
+
+	key.page_cache.inode = inode;
+	key.page_cache.ofs = ofs;
+	e = hash_find (&pages, &key.page_cache.hash_elem);
+	return e != NULL ? hash_entry (e, struct page, page_cache.hash_elem) : NULL;
+}
+
+/* Returns the cached page for OFS in INODE, pinned and loaded, or a
+ * null pointer if there is none.  Waits for a page that is being
+ * loaded or evicted.  The caller must hold page_cache_lock. */
+static struct page *
+find_pinned (struct inode *inode, off_t ofs) {
+	struct page *p;
+
+	while ((p = find (inode, ofs)) != NULL
+			&& (!p->page_cache.loaded || p->page_cache.evicting))
+		cond_wait (&page_cache_cond, &page_cache_lock);
+	if (p != NULL) {
+		p->page_cache.pin_cnt++;
+		p->page_cache.accessed = true;
+	}
+	return p;
+}
+
+/* Returns true if P is of no further use: its file is gone and
+ * nobody maps or pins it.  The caller must hold page_cache_lock. */
+static bool
+unused (struct page *p) {
+	struct page_cache *pc = &p->page_cache;
+	return pc->pin_cnt == 0 && pc->loaded && !pc->evicting
+		&& list_empty (&pc->mappings) && inode_is_removed (pc->inode);
+}
 
+/* Takes P out of the cache.  The caller must hold page_cache_lock
+ * and, once it has released it, free P with vm_dealloc_page(). */
+static void
+unlink (struct page *p) {
+	hash_delete (&pages, &p->page_cache.hash_elem);
+	list_remove (&p->page_cache.list_elem);
+	cond_broadcast (&page_cache_cond, &page_cache_lock);
+}
+
+/* Unpins P, which the caller pinned, and frees it if that was the
+ * last use of a removed file's page. */
+static void
+unpin (struct page *p) {
+	bool release;
+
+	lock_acquire (&page_cache_lock);
+	p->page_cache.pin_cnt--;
+	release = unused (p);
+	if (release)
+		unlink (p);
+	lock_release (&page_cache_lock);
+	if (release)
+		vm_dealloc_page (p);
+}
+
+/* Returns the page for OFS in INODE, pinned, loading it into a new
+ * frame if it is not cached.  Returns a null pointer if memory is
+ * exhausted. */
+static struct page *
+get_page (struct inode *inode, off_t ofs) {
+	for (;;) {
+		struct page *p;
+
+		lock_acquire (&page_cache_lock);
+		p = find_pinned (inode, ofs);
+		lock_release (&page_cache_lock);
+		if (p != NULL)
+			return p;
+
+		/* Allocating a frame may evict another cached page, so it is
+		 * done without holding page_cache_lock.  The page starts out
+		 * pinned so that it cannot be chosen as a victim itself. */
+		p = malloc (sizeof *p);
+		if (p == NULL)
+			return NULL;
+		page_cache_initializer (p, VM_PAGE_CACHE, NULL);
+		p->va = NULL;
+		p->writable = false;
+		p->owner = NULL;
+		p->page_cache.inode = inode;
+		p->page_cache.ofs = ofs;
+		list_init (&p->page_cache.mappings);
+		p->page_cache.pin_cnt = 1;
+		p->page_cache.loaded = false;
+		p->page_cache.evicting = false;
+		p->page_cache.accessed = true;
+		vm_frame_alloc (p);
+
+		lock_acquire (&page_cache_lock);
+		if (find (inode, ofs) != NULL) {
+			/* Someone else cached it while we were allocating. */
+			lock_release (&page_cache_lock);
+			vm_frame_free (p->frame);
+			free (p);
+			continue;
+		}
+		p->page_cache.inode = inode_reopen (inode);
+		hash_insert (&pages, &p->page_cache.hash_elem);
+		list_push_back (&all_pages, &p->page_cache.list_elem);
+		lock_release (&page_cache_lock);
+
+		/* Lookups of the same page wait until it is loaded.  A write
+		 * that races with loading updates the page only after that,
+		 * so the page cannot end up older than the disk. */
+		swap_in (p, p->frame->kva);
+
+		lock_acquire (&page_cache_lock);
+		p->page_cache.loaded = true;
+		cond_broadcast (&page_cache_cond, &page_cache_lock);
+		lock_release (&page_cache_lock);
+		return p;
+	}
+}
+
+/* Reads or, if WRITE is true, writes SIZE bytes of BUFFER at
+ * OFFSET in INODE around the page cache, and returns the number of
+ * bytes transferred.  The inode layer copies while it holds its own
+ * and the buffer cache's locks, so a copy that faults on an mmap of
+ * the same file would take them again.  User data is therefore
+ * passed through a kernel page, or a sector if no page is free,
+ * and copied to or from BUFFER with no lock held. */
+static off_t
+inode_io (struct inode *inode, void *buffer_, off_t size, off_t offset,
+		bool write) {
+	uint8_t *buffer = buffer_;
+	uint8_t *bounce;
+	off_t bounce_size = PGSIZE;
+	off_t done = 0;
+
+	if (is_kernel_vaddr (buffer))
+		return write ? inode_write_at (inode, buffer, size, offset)
+			: inode_read_at (inode, buffer, size, offset);
+
+	bounce = palloc_get_page (0);
+	if (bounce == NULL) {
+		bounce = malloc (DISK_SECTOR_SIZE);
+		bounce_size = DISK_SECTOR_SIZE;
+		if (bounce == NULL)
+			return 0;
+	}
+	while (done < size) {
+		off_t chunk = size - done < bounce_size ? size - done : bounce_size;
+		off_t n;
+
+		if (write) {
+			memcpy (bounce, buffer + done, chunk);
+			n = inode_write_at (inode, bounce, chunk, offset + done);
+		} else {
+			n = inode_read_at (inode, bounce, chunk, offset + done);
+			memcpy (buffer + done, bounce, n);
+		}
+		done += n;
+		if (n < chunk)
+			break;
+	}
+	if (bounce_size == PGSIZE)
+		palloc_free_page (bounce);
+	else
+		free (bounce);
+	return done;
+}
+
+/* Reads SIZE bytes from INODE into BUFFER, starting at position
+ * OFFSET, through the page cache.  Returns the number of bytes
+ * actually read, which may be less than SIZE if end of file is
+ * reached. */
+off_t
+page_cache_read (struct inode *inode, void *buffer_, off_t size,
+		off_t offset) {
+	uint8_t *buffer = buffer_;
+	off_t bytes_read = 0;
+
+	if (!cacheable (inode))
+		return inode_io (inode, buffer, size, offset, false);
+
+	while (size > 0) {
+		int page_ofs = offset % PGSIZE;
+		off_t inode_left = inode_length (inode) - offset;
+		int page_left = PGSIZE - page_ofs;
+		int min_left = inode_left < page_left ? inode_left : page_left;
+		int chunk_size = size < min_left ? size : min_left;
+		struct page *p;
+
+		if (chunk_size <= 0)
+			break;
+
+		p = get_page (inode, offset - page_ofs);
+		if (p == NULL) {
+			/* Out of memory: read around the cache. */
+			bytes_read += inode_io (inode, buffer + bytes_read, size, offset,
+					false);
+			break;
+		}
+		/* The page stays pinned while the data is copied, since
+		 * BUFFER may fault in and evict other pages. */
+		memcpy (buffer + bytes_read, (uint8_t *) p->frame->kva + page_ofs,
+				chunk_size);
+		unpin (p);
+
+		size -= chunk_size;
+		offset += chunk_size;
+		bytes_read += chunk_size;
+	}
+	return bytes_read;
+}
+
+/* Writes SIZE bytes from BUFFER into INODE, starting at OFFSET, and
+ * brings any cached pages in that range up to date.  Returns the
+ * number of bytes actually written.
+ *
+ * Writes go straight through to the buffer cache, so cached pages
+ * are never dirtier than the mappings of them.  The cached copy is
+ * then re-read from the buffer cache rather than from BUFFER, so
+ * that racing writers leave it matching whatever reached the disk
+ * last. */
+off_t
+page_cache_write (struct inode *inode, const void *buffer, off_t size,
+		off_t offset) {
+	off_t bytes_written = inode_io (inode, (void *) buffer, size, offset,
+			true);
+	off_t end = offset + bytes_written;
+
+	if (!cacheable (inode))
+		return bytes_written;
+
+	while (offset < end) {
+		int page_ofs = offset % PGSIZE;
+		int page_left = PGSIZE - page_ofs;
+		int chunk_size = end - offset < page_left ? end - offset : page_left;
+		struct page *p;
+
+		lock_acquire (&page_cache_lock);
+		p = find_pinned (inode, offset - page_ofs);
+		lock_release (&page_cache_lock);
+		if (p != NULL) {
+			inode_read_at (inode, (uint8_t *) p->frame->kva + page_ofs,
+					chunk_size, offset);
+			unpin (p);
+		}
+		offset += chunk_size;
+	}
+	return bytes_written;
+}
+
+/* Maps PAGE, a VM_FILE page of the current process, to the cached
+ * page for OFFSET in INODE, loading it if needed. */
+bool
+page_cache_map (struct page *page, struct inode *inode, off_t offset) {
+	struct thread *curr = thread_current ();
+	struct mapping *m;
+	struct page *p;
+
+	ASSERT (offset % PGSIZE == 0);
+
+	m = malloc (sizeof *m);
+	if (m == NULL)
+		return false;
+	p = get_page (inode, offset);
+	if (p == NULL
+			|| !pml4_set_page (curr->pml4, page->va, p->frame->kva,
+				page->writable)) {
+		if (p != NULL)
+			unpin (p);
+		free (m);
+		return false;
+	}
+
+	/* Record the mapping before unpinning, so that eviction finds
+	 * and removes it. */
+	m->owner = curr;
+	m->page = page;
+	lock_acquire (&page_cache_lock);
+	list_push_back (&p->page_cache.mappings, &m->elem);
+	page->frame = p->frame;
+	lock_release (&page_cache_lock);
+	unpin (p);
+	return true;
+}
+
+/* Returns the number of bytes of P that lie within its file. */
+static int
+valid_bytes (struct page *p) {
+	off_t left = inode_length (p->page_cache.inode) - p->page_cache.ofs;
+	return left <= 0 ? 0 : left < PGSIZE ? left : PGSIZE;
+}
+
+/* Removes mapping M of the cached page P from its owner's page
+ * table.  Returns true if the owner wrote to the page.  The caller
+ * must hold page_cache_lock. */
+static bool
+remove_mapping (struct mapping *m) {
+	uint64_t *pml4 = m->owner->pml4;
+	bool dirty = pml4_is_dirty (pml4, m->page->va);
+
+	pml4_clear_page (pml4, m->page->va);
+	m->page->frame = NULL;
+	list_remove (&m->elem);
+	free (m);
+	return dirty;
+}
+
+/* Unmaps PAGE, a VM_FILE page of the current process, from the
+ * page cache, writing the page back to its file if the process
+ * wrote to it.  Does nothing if PAGE is not mapped, for example
+ * because the cached page was evicted. */
+void
+page_cache_unmap (struct page *page) {
+	struct page *p;
+	struct list_elem *e;
+	bool dirty = false;
+
+	lock_acquire (&page_cache_lock);
+	if (page->frame == NULL) {
+		lock_release (&page_cache_lock);
+		return;
+	}
+	p = page->frame->page;
+	for (e = list_begin (&p->page_cache.mappings);
+			e != list_end (&p->page_cache.mappings); e = list_next (e)) {
+		struct mapping *m = list_entry (e, struct mapping, elem);
+		if (m->page == page) {
+			dirty = remove_mapping (m);
+			break;
+		}
+	}
+	p->page_cache.pin_cnt++;
+	lock_release (&page_cache_lock);
+
+	if (dirty)
+		inode_write_at (p->page_cache.inode, p->frame->kva, valid_bytes (p),
+				p->page_cache.ofs);
+	unpin (p);
+}
+
+/* Decides whether the VM may evict PAGE, a cached page, now: if
+ * it was used since the clock hand last passed, clears its own and
+ * its mappings' accessed bits and returns false.  Otherwise, marks
+ * it as being evicted and returns true.  Pinned pages are never
+ * chosen. */
+bool
+page_cache_select (struct page *page) {
+	struct page_cache *pc = &page->page_cache;
+	struct list_elem *e;
+	bool accessed;
+
+	lock_acquire (&page_cache_lock);
+	accessed = pc->pin_cnt > 0 || !pc->loaded || pc->evicting || pc->accessed;
+	pc->accessed = false;
+	for (e = list_begin (&pc->mappings); e != list_end (&pc->mappings);
+			e = list_next (e)) {
+		struct mapping *m = list_entry (e, struct mapping, elem);
+		if (pml4_is_accessed (m->owner->pml4, m->page->va)) {
+			pml4_set_accessed (m->owner->pml4, m->page->va, false);
+			accessed = true;
+		}
+	}
+	if (!accessed)
+		pc->evicting = true;
+	lock_release (&page_cache_lock);
+	return !accessed;
+}
+
+/* Drops every cached page of INODE that nobody maps or pins,
+ * because INODE was removed.  The rest are dropped as soon as they
+ * are no longer in use. */
+void
+page_cache_drop (struct inode *inode) {
+	struct list dropped;
+	struct list_elem *e;
+
+	if (!enabled)
+		return;
+
+	list_init (&dropped);
+	lock_acquire (&page_cache_lock);
+	for (e = list_begin (&all_pages); e != list_end (&all_pages); ) {
+		struct page *p = list_entry (e, struct page, page_cache.list_elem);
+		e = list_next (e);
+		if (p->page_cache.inode == inode && unused (p)) {
+			unlink (p);
+			list_push_back (&dropped, &p->page_cache.list_elem);
+		}
+	}
+	lock_release (&page_cache_lock);
+
+	while (!list_empty (&dropped))
+		vm_dealloc_page (list_entry (list_pop_front (&dropped), struct page,
+					page_cache.list_elem));
 }
 
 /* Utilze the Swap in mechanism to implement readhead */
 static bool
 page_cache_readahead (struct page *page, void *kva) {
+	struct page_cache *pc = &page->page_cache;
+	off_t bytes_read = inode_read_at (pc->inode, kva, PGSIZE, pc->ofs);
+
+	memset ((uint8_t *) kva + bytes_read, 0, PGSIZE - bytes_read);
+	return true;
 }
 
-/* Utilze the Swap out mechanism to implement writeback */
+/* Utilze the Swap out mechanism to implement writeback.
+ *
+ * Called on a page that page_cache_select() chose.  Unmaps it from
+ * every process, writes it back if any of them wrote to it, and
+ * frees everything but the frame, which the VM reuses. */
 static bool
 page_cache_writeback (struct page *page) {
+	struct page_cache *pc = &page->page_cache;
+	bool dirty = false;
+
+	ASSERT (pc->evicting);
+
+	lock_acquire (&page_cache_lock);
+	while (!list_empty (&pc->mappings))
+		dirty |= remove_mapping (list_entry (list_front (&pc->mappings),
+					struct mapping, elem));
+	lock_release (&page_cache_lock);
+
+	/* The page stays in the table until it is written back, so that
+	 * nobody reads the old data from disk in the meantime. */
+	if (dirty)
+		inode_write_at (pc->inode, page->frame->kva, valid_bytes (page),
+				pc->ofs);
+
+	lock_acquire (&page_cache_lock);
+	unlink (page);
+	lock_release (&page_cache_lock);
+
+	inode_close (pc->inode);
+	free (page);
+	return true;
 }
 
 /* Destory the page_cache. */
 static void
 page_cache_destroy (struct page *page) {
-}
-
-/* Worker thread for page cache */
-static void
-page_cache_kworkerd (void *aux) {
+	inode_close (page->page_cache.inode);
+	vm_frame_free (page->frame);
 }
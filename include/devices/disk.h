@@ -2,7 +2,11 @@
 #define DEVICES_DISK_H
 
 #include <inttypes.h>
+#include <list.h>
+#include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
+#include "threads/synch.h"
 
 /* Size of a disk sector in bytes. */
 #define DISK_SECTOR_SIZE 512
@@ -15,13 +19,84 @@ typedef uint32_t disk_sector_t;
  * printf ("sector=%"PRDSNu"\n", sector); */
 #define PRDSNu PRIu32
 
+/* Who a disk request is for, in the statistics. */
+enum disk_user {
+	DISK_USER_OTHER,            /* Anything else, e.g. the scratch disk. */
+	DISK_USER_FS,               /* File system data and metadata. */
+	DISK_USER_SWAP,             /* Swap. */
+	DISK_USER_FAT,              /* File allocation table. */
+	DISK_USER_CNT
+};
+
+/* Number of latency histogram buckets.  Bucket 0 counts requests
+ * done within the tick they were submitted in, bucket B > 0 those
+ * that took 2**(B - 1) to 2**B - 1 ticks, and the last bucket also
+ * counts anything slower. */
+#define DISK_LATENCY_BUCKETS 16
+
+/* Statistics of one disk, as returned by disk_get_stats().
+ * Must match struct disk_stats in lib/user/syscall.h. */
+struct disk_stats {
+	long long read_cnt;         /* Sectors read. */
+	long long write_cnt;        /* Sectors written. */
+	long long request_cnt;      /* Requests done. */
+	int in_flight;              /* Requests queued or in progress now. */
+	int max_in_flight;          /* Most requests ever in flight at once. */
+	long long in_flight_bytes;  /* Bytes of the requests in flight. */
+	long long depth_sum;        /* Sum of the requests in flight, each
+								 * counted as a request was submitted. */
+	long long latency[DISK_LATENCY_BUCKETS];    /* Requests done by
+												 * ticks taken. */
+	long long user_requests[DISK_USER_CNT];     /* Requests by user. */
+	long long user_bytes[DISK_USER_CNT];        /* Bytes moved by user. */
+	long long user_ticks[DISK_USER_CNT];        /* Ticks spent by user. */
+};
+
+struct disk_request;
+
+/* Called when a disk request is done, from the disk interrupt
+ * handler. */
+typedef void disk_request_func (struct disk_request *, void *aux);
+
+/* A request to read or write a run of sectors, queued with
+ * disk_submit() and served asynchronously.  Adjacent requests may
+ * be served by a single disk command. */
+struct disk_request {
+	struct disk *disk;          /* Disk to access. */
+	disk_sector_t sector;       /* First sector. */
+	void *buffer;               /* Data, in kernel memory. */
+	size_t cnt;                 /* Number of sectors. */
+	bool write;                 /* Write, as opposed to read? */
+	disk_request_func *complete;    /* Called when done, or null. */
+	void *aux;                  /* Passed to COMPLETE. */
+	enum disk_user user;        /* Who to count the request for. */
+
+	/* Owned by the disk driver. */
+	struct list_elem elem;      /* Element in the channel's queue. */
+	struct disk_request *next;  /* Next request in the same command. */
+	size_t done_cnt;            /* Sectors transferred so far. */
+	int64_t submitted;          /* Tick it was submitted in. */
+	int64_t deadline;           /* Tick by which to serve it. */
+	struct semaphore finished;  /* Up'd when done. */
+};
+
 void disk_init (void);
 void disk_print_stats (void);
+void disk_get_stats (struct disk *, struct disk_stats *);
 
 struct disk *disk_get (int chan_no, int dev_no);
 disk_sector_t disk_size (struct disk *);
+void disk_set_user (struct disk *, enum disk_user);
 void disk_read (struct disk *, disk_sector_t, void *);
 void disk_write (struct disk *, disk_sector_t, const void *);
+void disk_read_multiple (struct disk *, disk_sector_t, void *, size_t cnt);
+void disk_write_multiple (struct disk *, disk_sector_t, const void *,
+		size_t cnt);
+
+void disk_request_init (struct disk_request *, struct disk *, disk_sector_t,
+		void *, size_t cnt, bool write);
+void disk_submit (struct disk_request *, disk_request_func *, void *aux);
+void disk_wait (struct disk_request *);
 
 void 	register_disk_inspect_intr ();
 #endif /* devices/disk.h */
@@ -1,7 +1,9 @@
 #ifndef DEVICES_TIMER_H
 #define DEVICES_TIMER_H
 
+#include <list.h>
 #include <round.h>
+#include <stdbool.h>
 #include <stdint.h>
 
 /* Number of timer interrupts per second. */
@@ -13,11 +15,35 @@ void timer_calibrate (void);
 int64_t timer_ticks (void);
 int64_t timer_elapsed (int64_t);
 
+uint64_t timer_tsc_freq (void);
+int64_t timer_ns (void);
+int64_t timer_tsc_to_ns (uint64_t cycles);
+
 void timer_sleep (int64_t ticks);
 void timer_msleep (int64_t milliseconds);
 void timer_usleep (int64_t microseconds);
 void timer_nsleep (int64_t nanoseconds);
 
+/* A timeout: calls FUNC (AUX) from the timer interrupt once it
+   expires.  Used for sleeping threads and kernel timeouts. */
+typedef void timeout_func (void *aux);
+struct timeout {
+	struct list_elem elem;      /* Element in a timer wheel slot. */
+	int64_t tick;               /* Tick it expires in. */
+	uint64_t tsc;               /* TSC value it expires at, or 0. */
+	timeout_func *func;         /* Called on expiry. */
+	void *aux;                  /* Passed to FUNC. */
+	bool pending;               /* Added but not yet expired or canceled? */
+};
+
+void timeout_init (struct timeout *, timeout_func *, void *aux);
+void timeout_add (struct timeout *, int64_t tick);
+void timeout_add_ns (struct timeout *, int64_t ns);
+bool timeout_cancel (struct timeout *);
+
+void timer_idle_enter (void);
+void timer_idle_exit (void);
+
 void timer_print_stats (void);
 
 #endif /* devices/timer.h */
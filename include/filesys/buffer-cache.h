@@ -0,0 +1,15 @@
+#ifndef FILESYS_BUFFER_CACHE_H
+#define FILESYS_BUFFER_CACHE_H
+
+#include <stddef.h>
+#include "devices/disk.h"
+
+void buffer_cache_init (void);
+void buffer_cache_read (disk_sector_t, void *, int ofs, int size);
+void buffer_cache_write (disk_sector_t, const void *, int ofs, int size);
+void buffer_cache_write_meta (disk_sector_t, const void *, int ofs, int size);
+void buffer_cache_read_multiple (disk_sector_t, void *, size_t cnt);
+void buffer_cache_write_multiple (disk_sector_t, const void *, size_t cnt);
+void buffer_cache_flush (void);
+
+#endif /* filesys/buffer-cache.h */
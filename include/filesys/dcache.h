@@ -0,0 +1,30 @@
+#ifndef FILESYS_DCACHE_H
+#define FILESYS_DCACHE_H
+
+#include <stdbool.h>
+#include "devices/disk.h"
+
+/* Directory entry cache.
+ *
+ * Remembers, for recently resolved path components, which inode
+ * sector the name NAME in the directory whose inode is in sector
+ * PARENT refers to, so that resolving the same path again does
+ * not read the directories along the way.  Names that were looked
+ * up and not found are cached too, as negative entries, and so are
+ * the targets of symbolic links that were followed. */
+
+struct inode;
+
+void dcache_init (void);
+bool dcache_lookup (disk_sector_t parent, const char *name,
+		struct inode **inode, int *type);
+void dcache_insert (disk_sector_t parent, const char *name,
+		disk_sector_t sector, int type);
+char *dcache_get_link (disk_sector_t parent, const char *name,
+		disk_sector_t sector);
+void dcache_set_link (disk_sector_t parent, const char *name,
+		disk_sector_t sector, const char *target);
+void dcache_remove (disk_sector_t parent, const char *name);
+void dcache_purge (disk_sector_t parent);
+
+#endif /* filesys/dcache.h */
@@ -4,6 +4,7 @@
 #include <stdbool.h>
 #include <stddef.h>
 #include "devices/disk.h"
+#include "filesys/off_t.h"
 
 /* Maximum length of a file name component.
  * This is the traditional UNIX maximum length.
@@ -11,10 +12,25 @@
  * retained, but much longer full path names must be allowed. */
 #define NAME_MAX 14
 
+/* Types of file that a directory entry can name. */
+#define DT_REG 1                    /* Regular file. */
+#define DT_DIR 2                    /* Directory. */
+#define DT_LNK 3                    /* Symbolic link. */
+
+/* A directory entry as dir_read_entries() returns it.
+ * Must match struct dirent in lib/user/syscall.h. */
+struct dirent {
+	int d_ino;                      /* Inode number. */
+	unsigned char d_type;           /* DT_REG, DT_DIR or DT_LNK. */
+	char d_name[NAME_MAX + 1];      /* Null terminated file name. */
+};
+
 struct inode;
 
+void dir_init (void);
+
 /* Opening and closing directories. */
-bool dir_create (disk_sector_t sector, size_t entry_cnt);
+bool dir_create (disk_sector_t sector, size_t entry_cnt, disk_sector_t parent);
 struct dir *dir_open (struct inode *);
 struct dir *dir_open_root (void);
 struct dir *dir_reopen (struct dir *);
@@ -23,8 +39,11 @@ struct inode *dir_get_inode (struct dir *);
 
 /* Reading and writing. */
 bool dir_lookup (const struct dir *, const char *name, struct inode **);
-bool dir_add (struct dir *, const char *name, disk_sector_t);
+bool dir_add (struct dir *, const char *name, disk_sector_t, int type);
 bool dir_remove (struct dir *, const char *name);
 bool dir_readdir (struct dir *, char name[NAME_MAX + 1]);
+int dir_read_entries (struct dir *, struct dirent *, size_t cnt);
+void dir_seek (struct dir *, off_t);
+off_t dir_tell (struct dir *);
 
 #endif /* filesys/directory.h */
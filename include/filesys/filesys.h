@@ -16,5 +16,9 @@ void filesys_done (void);
 bool filesys_create (const char *name, off_t initial_size);
 struct file *filesys_open (const char *name);
 bool filesys_remove (const char *name);
+bool filesys_mkdir (const char *name);
+bool filesys_chdir (const char *name);
+bool filesys_symlink (const char *target, const char *name);
+bool filesys_link (const char *old, const char *name);
 
 #endif /* filesys/filesys.h */
@@ -8,16 +8,27 @@
 struct bitmap;
 
 void inode_init (void);
-bool inode_create (disk_sector_t, off_t);
+bool inode_create (disk_sector_t, off_t, bool is_dir);
+bool inode_create_symlink (disk_sector_t, const char *target);
 struct inode *inode_open (disk_sector_t);
+struct inode *inode_get (disk_sector_t);
+struct inode *inode_load (struct inode *);
 struct inode *inode_reopen (struct inode *);
 disk_sector_t inode_get_inumber (const struct inode *);
 void inode_close (struct inode *);
 void inode_remove (struct inode *);
+bool inode_is_removed (const struct inode *);
+bool inode_link (struct inode *);
+void inode_unlink (struct inode *);
+bool inode_is_dir (const struct inode *);
+bool inode_is_symlink (const struct inode *);
+char *inode_read_link (struct inode *);
 off_t inode_read_at (struct inode *, void *, off_t size, off_t offset);
 off_t inode_write_at (struct inode *, const void *, off_t size, off_t offset);
+bool inode_preallocate (struct inode *, off_t offset, off_t len);
 void inode_deny_write (struct inode *);
 void inode_allow_write (struct inode *);
 off_t inode_length (const struct inode *);
+void inode_flush (void);
 
 #endif /* filesys/inode.h */
@@ -0,0 +1,40 @@
+#ifndef FILESYS_JOURNAL_H
+#define FILESYS_JOURNAL_H
+
+#include <stdbool.h>
+#include "devices/disk.h"
+
+/* Metadata journal.
+ *
+ * Every write of a metadata sector (inodes, index sectors,
+ * directory contents and the free map) is recorded in the running
+ * transaction.  Operations that must reach the disk all or not at
+ * all are bracketed by journal_begin() and journal_end().  Once no
+ * operation is in progress and enough has changed, the transaction
+ * is written to a log at the end of the disk in one go, and only
+ * then may the sectors it changed be written in place.  After a
+ * crash, journal_init() replays the last logged transactions,
+ * except for sectors revoked because they came to hold file data. */
+
+/* Number of sectors at the end of the file system disk that hold
+ * the journal. */
+#define JOURNAL_SECTORS 256
+
+/* Most sectors one operation, with the operations nested in it,
+ * may change. */
+#define JOURNAL_OP_SECTORS 24
+
+void journal_init (bool format);
+void journal_begin (void);
+void journal_end (void);
+void journal_commit (void);
+void journal_done (void);
+
+/* Called by the buffer cache. */
+void journal_log (disk_sector_t, const void *);
+bool journal_read (disk_sector_t, void *);
+bool journal_may_write_back (disk_sector_t);
+void journal_written_back (disk_sector_t);
+void journal_forget (disk_sector_t);
+
+#endif /* filesys/journal.h */
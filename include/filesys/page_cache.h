@@ -1,12 +1,38 @@
 #ifndef FILESYS_PAGE_CACHE_H
 #define FILESYS_PAGE_CACHE_H
-#include "vm/vm.h"
+#include <hash.h>
+#include <list.h>
+#include "filesys/off_t.h"
 
 struct page;
+struct inode;
 enum vm_type;
 
-struct page_cache {};
+/* A page of file data in the page cache.
+ *
+ * Each page-sized, page-aligned piece of a regular file is cached
+ * at most once, in a frame of the VM frame table, and both
+ * file_read()/file_write() and mmap'd pages of the file use that
+ * frame.  The VM eviction engine reclaims it like any other frame. */
+struct page_cache {
+	struct inode *inode;        /* Cached file, reference held. */
+	off_t ofs;                  /* Page-aligned offset within it. */
+	struct hash_elem hash_elem; /* Element in the page cache table. */
+	struct list_elem list_elem; /* Element in the list of all pages. */
+	struct list mappings;       /* User pages that map the frame. */
+	int pin_cnt;                /* Threads copying data in or out. */
+	bool loaded;                /* Does the frame hold the data yet? */
+	bool evicting;              /* Being evicted? */
+	bool accessed;              /* Used since the clock hand passed? */
+};
 
 void page_cache_init (void);
 bool page_cache_initializer (struct page *page, enum vm_type type, void *kva);
+off_t page_cache_read (struct inode *, void *, off_t size, off_t offset);
+off_t page_cache_write (struct inode *, const void *, off_t size,
+		off_t offset);
+bool page_cache_map (struct page *page, struct inode *, off_t offset);
+void page_cache_unmap (struct page *page);
+bool page_cache_select (struct page *page);
+void page_cache_drop (struct inode *);
 #endif
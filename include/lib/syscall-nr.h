@@ -29,13 +29,25 @@ enum {
 	SYS_READDIR,                /* Reads a directory entry. */
 	SYS_ISDIR,                  /* Tests if a fd represents a directory. */
 	SYS_INUMBER,                /* Returns the inode number for a fd. */
-	SYS_SYMLINK,                /* Returns the inode number for a fd. */
+	SYS_SYMLINK,                /* Creates a symbolic link. */
 
 	/* Extra for Project 2 */
 	SYS_DUP2,                   /* Duplicate the file descriptor */
 
 	SYS_MOUNT,
 	SYS_UMOUNT,
+
+	/* Positioned and vectored I/O. */
+	SYS_PREAD,                  /* Read from a file at a given offset. */
+	SYS_PWRITE,                 /* Write to a file at a given offset. */
+	SYS_READV,                  /* Read from a file into several buffers. */
+	SYS_WRITEV,                 /* Write to a file from several buffers. */
+	SYS_SENDFILE,               /* Copy data between files in the kernel. */
+	SYS_GETDENTS,               /* Reads several directory entries. */
+	SYS_FALLOCATE,              /* Preallocate space for a file. */
+	SYS_LINK,                   /* Creates a hard link. */
+	SYS_DISK_STATS,             /* Reads the statistics of a disk. */
+	SYS_CLOCK_NS,               /* Reads the high-resolution clock. */
 };
 
 #endif /* lib/syscall-nr.h */
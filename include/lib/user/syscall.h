@@ -13,9 +13,56 @@ typedef int pid_t;
 typedef int off_t;
 #define MAP_FAILED ((void *) NULL)
 
+/* A buffer for readv() and writev(). */
+struct iovec {
+	void *iov_base;             /* Start of the buffer. */
+	size_t iov_len;             /* Its size in bytes. */
+};
+
+/* Most buffers that readv() and writev() accept. */
+#define IOV_MAX 64
+
 /* Maximum characters in a filename written by readdir(). */
 #define READDIR_MAX_LEN 14
 
+/* A directory entry filled in by getdents(). */
+struct dirent {
+	int d_ino;                      /* Inode number. */
+	unsigned char d_type;           /* DT_REG, DT_DIR or DT_LNK. */
+	char d_name[READDIR_MAX_LEN + 1]; /* Null terminated file name. */
+};
+#define DT_REG 1                    /* Regular file. */
+#define DT_DIR 2                    /* Directory. */
+#define DT_LNK 3                    /* Symbolic link. */
+
+/* Who a disk request was for, in struct disk_stats. */
+#define DISK_USER_OTHER 0           /* Anything else. */
+#define DISK_USER_FS 1              /* File system. */
+#define DISK_USER_SWAP 2            /* Swap. */
+#define DISK_USER_FAT 3             /* File allocation table. */
+#define DISK_USER_CNT 4
+
+/* Number of buckets in a disk latency histogram.  Bucket 0 counts
+   requests done within a tick, bucket B > 0 those that took
+   2**(B - 1) to 2**B - 1 ticks, and the last also slower ones. */
+#define DISK_LATENCY_BUCKETS 16
+
+/* Statistics of a disk, filled in by disk_stats(). */
+struct disk_stats {
+	long long read_cnt;             /* Sectors read. */
+	long long write_cnt;            /* Sectors written. */
+	long long request_cnt;          /* Requests done. */
+	int in_flight;                  /* Requests queued or in progress. */
+	int max_in_flight;              /* Most requests in flight at once. */
+	long long in_flight_bytes;      /* Bytes of the requests in flight. */
+	long long depth_sum;            /* Requests in flight, summed over
+	                                   each submission. */
+	long long latency[DISK_LATENCY_BUCKETS]; /* Requests by ticks taken. */
+	long long user_requests[DISK_USER_CNT];  /* Requests by user. */
+	long long user_bytes[DISK_USER_CNT];     /* Bytes moved by user. */
+	long long user_ticks[DISK_USER_CNT];     /* Ticks spent by user. */
+};
+
 /* Typical return values from main() and arguments to exit(). */
 #define EXIT_SUCCESS 0          /* Successful execution. */
 #define EXIT_FAILURE 1          /* Unsuccessful execution. */
@@ -38,6 +85,13 @@ void close (int fd);
 
 int dup2(int oldfd, int newfd);
 
+int pread (int fd, void *buffer, unsigned length, off_t offset);
+int pwrite (int fd, const void *buffer, unsigned length, off_t offset);
+int readv (int fd, const struct iovec *iov, int iovcnt);
+int writev (int fd, const struct iovec *iov, int iovcnt);
+int sendfile (int out_fd, int in_fd, off_t *offset, unsigned count);
+int fallocate (int fd, off_t offset, off_t len);
+
 /* Project 3 and optionally project 4. */
 void *mmap (void *addr, size_t length, int writable, int fd, off_t offset);
 void munmap (void *addr);
@@ -48,7 +102,11 @@ bool mkdir (const char *dir);
 bool readdir (int fd, char name[READDIR_MAX_LEN + 1]);
 bool isdir (int fd);
 int inumber (int fd);
+int getdents (int fd, struct dirent *ents, unsigned cnt);
 int symlink (const char* target, const char* linkpath);
+int link (const char *oldpath, const char *newpath);
+int disk_stats (int chan_no, int dev_no, struct disk_stats *);
+long long clock_ns (void);
 
 static inline void* get_phys_addr (void *user_addr) {
 	void* pa;
@@ -5,6 +5,7 @@
 #include <debug.h>
 #include <list.h>
 #include <stdint.h>
+#include "devices/timer.h"
 #include "threads/interrupt.h"
 #include "threads/synch.h"
 #ifdef VM
@@ -103,7 +104,7 @@ struct thread {
 	char name[16];                      /* Name (for debugging purposes). */
 	int priority;                       /* Priority. */
 	int origin_priority;
-	int wakeup_tick;
+	struct timeout sleep_timeout;       /* Wakes the thread from thread_sleep(). */
 
 	struct lock *wait_on_lock;
 
@@ -139,6 +140,10 @@ struct thread {
 	
     struct file **fdt; /* Array of pointers to struct file */
 	int next_fd;		/* Next available file descriptor */
+#ifdef FILESYS
+	struct dir *cwd;                    /* Working directory, null for root. */
+	int journal_depth;                  /* Journal operations begun. */
+#endif
 
 	/* Owned by thread.c. */
 	struct intr_frame tf;               /* Information for switching */
@@ -184,11 +189,7 @@ int thread_get_load_avg (void);
 void do_iret (struct intr_frame *tf);
 // 실행중인 스레드를 슬립
 void thread_sleep(int64_t ticks);
-// 슬립큐에서 깨워야 할 스레드를 깨움
-void thread_awake(int64_t ticks);
-// 최소 틱을 가진 스레드 저장
-void update_next_tick_to_awake(int64_t ticks);
-// thread.c 의 next_tick_to_awake 반환
-int64_t get_next_tick_to_awake(void);
+// 실행중인 스레드를 timer_ns()가 ns가 될 때까지 슬립
+void thread_sleep_ns(int64_t ns);
 
 #endif /* threads/thread.h */
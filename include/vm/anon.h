@@ -10,6 +10,8 @@ struct anon_page {
     int swap_sector;
 };
 
+extern const char *swap_disk_list;
+
 void vm_anon_init (void);
 bool anon_initializer (struct page *page, enum vm_type type, void *kva);
 
@@ -30,7 +30,7 @@ enum vm_type {
 #include "vm/uninit.h"
 #include "vm/anon.h"
 #include "vm/file.h"
-#ifdef EFILESYS
+#ifdef FILESYS
 #include "filesys/page_cache.h"
 #endif
 
@@ -52,6 +52,7 @@ struct page {
 	/* struct page를 hash table에 넣고 싶다면 struct hash_elem 멤버를 구조체에 포함시켜야 함. */
 	struct hash_elem hash_elem; /* 해쉬 테이블 element */
 	bool writable;
+	struct thread *owner;  /* Process whose page table maps VA. */
 
 	/* Per-type data are binded into the union.
 	 * Each function automatically detects the current union */
@@ -59,7 +60,7 @@ struct page {
 		struct uninit_page uninit;
 		struct anon_page anon;
 		struct file_page file;
-#ifdef EFILESYS
+#ifdef FILESYS
 		struct page_cache page_cache;
 #endif
 	};
@@ -115,6 +116,8 @@ bool vm_alloc_page_with_initializer (enum vm_type type, void *upage,
 		bool writable, vm_initializer *init, void *aux);
 void vm_dealloc_page (struct page *page);
 bool vm_claim_page (void *va);
+struct frame *vm_frame_alloc (struct page *page);
+void vm_frame_free (struct frame *frame);
 enum vm_type page_get_type (struct page *page);
 
 #endif  /* VM_VM_H */
@@ -1,14 +1,17 @@
 #include <console.h>
 #include <stdarg.h>
 #include <stdio.h>
+#include <string.h>
 #include "devices/serial.h"
 #include "devices/vga.h"
 #include "threads/init.h"
 #include "threads/interrupt.h"
 #include "threads/synch.h"
+#include "threads/vaddr.h"
 
 static void vprintf_helper (char, void *);
 static void putchar_have_lock (uint8_t c);
+static void putbuf_have_lock (const char *, size_t);
 
 /* The console lock.
    Both the vga and serial layers do their own locking, so it's
@@ -111,18 +114,30 @@ console_locked_by_current_thread (void) {
 			|| lock_held_by_current_thread (&console_lock));
 }
 
+/* Output of a vprintf() call, collected so that it reaches the
+   vga display and serial port in a few pieces rather than one
+   character at a time. */
+struct vprintf_aux {
+	int char_cnt;               /* Characters output so far. */
+	size_t len;                 /* Characters in BUF. */
+	char buf[64];               /* Characters not yet written. */
+};
+
 /* The standard vprintf() function,
    which is like printf() but uses a va_list.
    Writes its output to both vga display and serial port. */
 int
 vprintf (const char *format, va_list args) {
-	int char_cnt = 0;
+	struct vprintf_aux aux;
 
+	aux.char_cnt = 0;
+	aux.len = 0;
 	acquire_console ();
-	__vprintf (format, args, vprintf_helper, &char_cnt);
+	__vprintf (format, args, vprintf_helper, &aux);
+	putbuf_have_lock (aux.buf, aux.len);
 	release_console ();
 
-	return char_cnt;
+	return aux.char_cnt;
 }
 
 /* Writes string S to the console, followed by a new-line
@@ -130,20 +145,25 @@ vprintf (const char *format, va_list args) {
 int
 puts (const char *s) {
 	acquire_console ();
-	while (*s != '\0')
-		putchar_have_lock (*s++);
+	putbuf_have_lock (s, strlen (s));
 	putchar_have_lock ('\n');
 	release_console ();
 
 	return 0;
 }
 
-/* Writes the N characters in BUFFER to the console. */
+/* Writes the N characters in BUFFER to the console.  Returns once
+   they are queued for the serial port, which sends them from its
+   interrupt handler, so a process writing a lot of output waits
+   only when the queue is full.  BUFFER must be in kernel memory,
+   since the drivers read it with interrupts off, where a page
+   fault must not happen. */
 void
 putbuf (const char *buffer, size_t n) {
+	ASSERT (is_kernel_vaddr (buffer));
+
 	acquire_console ();
-	while (n-- > 0)
-		putchar_have_lock (*buffer++);
+	putbuf_have_lock (buffer, n);
 	release_console ();
 }
 
@@ -159,10 +179,15 @@ putchar (int c) {
 
 /* Helper function for vprintf(). */
 static void
-vprintf_helper (char c, void *char_cnt_) {
-	int *char_cnt = char_cnt_;
-	(*char_cnt)++;
-	putchar_have_lock (c);
+vprintf_helper (char c, void *aux_) {
+	struct vprintf_aux *aux = aux_;
+
+	aux->char_cnt++;
+	aux->buf[aux->len++] = c;
+	if (aux->len >= sizeof aux->buf) {
+		putbuf_have_lock (aux->buf, aux->len);
+		aux->len = 0;
+	}
 }
 
 /* Writes C to the vga display and serial port.
@@ -175,3 +200,14 @@ putchar_have_lock (uint8_t c) {
 	serial_putc (c);
 	vga_putc (c);
 }
+
+/* Writes the N characters in BUFFER to the vga display and serial
+   port, each in one batch.  The caller has already acquired the
+   console lock if appropriate. */
+static void
+putbuf_have_lock (const char *buffer, size_t n) {
+	ASSERT (console_locked_by_current_thread ());
+	write_cnt += n;
+	serial_putbuf (buffer, n);
+	vga_putbuf (buffer, n);
+}
@@ -54,7 +54,7 @@ static __inline int64_t syscall (uint64_t num_, uint64_t a1_, uint64_t a2_,
 			((uint64_t) ARG2), 0, 0, 0))
 
 #define syscall4(NUMBER, ARG0, ARG1, ARG2, ARG3) ( \
-		syscall(((uint64_t *) NUMBER), \
+		syscall(((uint64_t) NUMBER), \
 			((uint64_t) ARG0), \
 			((uint64_t) ARG1), \
 			((uint64_t) ARG2), \
@@ -145,6 +145,36 @@ dup2 (int oldfd, int newfd){
 	return syscall2 (SYS_DUP2, oldfd, newfd);
 }
 
+int
+pread (int fd, void *buffer, unsigned size, off_t offset) {
+	return syscall4 (SYS_PREAD, fd, buffer, size, offset);
+}
+
+int
+pwrite (int fd, const void *buffer, unsigned size, off_t offset) {
+	return syscall4 (SYS_PWRITE, fd, buffer, size, offset);
+}
+
+int
+readv (int fd, const struct iovec *iov, int iovcnt) {
+	return syscall3 (SYS_READV, fd, iov, iovcnt);
+}
+
+int
+writev (int fd, const struct iovec *iov, int iovcnt) {
+	return syscall3 (SYS_WRITEV, fd, iov, iovcnt);
+}
+
+int
+sendfile (int out_fd, int in_fd, off_t *offset, unsigned count) {
+	return syscall4 (SYS_SENDFILE, out_fd, in_fd, offset, count);
+}
+
+int
+fallocate (int fd, off_t offset, off_t len) {
+	return syscall3 (SYS_FALLOCATE, fd, offset, len);
+}
+
 void *
 mmap (void *addr, size_t length, int writable, int fd, off_t offset) {
 	return (void *) syscall5 (SYS_MMAP, addr, length, writable, fd, offset);
@@ -180,11 +210,31 @@ inumber (int fd) {
 	return syscall1 (SYS_INUMBER, fd);
 }
 
+int
+getdents (int fd, struct dirent *ents, unsigned cnt) {
+	return syscall3 (SYS_GETDENTS, fd, ents, cnt);
+}
+
 int
 symlink (const char* target, const char* linkpath) {
 	return syscall2 (SYS_SYMLINK, target, linkpath);
 }
 
+int
+link (const char *oldpath, const char *newpath) {
+	return syscall2 (SYS_LINK, oldpath, newpath);
+}
+
+long long
+clock_ns (void) {
+	return syscall0 (SYS_CLOCK_NS);
+}
+
+int
+disk_stats (int chan_no, int dev_no, struct disk_stats *stats) {
+	return syscall3 (SYS_DISK_STATS, chan_no, dev_no, stats);
+}
+
 int
 mount (const char *path, int chan_no, int dev_no) {
 	return syscall3 (SYS_MOUNT, path, chan_no, dev_no);
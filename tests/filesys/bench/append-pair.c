@@ -0,0 +1,63 @@
+/* Appends to two files in turn, a block at a time, then reads
+   each back in order.  Delayed allocation places each file's
+   blocks in one run even though the appends interleave, which
+   shows up in the seek count that the kernel prints on
+   shutdown. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define BLOCK_SIZE 512
+#define BLOCK_CNT 128
+
+static char buf[BLOCK_SIZE];
+
+static void
+check_contents (const char *name, int fd, char c) 
+{
+  int i, j;
+
+  seek (fd, 0);
+  for (i = 0; i < BLOCK_CNT; i++)
+    {
+      if (read (fd, buf, BLOCK_SIZE) != BLOCK_SIZE)
+        fail ("read block %d of \"%s\"", i, name);
+      for (j = 0; j < BLOCK_SIZE; j++)
+        if (buf[j] != c)
+          fail ("byte %d of block %d of \"%s\" is %02hhx, not %02hhx",
+                j, i, name, buf[j], c);
+    }
+}
+
+void
+test_main (void) 
+{
+  long long reads, writes;
+  int fd[2];
+  int i, f;
+
+  CHECK (create ("a", 0), "create \"a\"");
+  CHECK (create ("b", 0), "create \"b\"");
+  CHECK ((fd[0] = open ("a")) > 1, "open \"a\"");
+  CHECK ((fd[1] = open ("b")) > 1, "open \"b\"");
+
+  writes = get_fs_disk_write_cnt ();
+  for (i = 0; i < BLOCK_CNT; i++)
+    for (f = 0; f < 2; f++)
+      {
+        memset (buf, 'a' + f, BLOCK_SIZE);
+        if (write (fd[f], buf, BLOCK_SIZE) != BLOCK_SIZE)
+          fail ("write block %d of \"%c\"", i, 'a' + f);
+      }
+  msg ("append: %lld disk writes", get_fs_disk_write_cnt () - writes);
+
+  reads = get_fs_disk_read_cnt ();
+  check_contents ("a", fd[0], 'a');
+  check_contents ("b", fd[1], 'b');
+  msg ("read back: %lld disk reads", get_fs_disk_read_cnt () - reads);
+
+  close (fd[0]);
+  close (fd[1]);
+}
@@ -0,0 +1,30 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+# Benchmarks report numbers that vary from run to run, so their
+# output cannot be compared line by line.  Instead, check that the
+# run began, finished, and did not fail along the way, and that
+# every line reporting operations also reports the time they took,
+# which is what summarize divides by.
+sub check_bench {
+    our ($test);
+    my ($name) = $test =~ m%([^/]+)$%;
+    my (@output) = read_text_file ("$test.output");
+
+    common_checks ("run", @output);
+    @output = get_core_output ("run", @output);
+    @output = grep (!/^[a-zA-Z0-9-_]+: exit\(\-?\d+\)$/, @output);
+    fail "First line of output is not `($name) begin' message.\n"
+      if $output[0] ne "($name) begin";
+    fail "Last line of output is not `($name) end' message.\n"
+      if $output[$#output] ne "($name) end";
+    foreach (grep (/\d+ ops\b/, @output)) {
+	fail "Operations reported without their time: $_\n"
+	  if !/\d+ ops in \d+ ns\b/;
+    }
+    pass;
+}
+
+1;
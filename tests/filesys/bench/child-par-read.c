@@ -0,0 +1,46 @@
+/* Child process for the par-read benchmarks.
+   Reads file "par<N>", where N is its argument, READ_CNT times
+   from start to end and checks every byte. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/filesys/bench/par-read.h"
+
+const char *test_name = "child-par-read";
+
+static char buf[CHUNK_SIZE];
+
+int
+main (int argc, const char *argv[]) 
+{
+  char name[16];
+  int child_idx;
+  int fd, i;
+
+  quiet = true;
+
+  CHECK (argc == 2, "argc must be 2, actually %d", argc);
+  child_idx = atoi (argv[1]);
+  snprintf (name, sizeof name, "par%d", child_idx);
+
+  CHECK ((fd = open (name)) > 1, "open \"%s\"", name);
+  for (i = 0; i < READ_CNT; i++)
+    {
+      size_t ofs, j;
+
+      seek (fd, 0);
+      for (ofs = 0; ofs < FILE_SIZE; ofs += CHUNK_SIZE)
+        {
+          CHECK (read (fd, buf, CHUNK_SIZE) == CHUNK_SIZE,
+                 "read \"%s\"", name);
+          for (j = 0; j < CHUNK_SIZE; j++)
+            if (buf[j] != 0x5a)
+              fail ("byte %zu of \"%s\" is wrong", ofs + j, name);
+        }
+    }
+  close (fd);
+
+  return child_idx;
+}
@@ -0,0 +1,27 @@
+/* Reads the nanosecond clock many times in a row, checking that it
+   never runs backward, and reports how long each read took.  Each
+   read is one operation. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define READ_CNT 100000
+
+void
+test_main (void) 
+{
+  long long start, prev, now;
+  int i;
+
+  start = prev = clock_ns ();
+  for (i = 0; i < READ_CNT; i++)
+    {
+      now = clock_ns ();
+      if (now < prev)
+        fail ("clock ran backward from %lld to %lld ns", prev, now);
+      prev = now;
+    }
+  msg ("clock read: %d ops in %lld ns", READ_CNT, prev - start);
+  msg ("%lld ns per read", (prev - start) / READ_CNT);
+}
@@ -0,0 +1,30 @@
+/* Prints 1 MB to the console in 1 kB writes, 16 lines of 64
+   characters each.  Each write is one operation. */
+
+#include <stdio.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define OUTPUT_SIZE (1024 * 1024)
+#define BLOCK_SIZE 1024
+#define BLOCK_CNT (OUTPUT_SIZE / BLOCK_SIZE)
+#define LINE_SIZE 64
+
+static char buf[BLOCK_SIZE];
+
+void
+test_main (void) 
+{
+  long long start;
+  int i;
+
+  for (i = 0; i < BLOCK_SIZE; i++)
+    buf[i] = i % LINE_SIZE == LINE_SIZE - 1 ? '\n' : 'a' + i % 26;
+
+  start = clock_ns ();
+  for (i = 0; i < BLOCK_CNT; i++)
+    if (write (STDOUT_FILENO, buf, BLOCK_SIZE) != BLOCK_SIZE)
+      fail ("write %d", i);
+  msg ("console write: %d ops in %lld ns", BLOCK_CNT, clock_ns () - start);
+}
@@ -0,0 +1,52 @@
+/* Creates a file 8 MB long, reads a little from its start and end,
+   and writes a byte in the middle.  A new file is one big hole, so
+   creating it writes nothing but its inode and directory entry, and
+   only the sector written in the middle is allocated.  The test
+   reports how many disk writes each step made. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define FILE_SIZE (8 * 1024 * 1024)
+
+static void
+check_zeros (int fd, int ofs) 
+{
+  char buf[512];
+  size_t i;
+
+  seek (fd, ofs);
+  CHECK (read (fd, buf, sizeof buf) == sizeof buf, "read at %d", ofs);
+  for (i = 0; i < sizeof buf; i++)
+    if (buf[i] != 0)
+      fail ("byte %zu at offset %d is %02hhx, not 0", i, ofs, buf[i]);
+}
+
+void
+test_main (void) 
+{
+  long long writes;
+  char c = 'x';
+  int fd;
+
+  writes = get_fs_disk_write_cnt ();
+  CHECK (create ("sparse", FILE_SIZE), "create \"sparse\"");
+  CHECK ((fd = open ("sparse")) > 1, "open \"sparse\"");
+  CHECK (filesize (fd) == FILE_SIZE, "filesize is %d", FILE_SIZE);
+  msg ("create: %lld disk writes", get_fs_disk_write_cnt () - writes);
+
+  check_zeros (fd, 0);
+  check_zeros (fd, FILE_SIZE - 512);
+
+  writes = get_fs_disk_write_cnt ();
+  seek (fd, FILE_SIZE / 2);
+  CHECK (write (fd, &c, 1) == 1, "write 1 byte at %d", FILE_SIZE / 2);
+  seek (fd, FILE_SIZE / 2);
+  c = 0;
+  CHECK (read (fd, &c, 1) == 1 && c == 'x', "read it back");
+  msg ("write: %lld disk writes", get_fs_disk_write_cnt () - writes);
+
+  close (fd);
+  CHECK (remove ("sparse"), "remove \"sparse\"");
+}
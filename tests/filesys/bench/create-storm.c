@@ -0,0 +1,45 @@
+/* Creates and removes many small files in a directory, and
+   reports how many disk writes that took.  Metadata changes are
+   committed to the journal in groups, so the number of writes
+   should grow much more slowly than the number of files. */
+
+#include <stdio.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define FILE_CNT 100
+
+void
+test_main (void) 
+{
+  char name[32];
+  long long writes, start;
+  int i;
+
+  CHECK (mkdir ("storm"), "mkdir \"storm\"");
+
+  writes = get_fs_disk_write_cnt ();
+  start = clock_ns ();
+  for (i = 0; i < FILE_CNT; i++)
+    {
+      snprintf (name, sizeof name, "storm/f%d", i);
+      if (!create (name, 512))
+        fail ("create \"%s\"", name);
+    }
+  msg ("create: %d ops in %lld ns, %lld disk writes", FILE_CNT,
+       clock_ns () - start, get_fs_disk_write_cnt () - writes);
+
+  writes = get_fs_disk_write_cnt ();
+  start = clock_ns ();
+  for (i = 0; i < FILE_CNT; i++)
+    {
+      snprintf (name, sizeof name, "storm/f%d", i);
+      if (!remove (name))
+        fail ("remove \"%s\"", name);
+    }
+  msg ("remove: %d ops in %lld ns, %lld disk writes", FILE_CNT,
+       clock_ns () - start, get_fs_disk_write_cnt () - writes);
+
+  CHECK (remove ("storm"), "remove \"storm\"");
+}
@@ -0,0 +1,46 @@
+/* Builds a chain of 8 nested directories with a file at the
+   bottom, then opens the file by its full path 1,000 times and
+   reports the disk traffic.  The file is kept open throughout, so
+   its inode stays in memory and the reported traffic is that of
+   resolving the path; with the directory entry cache, repeated
+   resolution does not read the disk at all. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define DEPTH 8
+#define OPEN_CNT 1000
+
+void
+test_main (void) 
+{
+  char path[DEPTH * 3 + 8] = "";
+  long long reads, writes;
+  int fd, i;
+
+  for (i = 0; i < DEPTH; i++)
+    {
+      char part[4] = { '/', 'd', '0' + i, '\0' };
+      strlcat (path, part, sizeof path);
+      CHECK (mkdir (path), "mkdir \"%s\"", path);
+    }
+  strlcat (path, "/file", sizeof path);
+  CHECK (create (path, 512), "create \"%s\"", path);
+  CHECK ((fd = open (path)) > 1, "open \"%s\"", path);
+
+  reads = get_fs_disk_read_cnt ();
+  writes = get_fs_disk_write_cnt ();
+  for (i = 0; i < OPEN_CNT; i++)
+    {
+      int fd2 = open (path);
+      if (fd2 < 2)
+        fail ("open \"%s\" failed", path);
+      close (fd2);
+    }
+  msg ("open \"%s\" %d times: %lld disk reads, %lld disk writes",
+       path, OPEN_CNT, get_fs_disk_read_cnt () - reads,
+       get_fs_disk_write_cnt () - writes);
+  close (fd);
+}
@@ -0,0 +1,51 @@
+/* Creates 5,000 files in the root directory, then opens each of
+   them by name, and reports the disk traffic of each phase.  With
+   an indexed directory, an open costs the read of the file's inode
+   instead of a scan of the directory. */
+
+#include <stdio.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define FILE_CNT 5000
+
+static void
+make_name (char name[16], int i) 
+{
+  snprintf (name, 16, "file%d", i);
+}
+
+void
+test_main (void) 
+{
+  long long reads, writes;
+  char name[16];
+  int i;
+
+  reads = get_fs_disk_read_cnt ();
+  writes = get_fs_disk_write_cnt ();
+  for (i = 0; i < FILE_CNT; i++)
+    {
+      make_name (name, i);
+      if (!create (name, 0))
+        fail ("create \"%s\" failed", name);
+    }
+  msg ("create %d files: %lld disk reads, %lld disk writes", FILE_CNT,
+       get_fs_disk_read_cnt () - reads, get_fs_disk_write_cnt () - writes);
+
+  reads = get_fs_disk_read_cnt ();
+  writes = get_fs_disk_write_cnt ();
+  for (i = 0; i < FILE_CNT; i++)
+    {
+      int fd;
+
+      make_name (name, i);
+      fd = open (name);
+      if (fd < 2)
+        fail ("open \"%s\" failed", name);
+      close (fd);
+    }
+  msg ("open %d files: %lld disk reads, %lld disk writes", FILE_CNT,
+       get_fs_disk_read_cnt () - reads, get_fs_disk_write_cnt () - writes);
+}
@@ -0,0 +1,88 @@
+/* Builds a directory tree DEPTH levels deep, with FANOUT
+   subdirectories and FILE_CNT files in each directory, then walks
+   the whole tree with getdents().  Each entry visited is one
+   operation. */
+
+#include <stdio.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define DEPTH 4
+#define FANOUT 3
+#define FILE_CNT 4
+
+/* Creates the tree below PATH, LEVEL levels from the bottom. */
+static void
+build (const char *path, int level) 
+{
+  char name[128];
+  int i;
+
+  for (i = 0; i < FILE_CNT; i++)
+    {
+      snprintf (name, sizeof name, "%s/f%d", path, i);
+      if (!create (name, 0))
+        fail ("create \"%s\"", name);
+    }
+  if (level == 0)
+    return;
+  for (i = 0; i < FANOUT; i++)
+    {
+      snprintf (name, sizeof name, "%s/d%d", path, i);
+      if (!mkdir (name))
+        fail ("mkdir \"%s\"", name);
+      build (name, level - 1);
+    }
+}
+
+/* Visits every entry below PATH and returns how many there are. */
+static int
+walk (const char *path) 
+{
+  struct dirent ents[16];
+  int cnt = 0;
+  int fd, n, i;
+
+  if ((fd = open (path)) < 2)
+    fail ("open \"%s\"", path);
+  while ((n = getdents (fd, ents, 16)) > 0)
+    for (i = 0; i < n; i++)
+      {
+        cnt++;
+        if (ents[i].d_type == DT_DIR)
+          {
+            char child[128];
+            snprintf (child, sizeof child, "%s/%s", path, ents[i].d_name);
+            cnt += walk (child);
+          }
+      }
+  close (fd);
+  return cnt;
+}
+
+void
+test_main (void) 
+{
+  long long reads, start;
+  int expected = 0;
+  int level_cnt = 1;
+  int cnt, i;
+
+  CHECK (mkdir ("tree"), "mkdir \"tree\"");
+  build ("tree", DEPTH);
+  for (i = 0; i <= DEPTH; i++)
+    {
+      expected += level_cnt * (FILE_CNT + (i < DEPTH ? FANOUT : 0));
+      level_cnt *= FANOUT;
+    }
+
+  reads = get_fs_disk_read_cnt ();
+  start = clock_ns ();
+  cnt = walk ("tree");
+  msg ("directory walk: %d ops in %lld ns, %lld disk reads", cnt,
+       clock_ns () - start, get_fs_disk_read_cnt () - reads);
+  if (cnt != expected)
+    fail ("walk found %d entries, expected %d", cnt, expected);
+}
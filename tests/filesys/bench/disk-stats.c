@@ -0,0 +1,53 @@
+/* Writes and reads back a 256 kB file, then prints the
+   statistics the file system disk kept meanwhile: requests,
+   queue depth, bytes moved for the file system and the latency
+   histogram.  Each write and each read is one operation. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define FILE_SIZE (256 * 1024)
+#define BLOCK_SIZE 4096
+#define BLOCK_CNT (FILE_SIZE / BLOCK_SIZE)
+
+static char buf[BLOCK_SIZE];
+
+void
+test_main (void) 
+{
+  struct disk_stats before, after;
+  long long start, elapsed;
+  int fd, i;
+
+  CHECK (disk_stats (0, 1, &before) == 0, "disk_stats hd0:1");
+  CHECK (create ("stats", 0), "create \"stats\"");
+  CHECK ((fd = open ("stats")) > 1, "open \"stats\"");
+  start = clock_ns ();
+  for (i = 0; i < BLOCK_CNT; i++)
+    {
+      memset (buf, 'a' + i % 26, BLOCK_SIZE);
+      if (write (fd, buf, BLOCK_SIZE) != BLOCK_SIZE)
+        fail ("write block %d", i);
+    }
+  seek (fd, 0);
+  for (i = 0; i < BLOCK_CNT; i++)
+    if (read (fd, buf, BLOCK_SIZE) != BLOCK_SIZE || buf[0] != 'a' + i % 26)
+      fail ("read block %d", i);
+  elapsed = clock_ns () - start;
+  close (fd);
+  CHECK (disk_stats (0, 1, &after) == 0, "disk_stats hd0:1");
+  msg ("disk stats: %d ops in %lld ns", 2 * BLOCK_CNT, elapsed);
+
+  msg ("%lld requests, %d max in flight, %lld fs bytes",
+       after.request_cnt - before.request_cnt, after.max_in_flight,
+       after.user_bytes[DISK_USER_FS] - before.user_bytes[DISK_USER_FS]);
+  for (i = 0; i < DISK_LATENCY_BUCKETS; i++)
+    if (after.latency[i] != before.latency[i])
+      msg ("latency bucket %d: %lld requests", i,
+           after.latency[i] - before.latency[i]);
+
+  if (disk_stats (0, 2, &after) != -1)
+    fail ("disk_stats accepted device 2");
+}
@@ -0,0 +1,70 @@
+/* Lists a directory of many files twice: once with readdir(),
+   one name per call, and once with getdents(), many entries per
+   call.  Checks that both see every file and reports the calls
+   and CPU cycles each took. */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define FILE_CNT 500
+#define BATCH_CNT 64
+
+static struct dirent ents[BATCH_CNT];
+
+static inline uint64_t
+rdtsc (void) 
+{
+  uint32_t lo, hi;
+  asm volatile ("rdtsc" : "=a" (lo), "=d" (hi));
+  return ((uint64_t) hi << 32) | lo;
+}
+
+void
+test_main (void) 
+{
+  char name[READDIR_MAX_LEN + 1];
+  int calls, found, fd, i, n;
+  uint64_t start;
+
+  CHECK (mkdir ("list"), "mkdir \"list\"");
+  for (i = 0; i < FILE_CNT; i++)
+    {
+      snprintf (name, sizeof name, "list/f%d", i);
+      if (!create (name, 0))
+        fail ("create \"%s\"", name);
+    }
+  CHECK (mkdir ("list/sub"), "mkdir \"list/sub\"");
+
+  CHECK ((fd = open ("list")) > 1, "open \"list\"");
+  calls = found = 0;
+  start = rdtsc ();
+  do
+    calls++;
+  while (readdir (fd, name) && ++found);
+  msg ("readdir: %d entries in %d calls, %d kcycles", found, calls,
+       (int) ((rdtsc () - start) / 1000));
+  if (found != FILE_CNT + 1)
+    fail ("readdir found %d entries, expected %d", found, FILE_CNT + 1);
+  close (fd);
+
+  CHECK ((fd = open ("list")) > 1, "open \"list\"");
+  calls = found = 0;
+  start = rdtsc ();
+  while (calls++, (n = getdents (fd, ents, BATCH_CNT)) > 0)
+    for (i = 0; i < n; i++)
+      {
+        found++;
+        if (ents[i].d_type != (ents[i].d_name[0] == 's' ? DT_DIR : DT_REG))
+          fail ("\"%s\" has type %d", ents[i].d_name, ents[i].d_type);
+      }
+  msg ("getdents: %d entries in %d calls, %d kcycles", found, calls,
+       (int) ((rdtsc () - start) / 1000));
+  if (n < 0)
+    fail ("getdents failed");
+  if (found != FILE_CNT + 1)
+    fail ("getdents found %d entries, expected %d", found, FILE_CNT + 1);
+  close (fd);
+}
@@ -0,0 +1,56 @@
+/* Maps a 64 kB file, touches every page of the mapping, then reads
+   the file back with read() several times.  The reads are served
+   by the pages the mapping brought into memory, so they see the
+   stores made through the mapping and should need next to no disk
+   reads, which the test reports. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define FILE_SIZE (64 * 1024)
+#define PAGE_SIZE 4096
+#define ROUND_CNT 20
+
+static char buf[FILE_SIZE];
+
+void
+test_main (void) 
+{
+  char *actual = (char *) 0x10000000;
+  long long reads;
+  void *map;
+  size_t i;
+  int fd, round;
+
+  for (i = 0; i < sizeof buf; i++)
+    buf[i] = i % 251;
+  CHECK (create ("reread", 0), "create \"reread\"");
+  CHECK ((fd = open ("reread")) > 1, "open \"reread\"");
+  CHECK (write (fd, buf, sizeof buf) == sizeof buf, "write \"reread\"");
+  CHECK ((map = mmap (actual, sizeof buf, 1, fd, 0)) != MAP_FAILED,
+         "mmap \"reread\"");
+
+  if (memcmp (actual, buf, sizeof buf))
+    fail ("read of mmap'd file reported bad data");
+  for (i = 0; i < sizeof buf; i += PAGE_SIZE)
+    actual[i] = 'x';
+  msg ("touched every page of the mapping");
+
+  reads = get_fs_disk_read_cnt ();
+  for (round = 0; round < ROUND_CNT; round++)
+    {
+      seek (fd, 0);
+      if (read (fd, buf, sizeof buf) != sizeof buf)
+        fail ("read \"reread\" failed");
+      for (i = 0; i < sizeof buf; i += PAGE_SIZE)
+        if (buf[i] != 'x')
+          fail ("read() missed store to mapping at byte %zu", i);
+    }
+  msg ("re-read file %d times: %lld disk reads", ROUND_CNT,
+       get_fs_disk_read_cnt () - reads);
+
+  munmap (map);
+  close (fd);
+}
@@ -0,0 +1,62 @@
+/* Opens 1,000 files and keeps them all open, then opens and closes
+   each of them 10 more times.  Every one of those opens has to
+   find the file's inode among the 1,000 already open ones.  Only
+   those opens and closes are timed, so the reported time per
+   open measures the cost of the open-inode table, not of creating
+   the files. */
+
+#include <stdio.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define FILE_CNT 1000
+#define ROUND_CNT 10
+
+static int fds[FILE_CNT];
+
+static void
+make_name (char name[16], int i) 
+{
+  snprintf (name, 16, "open%d", i);
+}
+
+void
+test_main (void) 
+{
+  char name[16];
+  long long start, elapsed;
+  int i, round;
+
+  for (i = 0; i < FILE_CNT; i++)
+    {
+      make_name (name, i);
+      if (!create (name, 0))
+        fail ("create \"%s\" failed", name);
+      fds[i] = open (name);
+      if (fds[i] < 2)
+        fail ("open \"%s\" failed", name);
+    }
+  msg ("opened %d files", FILE_CNT);
+
+  start = clock_ns ();
+  for (round = 0; round < ROUND_CNT; round++)
+    for (i = 0; i < FILE_CNT; i++)
+      {
+        int fd;
+
+        make_name (name, i);
+        fd = open (name);
+        if (fd < 2)
+          fail ("open \"%s\" failed", name);
+        close (fd);
+      }
+  elapsed = clock_ns () - start;
+  msg ("opened and closed each file %d more times: %d ops in %lld ns",
+       ROUND_CNT, FILE_CNT * ROUND_CNT, elapsed);
+  msg ("%lld ns per open and close", elapsed / (FILE_CNT * ROUND_CNT));
+
+  for (i = 0; i < FILE_CNT; i++)
+    close (fds[i]);
+  msg ("closed %d files", FILE_CNT);
+}
@@ -0,0 +1,4 @@
+/* Reads one file with one reader. */
+
+#define CHILD_CNT 1
+#include "tests/filesys/bench/par-read.inc"
@@ -0,0 +1,4 @@
+/* Reads four files with four concurrent readers. */
+
+#define CHILD_CNT 4
+#include "tests/filesys/bench/par-read.inc"
@@ -0,0 +1,11 @@
+#ifndef TESTS_FILESYS_BENCH_PAR_READ_H
+#define TESTS_FILESYS_BENCH_PAR_READ_H
+
+/* Each reader reads its own file of FILE_SIZE bytes, READ_CNT
+   times over, CHUNK_SIZE bytes at a time.  Four such files do not
+   fit in the buffer cache together. */
+#define FILE_SIZE 32768
+#define CHUNK_SIZE 512
+#define READ_CNT 4
+
+#endif /* tests/filesys/bench/par-read.h */
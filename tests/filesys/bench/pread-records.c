@@ -0,0 +1,98 @@
+/* Reads fixed-size records from a file in a scattered order in
+   three ways: seek() followed by read(), pread(), and readv()
+   gathering a run of records into separate buffers.  Reports the
+   CPU cycles each way takes per record. */
+
+#include <stdint.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define RECORD_SIZE 64
+#define RECORD_CNT 512
+#define GATHER_CNT 8
+
+static char records[RECORD_CNT][RECORD_SIZE];
+static char buf[GATHER_CNT][RECORD_SIZE];
+
+static inline uint64_t
+rdtsc (void) 
+{
+  uint32_t lo, hi;
+  asm volatile ("rdtsc" : "=a" (lo), "=d" (hi));
+  return ((uint64_t) hi << 32) | lo;
+}
+
+/* Returns the record read in turn I: a fixed permutation of all
+   of them. */
+static int
+record_at (int i) 
+{
+  return i * 37 % RECORD_CNT;
+}
+
+static void
+check_record (int r, const char *data) 
+{
+  if (memcmp (data, records[r], RECORD_SIZE))
+    fail ("record %d differs", r);
+}
+
+void
+test_main (void) 
+{
+  struct iovec iov[GATHER_CNT];
+  uint64_t start;
+  int fd, i, j;
+
+  for (i = 0; i < RECORD_CNT; i++)
+    memset (records[i], 'a' + i % 26, RECORD_SIZE);
+  CHECK (create ("records", sizeof records), "create \"records\"");
+  CHECK ((fd = open ("records")) > 1, "open \"records\"");
+  CHECK (write (fd, records, sizeof records) == sizeof records,
+         "write \"records\"");
+
+  start = rdtsc ();
+  for (i = 0; i < RECORD_CNT; i++)
+    {
+      int r = record_at (i);
+      seek (fd, r * RECORD_SIZE);
+      if (read (fd, buf[0], RECORD_SIZE) != RECORD_SIZE)
+        fail ("read record %d", r);
+      check_record (r, buf[0]);
+    }
+  msg ("seek+read: %d cycles per record",
+       (int) ((rdtsc () - start) / RECORD_CNT));
+
+  start = rdtsc ();
+  for (i = 0; i < RECORD_CNT; i++)
+    {
+      int r = record_at (i);
+      if (pread (fd, buf[0], RECORD_SIZE, r * RECORD_SIZE) != RECORD_SIZE)
+        fail ("pread record %d", r);
+      check_record (r, buf[0]);
+    }
+  msg ("pread: %d cycles per record",
+       (int) ((rdtsc () - start) / RECORD_CNT));
+
+  for (j = 0; j < GATHER_CNT; j++)
+    {
+      iov[j].iov_base = buf[j];
+      iov[j].iov_len = RECORD_SIZE;
+    }
+  start = rdtsc ();
+  for (i = 0; i < RECORD_CNT; i += GATHER_CNT)
+    {
+      int r = record_at (i / GATHER_CNT) / GATHER_CNT * GATHER_CNT;
+      seek (fd, r * RECORD_SIZE);
+      if (readv (fd, iov, GATHER_CNT) != GATHER_CNT * RECORD_SIZE)
+        fail ("readv records %d...%d", r, r + GATHER_CNT - 1);
+      for (j = 0; j < GATHER_CNT; j++)
+        check_record (r + j, buf[j]);
+    }
+  msg ("seek+readv: %d cycles per record",
+       (int) ((rdtsc () - start) / RECORD_CNT));
+
+  close (fd);
+}
@@ -0,0 +1,10 @@
+/* Random 4 kB reads and writes over a 1 MB file. */
+
+#include "tests/filesys/bench/rand-io.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  rand_io (4096);
+}
@@ -0,0 +1,61 @@
+/* Random I/O of a fixed size over a 1 MB file, shared by rand-512
+   and rand-4k. */
+
+#include "tests/filesys/bench/rand-io.h"
+#include <random.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+
+#define FILE_SIZE (1024 * 1024)
+#define OP_CNT 1024
+
+static char buf[4096];
+
+/* Fills a 1 MB file, then does OP_CNT reads and as many writes of
+   IO_SIZE bytes at random IO_SIZE-aligned offsets, checking that
+   each read sees the last data written there. */
+void
+rand_io (int io_size) 
+{
+  static char tags[FILE_SIZE / 512];
+  int block_cnt = FILE_SIZE / io_size;
+  long long reads, writes, start;
+  int fd, i;
+
+  random_init (io_size);
+  CHECK (create ("rand", 0), "create \"rand\"");
+  CHECK ((fd = open ("rand")) > 1, "open \"rand\"");
+  for (i = 0; i < block_cnt; i++)
+    {
+      tags[i] = 'a' + i % 26;
+      memset (buf, tags[i], io_size);
+      if (write (fd, buf, io_size) != io_size)
+        fail ("fill block %d", i);
+    }
+
+  reads = get_fs_disk_read_cnt ();
+  writes = get_fs_disk_write_cnt ();
+  start = clock_ns ();
+  for (i = 0; i < OP_CNT; i++)
+    {
+      int block = random_ulong () % block_cnt;
+
+      seek (fd, block * io_size);
+      if (read (fd, buf, io_size) != io_size
+          || buf[0] != tags[block] || buf[io_size - 1] != tags[block])
+        fail ("read block %d", block);
+
+      block = random_ulong () % block_cnt;
+      tags[block] = 'A' + random_ulong () % 26;
+      memset (buf, tags[block], io_size);
+      seek (fd, block * io_size);
+      if (write (fd, buf, io_size) != io_size)
+        fail ("write block %d", block);
+    }
+  msg ("random %d-byte I/O: %d ops in %lld ns, %lld disk reads, "
+       "%lld disk writes", io_size, 2 * OP_CNT, clock_ns () - start,
+       get_fs_disk_read_cnt () - reads,
+       get_fs_disk_write_cnt () - writes);
+  close (fd);
+}
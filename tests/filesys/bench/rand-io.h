@@ -0,0 +1,6 @@
+#ifndef TESTS_FILESYS_BENCH_RAND_IO_H
+#define TESTS_FILESYS_BENCH_RAND_IO_H
+
+void rand_io (int io_size);
+
+#endif /* tests/filesys/bench/rand-io.h */
@@ -0,0 +1,101 @@
+/* Copies a 1 MB file twice: once with read() and write() through
+   a user buffer, and once with sendfile(), which moves the data
+   inside the kernel.  Checks both copies and reports the CPU
+   cycles and disk traffic of each. */
+
+#include <stdint.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define FILE_SIZE (1024 * 1024)
+#define CHUNK_SIZE 4096
+
+static char buf[CHUNK_SIZE];
+
+static inline uint64_t
+rdtsc (void) 
+{
+  uint32_t lo, hi;
+  asm volatile ("rdtsc" : "=a" (lo), "=d" (hi));
+  return ((uint64_t) hi << 32) | lo;
+}
+
+static void
+fill_chunk (int i) 
+{
+  memset (buf, 'a' + i % 26, CHUNK_SIZE);
+}
+
+static void
+check_copy (const char *name) 
+{
+  static char expected[CHUNK_SIZE];
+  int fd, i;
+
+  CHECK ((fd = open (name)) > 1, "open \"%s\"", name);
+  CHECK (filesize (fd) == FILE_SIZE, "\"%s\" is %d bytes", name, FILE_SIZE);
+  for (i = 0; i < FILE_SIZE / CHUNK_SIZE; i++)
+    {
+      fill_chunk (i);
+      memcpy (expected, buf, CHUNK_SIZE);
+      if (read (fd, buf, CHUNK_SIZE) != CHUNK_SIZE
+          || memcmp (buf, expected, CHUNK_SIZE))
+        fail ("chunk %d of \"%s\" differs", i, name);
+    }
+  close (fd);
+}
+
+static void
+report (const char *how, uint64_t start, long long reads, long long writes) 
+{
+  msg ("%s: %d kcycles, %lld disk reads, %lld disk writes", how,
+       (int) ((rdtsc () - start) / 1000),
+       get_fs_disk_read_cnt () - reads, get_fs_disk_write_cnt () - writes);
+}
+
+void
+test_main (void) 
+{
+  long long reads, writes;
+  uint64_t start;
+  int src, dst, i, n;
+
+  CHECK (create ("src", 0), "create \"src\"");
+  CHECK ((src = open ("src")) > 1, "open \"src\"");
+  for (i = 0; i < FILE_SIZE / CHUNK_SIZE; i++)
+    {
+      fill_chunk (i);
+      if (write (src, buf, CHUNK_SIZE) != CHUNK_SIZE)
+        fail ("write chunk %d of \"src\"", i);
+    }
+
+  CHECK (create ("copy-rw", 0), "create \"copy-rw\"");
+  CHECK ((dst = open ("copy-rw")) > 1, "open \"copy-rw\"");
+  seek (src, 0);
+  reads = get_fs_disk_read_cnt ();
+  writes = get_fs_disk_write_cnt ();
+  start = rdtsc ();
+  while ((n = read (src, buf, CHUNK_SIZE)) > 0)
+    if (write (dst, buf, n) != n)
+      fail ("write to \"copy-rw\"");
+  report ("read+write", start, reads, writes);
+  close (dst);
+
+  CHECK (create ("copy-sf", 0), "create \"copy-sf\"");
+  CHECK ((dst = open ("copy-sf")) > 1, "open \"copy-sf\"");
+  seek (src, 0);
+  reads = get_fs_disk_read_cnt ();
+  writes = get_fs_disk_write_cnt ();
+  start = rdtsc ();
+  if (sendfile (dst, src, NULL, FILE_SIZE) != FILE_SIZE)
+    fail ("sendfile to \"copy-sf\"");
+  report ("sendfile", start, reads, writes);
+  CHECK (tell (src) == FILE_SIZE, "sendfile advanced \"src\"");
+  close (dst);
+  close (src);
+
+  check_copy ("copy-rw");
+  check_copy ("copy-sf");
+}
@@ -0,0 +1,45 @@
+/* Writes a 1 MB file front to back in 4 kB writes, then reads it
+   back the same way.  Each write and each read is one operation. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define FILE_SIZE (1024 * 1024)
+#define BLOCK_SIZE 4096
+#define BLOCK_CNT (FILE_SIZE / BLOCK_SIZE)
+
+static char buf[BLOCK_SIZE];
+
+void
+test_main (void) 
+{
+  long long reads, writes, start;
+  int fd, i;
+
+  CHECK (create ("seq", 0), "create \"seq\"");
+  CHECK ((fd = open ("seq")) > 1, "open \"seq\"");
+
+  writes = get_fs_disk_write_cnt ();
+  start = clock_ns ();
+  for (i = 0; i < BLOCK_CNT; i++)
+    {
+      memset (buf, 'a' + i % 26, BLOCK_SIZE);
+      if (write (fd, buf, BLOCK_SIZE) != BLOCK_SIZE)
+        fail ("write block %d", i);
+    }
+  msg ("sequential write: %d ops in %lld ns, %lld disk writes", BLOCK_CNT,
+       clock_ns () - start, get_fs_disk_write_cnt () - writes);
+
+  seek (fd, 0);
+  reads = get_fs_disk_read_cnt ();
+  start = clock_ns ();
+  for (i = 0; i < BLOCK_CNT; i++)
+    if (read (fd, buf, BLOCK_SIZE) != BLOCK_SIZE
+        || buf[0] != 'a' + i % 26 || buf[BLOCK_SIZE - 1] != 'a' + i % 26)
+      fail ("read block %d", i);
+  msg ("sequential read: %d ops in %lld ns, %lld disk reads", BLOCK_CNT,
+       clock_ns () - start, get_fs_disk_read_cnt () - reads);
+  close (fd);
+}
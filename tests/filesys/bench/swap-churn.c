@@ -0,0 +1,37 @@
+/* Dirties 16 MB of anonymous memory, much more than the machine
+   has, then reads it all back, twice, so that pages keep moving
+   between memory and the swap disk.  Each page touched is one
+   operation.  The idle ticks printed at power off show how much
+   of the run the CPU spent waiting for the disk. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+#define CHUNK_SIZE (16 * 1024 * 1024)
+#define PAGE_CNT (CHUNK_SIZE / PAGE_SIZE)
+#define PASS_CNT 2
+
+static char big_chunk[CHUNK_SIZE];
+
+void
+test_main (void) 
+{
+  long long start;
+  int pass;
+  size_t i;
+
+  start = clock_ns ();
+  for (i = 0; i < PAGE_CNT; i++)
+    big_chunk[i * PAGE_SIZE] = i;
+  msg ("swap write: %d ops in %lld ns", PAGE_CNT, clock_ns () - start);
+
+  start = clock_ns ();
+  for (pass = 0; pass < PASS_CNT; pass++)
+    for (i = 0; i < PAGE_CNT; i++)
+      if (big_chunk[i * PAGE_SIZE] != (char) i)
+        fail ("page %zu is inconsistent", i);
+  msg ("swap read: %d ops in %lld ns", PASS_CNT * PAGE_CNT,
+       clock_ns () - start);
+}
@@ -0,0 +1,44 @@
+/* Streams a 1 MB file in 4 kB reads while dirtying 12 MB of
+   anonymous memory, more than the machine has, one page per
+   read, so that a single process keeps both the swap disk and
+   the file system disk busy.  Each read and each page touched is
+   one operation. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+#define CHUNK_SIZE (12 * 1024 * 1024)
+#define PAGE_CNT (CHUNK_SIZE / PAGE_SIZE)
+#define FILE_SIZE (1024 * 1024)
+#define BLOCK_CNT (FILE_SIZE / PAGE_SIZE)
+
+static char big_chunk[CHUNK_SIZE];
+static char buf[PAGE_SIZE];
+
+void
+test_main (void) 
+{
+  long long start;
+  int fd, i;
+
+  CHECK (create ("stream", FILE_SIZE), "create \"stream\"");
+  CHECK ((fd = open ("stream")) > 1, "open \"stream\"");
+
+  start = clock_ns ();
+  for (i = 0; i < PAGE_CNT; i++)
+    {
+      if (i % BLOCK_CNT == 0)
+        seek (fd, 0);
+      if (read (fd, buf, PAGE_SIZE) != PAGE_SIZE)
+        fail ("read block %d", i % BLOCK_CNT);
+      big_chunk[i * PAGE_SIZE] = i;
+    }
+  for (i = 0; i < PAGE_CNT; i++)
+    if (big_chunk[i * PAGE_SIZE] != (char) i)
+      fail ("page %d is inconsistent", i);
+  msg ("swap while streaming: %d ops in %lld ns", 3 * PAGE_CNT,
+       clock_ns () - start);
+  close (fd);
+}
@@ -0,0 +1,80 @@
+/* Deploys two releases side by side and switches a "current"
+   symlink from one to the other, the way deployments swap the
+   live version.  Reports how long opens through the symlink take,
+   and checks that a hard link keeps a
+   release's file alive after its original name is removed. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define OPEN_CNT 500
+
+/* Creates file NAME holding the string CONTENTS. */
+static void
+make_file (const char *name, const char *contents) 
+{
+  int fd;
+
+  CHECK (create (name, 0), "create \"%s\"", name);
+  CHECK ((fd = open (name)) > 1, "open \"%s\"", name);
+  if (write (fd, contents, strlen (contents)) != (int) strlen (contents))
+    fail ("write \"%s\"", name);
+  close (fd);
+}
+
+/* Opens NAME OPEN_CNT times, checking each time that it holds the
+   string CONTENTS, and reports the time taken. */
+static void
+open_many (const char *name, const char *contents) 
+{
+  char buf[16];
+  long long start;
+  int i;
+
+  start = clock_ns ();
+  for (i = 0; i < OPEN_CNT; i++)
+    {
+      int fd = open (name);
+      if (fd < 2)
+        fail ("open \"%s\"", name);
+      memset (buf, 0, sizeof buf);
+      read (fd, buf, sizeof buf - 1);
+      if (strcmp (buf, contents))
+        fail ("\"%s\" holds \"%s\", expected \"%s\"", name, buf, contents);
+      close (fd);
+    }
+  msg ("open \"%s\": %d ops in %lld ns", name, OPEN_CNT,
+       clock_ns () - start);
+}
+
+void
+test_main (void) 
+{
+  CHECK (mkdir ("releases"), "mkdir \"releases\"");
+  CHECK (mkdir ("releases/v1"), "mkdir \"releases/v1\"");
+  CHECK (mkdir ("releases/v2"), "mkdir \"releases/v2\"");
+  make_file ("releases/v1/config", "version 1");
+  make_file ("releases/v2/config", "version 2");
+
+  CHECK (symlink ("releases/v1", "current") == 0,
+         "symlink \"current\" to \"releases/v1\"");
+  open_many ("current/config", "version 1");
+
+  CHECK (symlink ("releases/v2", "next") == 0,
+         "symlink \"next\" to \"releases/v2\"");
+  CHECK (remove ("current"), "remove \"current\"");
+  CHECK (symlink ("next", "current") == 0, "symlink \"current\" to \"next\"");
+  open_many ("current/config", "version 2");
+
+  CHECK (link ("releases/v1/config", "old-config") == 0,
+         "link \"old-config\" to \"releases/v1/config\"");
+  CHECK (remove ("releases/v1/config"), "remove \"releases/v1/config\"");
+  CHECK (open ("releases/v1/config") == -1,
+         "open \"releases/v1/config\" (must fail)");
+  open_many ("old-config", "version 1");
+
+  CHECK (link ("releases", "releases-too") == -1,
+         "link \"releases-too\" to directory (must fail)");
+}
@@ -0,0 +1,8 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+use tests::random;
+check_archive ({"f" => ["\0" x 1000 . random_bytes (100) . "\0" x 8092],
+		"dir" => {}});
+pass;
@@ -0,0 +1,53 @@
+/* Preallocates space in a file with fallocate(), checking that
+   the file grows only when the range ends past end of file, that
+   preallocated space reads as zeros until written, and that bad
+   ranges, file descriptors and directories are refused. */
+
+#include <random.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define FILE_SIZE 9192
+static char expected[FILE_SIZE];
+static char rbuf[FILE_SIZE];
+
+void
+test_main (void)
+{
+  int fd, dir_fd;
+
+  random_init (0);
+  random_bytes (expected + 1000, 100);
+
+  CHECK (create ("f", 0), "create \"f\"");
+  CHECK ((fd = open ("f")) > 1, "open \"f\"");
+  CHECK (fallocate (fd, 0, 8192) == 0, "fallocate 8192 bytes");
+  CHECK (filesize (fd) == 8192, "filesize of \"f\" is 8192");
+  CHECK (tell (fd) == 0, "file position is still 0");
+  CHECK (read (fd, rbuf, 8192) == 8192, "read \"f\"");
+  compare_bytes (rbuf, expected, 8192, 0, "f");
+
+  msg ("seek \"f\" to 1000");
+  seek (fd, 1000);
+  CHECK (write (fd, expected + 1000, 100) == 100, "write 100 bytes");
+  CHECK (fallocate (fd, 4096, 100) == 0, "fallocate within file");
+  CHECK (filesize (fd) == 8192, "filesize of \"f\" is 8192");
+  CHECK (fallocate (fd, 8192, 1000) == 0, "fallocate past end of file");
+  CHECK (filesize (fd) == FILE_SIZE, "filesize of \"f\" is %d", FILE_SIZE);
+
+  CHECK (fallocate (fd, 0, 0) == -1, "fallocate of 0 bytes fails");
+  CHECK (fallocate (fd, 0, -1) == -1, "fallocate of negative length fails");
+  CHECK (fallocate (fd, -1, 10) == -1, "fallocate at negative offset fails");
+  CHECK (fallocate (1000, 0, 10) == -1, "fallocate of bad fd fails");
+  CHECK (mkdir ("dir"), "mkdir \"dir\"");
+  CHECK ((dir_fd = open ("dir")) > 1, "open \"dir\"");
+  CHECK (fallocate (dir_fd, 0, 10) == -1, "fallocate of directory fails");
+  msg ("close \"dir\"");
+  close (dir_fd);
+
+  msg ("close \"f\"");
+  close (fd);
+  check_file ("f", expected, FILE_SIZE);
+}
@@ -0,0 +1,33 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(fallocate) begin
+(fallocate) create "f"
+(fallocate) open "f"
+(fallocate) fallocate 8192 bytes
+(fallocate) filesize of "f" is 8192
+(fallocate) file position is still 0
+(fallocate) read "f"
+(fallocate) seek "f" to 1000
+(fallocate) write 100 bytes
+(fallocate) fallocate within file
+(fallocate) filesize of "f" is 8192
+(fallocate) fallocate past end of file
+(fallocate) filesize of "f" is 9192
+(fallocate) fallocate of 0 bytes fails
+(fallocate) fallocate of negative length fails
+(fallocate) fallocate at negative offset fails
+(fallocate) fallocate of bad fd fails
+(fallocate) mkdir "dir"
+(fallocate) open "dir"
+(fallocate) fallocate of directory fails
+(fallocate) close "dir"
+(fallocate) close "f"
+(fallocate) open "f" for verification
+(fallocate) verified contents of "f"
+(fallocate) close "f"
+(fallocate) end
+EOF
+pass;
@@ -0,0 +1,7 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_archive ({"d" => {"a" => ["\0" x 10], "b" => [""], "sub" => {},
+			"s" => ["\0" x 10]}});
+pass;
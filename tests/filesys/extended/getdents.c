@@ -0,0 +1,79 @@
+/* Reads a directory with getdents(), a few entries at a time,
+   and checks the names, types and inode numbers of its entries,
+   and that getdents() refuses files and bad file descriptors. */
+
+#include <limits.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static const struct
+  {
+    const char *name;
+    int type;
+  }
+expected[] =
+  {
+    {"a", DT_REG},
+    {"b", DT_REG},
+    {"sub", DT_DIR},
+    {"s", DT_LNK},
+  };
+#define EXPECTED_CNT (sizeof expected / sizeof *expected)
+
+void
+test_main (void)
+{
+  struct dirent ents[EXPECTED_CNT + 1];
+  struct dirent found[EXPECTED_CNT + 1];
+  int found_cnt = 0;
+  int dir_fd, fd, n;
+  size_t i;
+
+  CHECK (mkdir ("d"), "mkdir \"d\"");
+  CHECK (create ("d/a", 10), "create \"d/a\"");
+  CHECK (create ("d/b", 0), "create \"d/b\"");
+  CHECK (mkdir ("d/sub"), "mkdir \"d/sub\"");
+  CHECK (symlink ("/d/a", "d/s") == 0, "symlink \"d/s\"");
+
+  CHECK ((dir_fd = open ("d")) > 1, "open \"d\"");
+  CHECK (getdents (dir_fd, ents, 0) == 0, "getdents of 0 entries");
+  msg ("read \"d\" 3 entries at a time");
+  while ((n = getdents (dir_fd, ents, 3)) > 0)
+    {
+      if (n > 3 || found_cnt + n > (int) EXPECTED_CNT)
+        fail ("getdents returned %d entries after %d", n, found_cnt);
+      memcpy (found + found_cnt, ents, n * sizeof *ents);
+      found_cnt += n;
+    }
+  CHECK (n == 0, "getdents at end of directory");
+  CHECK (found_cnt == EXPECTED_CNT, "found %zu entries", EXPECTED_CNT);
+
+  for (i = 0; i < EXPECTED_CNT; i++)
+    {
+      int j;
+
+      for (j = 0; j < found_cnt; j++)
+        if (!strcmp (found[j].d_name, expected[i].name))
+          break;
+      if (j == found_cnt)
+        fail ("\"%s\" not found", expected[i].name);
+      CHECK (found[j].d_type == expected[i].type, "\"%s\" has type %d",
+             expected[i].name, expected[i].type);
+    }
+
+  CHECK ((fd = open ("d/a")) > 1, "open \"d/a\"");
+  for (i = 0; strcmp (found[i].d_name, "a"); i++)
+    continue;
+  CHECK (found[i].d_ino == inumber (fd), "\"a\" has its inode number");
+
+  CHECK (getdents (fd, ents, 3) == -1, "getdents of file fails");
+  CHECK (getdents (1000, ents, 3) == -1, "getdents of bad fd fails");
+  CHECK (getdents (dir_fd, ents, UINT_MAX) == -1,
+         "getdents of too many entries fails");
+  msg ("close \"d/a\"");
+  close (fd);
+  msg ("close \"d\"");
+  close (dir_fd);
+}
@@ -0,0 +1,30 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(getdents) begin
+(getdents) mkdir "d"
+(getdents) create "d/a"
+(getdents) create "d/b"
+(getdents) mkdir "d/sub"
+(getdents) symlink "d/s"
+(getdents) open "d"
+(getdents) getdents of 0 entries
+(getdents) read "d" 3 entries at a time
+(getdents) getdents at end of directory
+(getdents) found 4 entries
+(getdents) "a" has type 1
+(getdents) "b" has type 1
+(getdents) "sub" has type 2
+(getdents) "s" has type 3
+(getdents) open "d/a"
+(getdents) "a" has its inode number
+(getdents) getdents of file fails
+(getdents) getdents of bad fd fails
+(getdents) getdents of too many entries fails
+(getdents) close "d/a"
+(getdents) close "d"
+(getdents) end
+EOF
+pass;
@@ -0,0 +1,47 @@
+/* Gives a file a second name with link(), checks that data
+   written under one name shows under the other and outlives the
+   removal of the first name, and that link() refuses missing
+   files, directories and names in use. */
+
+#include <random.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define FILE_SIZE 2000
+static char buf[FILE_SIZE];
+
+void
+test_main (void)
+{
+  int fd;
+
+  random_init (0);
+  random_bytes (buf, sizeof buf);
+
+  CHECK (create ("a", 0), "create \"a\"");
+  CHECK ((fd = open ("a")) > 1, "open \"a\"");
+  CHECK (write (fd, buf, 1500) == 1500, "write 1500 bytes to \"a\"");
+  msg ("close \"a\"");
+  close (fd);
+
+  CHECK (link ("a", "b") == 0, "link \"a\" as \"b\"");
+  CHECK ((fd = open ("b")) > 1, "open \"b\"");
+  msg ("seek \"b\" to 1500");
+  seek (fd, 1500);
+  CHECK (write (fd, buf + 1500, FILE_SIZE - 1500) == FILE_SIZE - 1500,
+         "write 500 bytes to \"b\"");
+  msg ("close \"b\"");
+  close (fd);
+  check_file ("a", buf, FILE_SIZE);
+
+  CHECK (remove ("a"), "remove \"a\"");
+  CHECK (open ("a") == -1, "open \"a\" fails");
+  check_file ("b", buf, FILE_SIZE);
+
+  CHECK (link ("a", "c") == -1, "link of missing file fails");
+  CHECK (link ("b", "b") == -1, "link over existing name fails");
+  CHECK (link ("b", "nodir/c") == -1, "link into missing directory fails");
+  CHECK (mkdir ("dir"), "mkdir \"dir\"");
+  CHECK (link ("dir", "dir2") == -1, "link of directory fails");
+}
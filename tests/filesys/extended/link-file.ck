@@ -0,0 +1,31 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(link-file) begin
+(link-file) create "a"
+(link-file) open "a"
+(link-file) write 1500 bytes to "a"
+(link-file) close "a"
+(link-file) link "a" as "b"
+(link-file) open "b"
+(link-file) seek "b" to 1500
+(link-file) write 500 bytes to "b"
+(link-file) close "b"
+(link-file) open "a" for verification
+(link-file) verified contents of "a"
+(link-file) close "a"
+(link-file) remove "a"
+(link-file) open "a" fails
+(link-file) open "b" for verification
+(link-file) verified contents of "b"
+(link-file) close "b"
+(link-file) link of missing file fails
+(link-file) link over existing name fails
+(link-file) link into missing directory fails
+(link-file) mkdir "dir"
+(link-file) link of directory fails
+(link-file) end
+EOF
+pass;
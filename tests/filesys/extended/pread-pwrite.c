@@ -0,0 +1,58 @@
+/* Writes a file out of order with pwrite() and reads it back with
+   pread(), checking that neither moves the file position, and
+   that both refuse bad offsets, file descriptors and
+   directories. */
+
+#include <random.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define FILE_SIZE 5678
+#define HALF (FILE_SIZE / 2)
+static char buf[FILE_SIZE];
+static char rbuf[FILE_SIZE];
+
+void
+test_main (void)
+{
+  int fd, dir_fd;
+
+  random_init (0);
+  random_bytes (buf, sizeof buf);
+
+  CHECK (create ("foo", 0), "create \"foo\"");
+  CHECK ((fd = open ("foo")) > 1, "open \"foo\"");
+
+  CHECK (pwrite (fd, buf + HALF, FILE_SIZE - HALF, HALF) == FILE_SIZE - HALF,
+         "pwrite second half of \"foo\"");
+  CHECK (filesize (fd) == FILE_SIZE, "filesize of \"foo\" is %d", FILE_SIZE);
+  CHECK (pwrite (fd, buf, HALF, 0) == HALF, "pwrite first half of \"foo\"");
+  CHECK (tell (fd) == 0, "file position is still 0");
+
+  CHECK (pread (fd, rbuf, FILE_SIZE - 100, 100) == FILE_SIZE - 100,
+         "pread \"foo\" from offset 100");
+  compare_bytes (rbuf, buf + 100, FILE_SIZE - 100, 100, "foo");
+  CHECK (tell (fd) == 0, "file position is still 0");
+  CHECK (pread (fd, rbuf, 100, FILE_SIZE - 10) == 10,
+         "pread across end of file reads 10 bytes");
+  compare_bytes (rbuf, buf + FILE_SIZE - 10, 10, FILE_SIZE - 10, "foo");
+  CHECK (pread (fd, rbuf, 100, FILE_SIZE) == 0, "pread at end of file");
+
+  CHECK (pread (fd, rbuf, 10, -1) == -1, "pread at negative offset fails");
+  CHECK (pwrite (fd, buf, 10, -1) == -1, "pwrite at negative offset fails");
+  CHECK (pread (1000, rbuf, 10, 0) == -1, "pread from bad fd fails");
+  CHECK (pwrite (1000, buf, 10, 0) == -1, "pwrite to bad fd fails");
+  CHECK (pread (0, rbuf, 10, 0) == -1, "pread from stdin fails");
+
+  CHECK (mkdir ("dir"), "mkdir \"dir\"");
+  CHECK ((dir_fd = open ("dir")) > 1, "open \"dir\"");
+  CHECK (pread (dir_fd, rbuf, 10, 0) == -1, "pread from directory fails");
+  CHECK (pwrite (dir_fd, buf, 10, 0) == -1, "pwrite to directory fails");
+  msg ("close \"dir\"");
+  close (dir_fd);
+
+  msg ("close \"foo\"");
+  close (fd);
+  check_file ("foo", buf, FILE_SIZE);
+}
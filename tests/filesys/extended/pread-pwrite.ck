@@ -0,0 +1,33 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(pread-pwrite) begin
+(pread-pwrite) create "foo"
+(pread-pwrite) open "foo"
+(pread-pwrite) pwrite second half of "foo"
+(pread-pwrite) filesize of "foo" is 5678
+(pread-pwrite) pwrite first half of "foo"
+(pread-pwrite) file position is still 0
+(pread-pwrite) pread "foo" from offset 100
+(pread-pwrite) file position is still 0
+(pread-pwrite) pread across end of file reads 10 bytes
+(pread-pwrite) pread at end of file
+(pread-pwrite) pread at negative offset fails
+(pread-pwrite) pwrite at negative offset fails
+(pread-pwrite) pread from bad fd fails
+(pread-pwrite) pwrite to bad fd fails
+(pread-pwrite) pread from stdin fails
+(pread-pwrite) mkdir "dir"
+(pread-pwrite) open "dir"
+(pread-pwrite) pread from directory fails
+(pread-pwrite) pwrite to directory fails
+(pread-pwrite) close "dir"
+(pread-pwrite) close "foo"
+(pread-pwrite) open "foo" for verification
+(pread-pwrite) verified contents of "foo"
+(pread-pwrite) close "foo"
+(pread-pwrite) end
+EOF
+pass;
@@ -0,0 +1,63 @@
+/* Writes a file from several buffers with writev() and reads it
+   back into differently sized buffers with readv(), checking that
+   both advance the file position, stop at end of file and refuse
+   bad buffer counts and file descriptors. */
+
+#include <random.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define FILE_SIZE 3000
+static char buf[FILE_SIZE];
+static char rbuf[FILE_SIZE + 100];
+
+void
+test_main (void)
+{
+  struct iovec out[4], in[3];
+  int fd;
+
+  random_init (0);
+  random_bytes (buf, sizeof buf);
+
+  CHECK (create ("foo", 0), "create \"foo\"");
+  CHECK ((fd = open ("foo")) > 1, "open \"foo\"");
+
+  out[0].iov_base = buf;
+  out[0].iov_len = 1000;
+  out[1].iov_base = buf + 1000;
+  out[1].iov_len = 0;
+  out[2].iov_base = buf + 1000;
+  out[2].iov_len = 1;
+  out[3].iov_base = buf + 1001;
+  out[3].iov_len = FILE_SIZE - 1001;
+  CHECK (writev (fd, out, 4) == FILE_SIZE, "writev 4 buffers to \"foo\"");
+  CHECK (tell (fd) == FILE_SIZE, "file position is %d", FILE_SIZE);
+
+  msg ("seek \"foo\" to 0");
+  seek (fd, 0);
+  in[0].iov_base = rbuf;
+  in[0].iov_len = 17;
+  in[1].iov_base = rbuf + 17;
+  in[1].iov_len = 2000;
+  in[2].iov_base = rbuf + 2017;
+  in[2].iov_len = sizeof rbuf - 2017;
+  CHECK (readv (fd, in, 3) == FILE_SIZE, "readv 3 buffers past end of file");
+  compare_bytes (rbuf, buf, FILE_SIZE, 0, "foo");
+  CHECK (tell (fd) == FILE_SIZE, "file position is %d", FILE_SIZE);
+  CHECK (readv (fd, in, 3) == 0, "readv at end of file");
+
+  CHECK (readv (fd, in, 0) == -1, "readv of 0 buffers fails");
+  CHECK (writev (fd, out, 0) == -1, "writev of 0 buffers fails");
+  CHECK (readv (fd, in, IOV_MAX + 1) == -1, "readv of too many buffers fails");
+  CHECK (writev (fd, out, IOV_MAX + 1) == -1,
+         "writev of too many buffers fails");
+  CHECK (readv (1000, in, 3) == -1, "readv from bad fd fails");
+  CHECK (writev (1000, out, 4) == -1, "writev to bad fd fails");
+
+  msg ("close \"foo\"");
+  close (fd);
+  check_file ("foo", buf, FILE_SIZE);
+}
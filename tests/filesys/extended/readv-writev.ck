@@ -0,0 +1,27 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(readv-writev) begin
+(readv-writev) create "foo"
+(readv-writev) open "foo"
+(readv-writev) writev 4 buffers to "foo"
+(readv-writev) file position is 3000
+(readv-writev) seek "foo" to 0
+(readv-writev) readv 3 buffers past end of file
+(readv-writev) file position is 3000
+(readv-writev) readv at end of file
+(readv-writev) readv of 0 buffers fails
+(readv-writev) writev of 0 buffers fails
+(readv-writev) readv of too many buffers fails
+(readv-writev) writev of too many buffers fails
+(readv-writev) readv from bad fd fails
+(readv-writev) writev to bad fd fails
+(readv-writev) close "foo"
+(readv-writev) open "foo" for verification
+(readv-writev) verified contents of "foo"
+(readv-writev) close "foo"
+(readv-writev) end
+EOF
+pass;
@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+use tests::random;
+my ($src) = random_bytes (6000);
+check_archive ({
+    "src" => [$src],
+    "dst" => [substr ($src, 1000, 3000) . $src],
+    "text" => ["sendfile to stdout\n"],
+    "dir" => {},
+});
+pass;
@@ -0,0 +1,68 @@
+/* Copies parts of a file to another file and to the console with
+   sendfile(), with and without an offset of its own, and checks
+   that bad file descriptors and directories are refused. */
+
+#include <random.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define SRC_SIZE 6000
+static char src[SRC_SIZE];
+static char expected[3000 + SRC_SIZE];
+static const char text[] = "sendfile to stdout\n";
+
+void
+test_main (void)
+{
+  int in_fd, out_fd, text_fd, dir_fd;
+  off_t ofs;
+
+  random_init (0);
+  random_bytes (src, sizeof src);
+  memcpy (expected, src + 1000, 3000);
+  memcpy (expected + 3000, src, SRC_SIZE);
+
+  CHECK (create ("src", 0), "create \"src\"");
+  CHECK ((in_fd = open ("src")) > 1, "open \"src\"");
+  CHECK (write (in_fd, src, SRC_SIZE) == SRC_SIZE, "write \"src\"");
+  msg ("seek \"src\" to 0");
+  seek (in_fd, 0);
+  CHECK (create ("dst", 0), "create \"dst\"");
+  CHECK ((out_fd = open ("dst")) > 1, "open \"dst\"");
+
+  ofs = 1000;
+  CHECK (sendfile (out_fd, in_fd, &ofs, 3000) == 3000,
+         "sendfile 3000 bytes from offset 1000");
+  CHECK (ofs == 4000, "offset is now 4000");
+  CHECK (tell (in_fd) == 0, "position of \"src\" is still 0");
+  CHECK (sendfile (out_fd, in_fd, NULL, 10000) == SRC_SIZE,
+         "sendfile rest of \"src\" from its position");
+  CHECK (tell (in_fd) == SRC_SIZE, "position of \"src\" is %d", SRC_SIZE);
+  CHECK (sendfile (out_fd, in_fd, NULL, 100) == 0, "sendfile at end of file");
+
+  CHECK (create ("text", 0), "create \"text\"");
+  CHECK ((text_fd = open ("text")) > 1, "open \"text\"");
+  CHECK (write (text_fd, text, sizeof text - 1) == (int) sizeof text - 1,
+         "write \"text\"");
+  ofs = 0;
+  CHECK (sendfile (1, text_fd, &ofs, 100) == (int) sizeof text - 1,
+         "sendfile \"text\" to stdout");
+
+  CHECK (mkdir ("dir"), "mkdir \"dir\"");
+  CHECK ((dir_fd = open ("dir")) > 1, "open \"dir\"");
+  CHECK (sendfile (out_fd, 1000, NULL, 10) == -1, "sendfile from bad fd fails");
+  CHECK (sendfile (0, in_fd, NULL, 10) == -1, "sendfile to stdin fails");
+  CHECK (sendfile (out_fd, dir_fd, NULL, 10) == -1,
+         "sendfile from directory fails");
+  CHECK (sendfile (dir_fd, in_fd, NULL, 10) == -1,
+         "sendfile to directory fails");
+
+  msg ("close all files");
+  close (dir_fd);
+  close (text_fd);
+  close (out_fd);
+  close (in_fd);
+  check_file ("dst", expected, sizeof expected);
+}
@@ -0,0 +1,36 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(sendfile) begin
+(sendfile) create "src"
+(sendfile) open "src"
+(sendfile) write "src"
+(sendfile) seek "src" to 0
+(sendfile) create "dst"
+(sendfile) open "dst"
+(sendfile) sendfile 3000 bytes from offset 1000
+(sendfile) offset is now 4000
+(sendfile) position of "src" is still 0
+(sendfile) sendfile rest of "src" from its position
+(sendfile) position of "src" is 6000
+(sendfile) sendfile at end of file
+(sendfile) create "text"
+(sendfile) open "text"
+(sendfile) write "text"
+(sendfile) sendfile "text" to stdout
+sendfile to stdout
+(sendfile) mkdir "dir"
+(sendfile) open "dir"
+(sendfile) sendfile from bad fd fails
+(sendfile) sendfile to stdin fails
+(sendfile) sendfile from directory fails
+(sendfile) sendfile to directory fails
+(sendfile) close all files
+(sendfile) open "dst" for verification
+(sendfile) verified contents of "dst"
+(sendfile) close "dst"
+(sendfile) end
+EOF
+pass;
@@ -0,0 +1,44 @@
+/* Checks that symlink() refuses empty and overlong targets and
+   names in use, that a link whose target is missing cannot be
+   opened but can be removed, and that a target too long to fit
+   in the inode still leads to the file. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+/* Targets must fit in a page, null terminator included. */
+#define TARGET_MAX 4095
+static char target[TARGET_MAX + 2];
+static char zeros[10];
+
+void
+test_main (void)
+{
+  int i;
+
+  CHECK (create ("a", sizeof zeros), "create \"a\"");
+  CHECK (symlink ("", "x") == -1, "symlink to empty target fails");
+  CHECK (symlink ("x", "a") == -1, "symlink over existing name fails");
+
+  CHECK (symlink ("missing", "dangling") == 0, "symlink \"dangling\"");
+  CHECK (open ("dangling") == -1, "open \"dangling\" fails");
+  CHECK (remove ("dangling"), "remove \"dangling\"");
+
+  for (i = 0; i < 300; i++)
+    memcpy (target + 2 * i, "./", 2);
+  strlcpy (target + 600, "a", sizeof target - 600);
+  CHECK (symlink (target, "long") == 0, "symlink \"long\" to a 601-byte path");
+  check_file ("long", zeros, sizeof zeros);
+
+  memset (target, 'x', TARGET_MAX);
+  target[TARGET_MAX] = '\0';
+  CHECK (symlink (target, "max") == 0, "symlink to a %d-byte target",
+         TARGET_MAX);
+  CHECK (remove ("max"), "remove \"max\"");
+  target[TARGET_MAX] = 'x';
+  target[TARGET_MAX + 1] = '\0';
+  CHECK (symlink (target, "over") == -1, "symlink to a %d-byte target fails",
+         TARGET_MAX + 1);
+}
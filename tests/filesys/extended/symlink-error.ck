@@ -0,0 +1,22 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(symlink-error) begin
+(symlink-error) create "a"
+(symlink-error) symlink to empty target fails
+(symlink-error) symlink over existing name fails
+(symlink-error) symlink "dangling"
+(symlink-error) open "dangling" fails
+(symlink-error) remove "dangling"
+(symlink-error) symlink "long" to a 601-byte path
+(symlink-error) open "long" for verification
+(symlink-error) verified contents of "long"
+(symlink-error) close "long"
+(symlink-error) symlink to a 4095-byte target
+(symlink-error) remove "max"
+(symlink-error) symlink to a 4096-byte target fails
+(symlink-error) end
+EOF
+pass;
@@ -0,0 +1,136 @@
+/* Creates 1,000 threads that sleep different durations at the
+   same time, several times each, and verifies that none of them
+   wakes up early.  Then sleeps for less than a tick many times and
+   verifies the same.  Reports how late the wake-ups were. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define THREAD_CNT 1000
+#define ITERATIONS 4
+#define MAX_DURATION 20
+
+#define SHORT_SLEEP_CNT 200
+#define SHORT_SLEEP_US 500
+
+/* Information about the test. */
+struct sleep_test 
+  {
+    int64_t start;              /* Current time at start of test. */
+    struct semaphore done;      /* Upped by each thread when done. */
+
+    /* Output. */
+    struct lock output_lock;    /* Lock protecting the members below. */
+    int early_cnt;              /* Wake-ups before the requested tick. */
+    int64_t late_ticks;         /* Sum of ticks late over all wake-ups. */
+    int64_t max_late_ticks;     /* Most ticks late for one wake-up. */
+  };
+
+/* Information about an individual thread in the test. */
+struct sleep_thread 
+  {
+    struct sleep_test *test;    /* Info shared between all threads. */
+    int duration;               /* Number of ticks to sleep. */
+  };
+
+static void sleeper (void *);
+
+void
+test_alarm_many (void) 
+{
+  struct sleep_test test;
+  struct sleep_thread *threads;
+  int64_t slept_ns, max_late_ns;
+  int i;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  msg ("Creating %d threads to sleep %d times each.",
+       THREAD_CNT, ITERATIONS);
+
+  threads = malloc (sizeof *threads * THREAD_CNT);
+  if (threads == NULL)
+    PANIC ("couldn't allocate memory for test");
+
+  test.start = timer_ticks () + 100;
+  sema_init (&test.done, 0);
+  lock_init (&test.output_lock);
+  test.early_cnt = 0;
+  test.late_ticks = test.max_late_ticks = 0;
+
+  for (i = 0; i < THREAD_CNT; i++)
+    {
+      struct sleep_thread *t = threads + i;
+      char name[16];
+
+      t->test = &test;
+      t->duration = i % MAX_DURATION + 1;
+      snprintf (name, sizeof name, "sleeper %d", i);
+      if (thread_create (name, PRI_DEFAULT, sleeper, t) == TID_ERROR)
+        fail ("couldn't create thread %d", i);
+    }
+  for (i = 0; i < THREAD_CNT; i++)
+    sema_down (&test.done);
+
+  if (test.early_cnt != 0)
+    fail ("%d wake-ups were early", test.early_cnt);
+  msg ("All %d wake-ups were on time or late.", THREAD_CNT * ITERATIONS);
+  printf ("alarm-many: %lld ticks late on average, %lld at most\n",
+          test.late_ticks / (THREAD_CNT * ITERATIONS), test.max_late_ticks);
+
+  /* Sleep for less than a tick. */
+  max_late_ns = 0;
+  for (i = 0; i < SHORT_SLEEP_CNT; i++)
+    {
+      int64_t start = timer_ns ();
+      timer_usleep (SHORT_SLEEP_US);
+      slept_ns = timer_ns () - start;
+      if (slept_ns < SHORT_SLEEP_US * 1000)
+        fail ("%d us sleep took only %lld ns", SHORT_SLEEP_US, slept_ns);
+      if (slept_ns - SHORT_SLEEP_US * 1000 > max_late_ns)
+        max_late_ns = slept_ns - SHORT_SLEEP_US * 1000;
+    }
+  msg ("All %d sleeps of %d us were long enough.",
+       SHORT_SLEEP_CNT, SHORT_SLEEP_US);
+  printf ("alarm-many: %d us sleeps %lld ns late at most\n",
+          SHORT_SLEEP_US, max_late_ns);
+
+  free (threads);
+  pass ();
+}
+
+/* Sleeper thread. */
+static void
+sleeper (void *t_) 
+{
+  struct sleep_thread *t = t_;
+  struct sleep_test *test = t->test;
+  int i;
+
+  for (i = 1; i <= ITERATIONS; i++) 
+    {
+      int64_t sleep_until = test->start + i * t->duration;
+      int64_t late;
+
+      timer_sleep (sleep_until - timer_ticks ());
+      late = timer_ticks () - sleep_until;
+
+      lock_acquire (&test->output_lock);
+      if (late < 0)
+        test->early_cnt++;
+      else
+        {
+          test->late_ticks += late;
+          if (late > test->max_late_ticks)
+            test->max_late_ticks = late;
+        }
+      lock_release (&test->output_lock);
+    }
+  sema_up (&test->done);
+}
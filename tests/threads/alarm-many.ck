@@ -0,0 +1,18 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+our ($test);
+
+# The lateness figures vary from run to run, so leave them out.
+my (@output) = grep (!/^alarm-many: /, read_text_file ("$test.output"));
+common_checks ("run", @output);
+compare_output ("run", \@output, [<<'EOF']);
+(alarm-many) begin
+(alarm-many) Creating 1000 threads to sleep 4 times each.
+(alarm-many) All 4000 wake-ups were on time or late.
+(alarm-many) All 200 sleeps of 500 us were long enough.
+(alarm-many) PASS
+(alarm-many) end
+EOF
+pass;
@@ -226,6 +226,10 @@ parse_options (char **argv) {
 			user_page_limit = atoi (value);
 		else if (!strcmp (name, "-threads-tests"))
 			thread_tests = true;
+#endif
+#ifdef VM
+		else if (!strcmp (name, "-swap"))
+			swap_disk_list = value;
 #endif
 		else
 			PANIC ("unknown option `%s' (use -h for help)", name);
@@ -328,6 +332,9 @@ usage (void) {
 			"  -mlfqs             Use multi-level feedback queue scheduler.\n"
 #ifdef USERPROG
 			"  -ul=COUNT          Limit user memory to COUNT pages.\n"
+#endif
+#ifdef VM
+			"  -swap=CH:DEV,...   Stripe swap across the given disks.\n"
 #endif
 			);
 	power_off ();
@@ -376,4 +376,78 @@ cond_priority_more (const struct list_elem *a_, const struct list_elem *b_,void
 	const struct thread *a_th = list_entry(list_front(&a->semaphore.waiters), struct thread, elem);
 	const struct thread *b_th = list_entry(list_front(&b->semaphore.waiters), struct thread, elem);
   return a_th->priority > b_th->priority;
-}
\ No newline at end of file
+}
+
+/* Initializes RW, a readers-writer lock.  Any number of readers
+ * may hold RW at once, or a single writer, but not both.  A
+ * writer waiting for RW keeps new readers out, so that a steady
+ * stream of readers cannot starve writers. */
+void
+rwlock_init (struct rwlock *rw) {
+	ASSERT (rw != NULL);
+
+	lock_init (&rw->lock);
+	cond_init (&rw->readers_ok);
+	cond_init (&rw->writer_ok);
+	rw->reader_cnt = 0;
+	rw->waiting_writer_cnt = 0;
+	rw->writer = false;
+}
+
+/* Acquires RW for reading, sleeping until no writer holds it or
+ * waits for it. */
+void
+rwlock_acquire_read (struct rwlock *rw) {
+	ASSERT (rw != NULL);
+	ASSERT (!intr_context ());
+
+	lock_acquire (&rw->lock);
+	while (rw->writer || rw->waiting_writer_cnt > 0)
+		cond_wait (&rw->readers_ok, &rw->lock);
+	rw->reader_cnt++;
+	lock_release (&rw->lock);
+}
+
+/* Releases RW, which the current thread holds for reading. */
+void
+rwlock_release_read (struct rwlock *rw) {
+	ASSERT (rw != NULL);
+
+	lock_acquire (&rw->lock);
+	ASSERT (rw->reader_cnt > 0);
+	if (--rw->reader_cnt == 0)
+		cond_signal (&rw->writer_ok, &rw->lock);
+	lock_release (&rw->lock);
+}
+
+/* Acquires RW for writing, sleeping until nobody else holds it. */
+void
+rwlock_acquire_write (struct rwlock *rw) {
+	ASSERT (rw != NULL);
+	ASSERT (!intr_context ());
+
+	lock_acquire (&rw->lock);
+	rw->waiting_writer_cnt++;
+	while (rw->writer || rw->reader_cnt > 0)
+		cond_wait (&rw->writer_ok, &rw->lock);
+	rw->waiting_writer_cnt--;
+	rw->writer = true;
+	lock_release (&rw->lock);
+}
+
+/* Releases RW, which the current thread holds for writing.  Hands
+ * RW to the next waiting writer if there is one, otherwise to all
+ * waiting readers. */
+void
+rwlock_release_write (struct rwlock *rw) {
+	ASSERT (rw != NULL);
+
+	lock_acquire (&rw->lock);
+	ASSERT (rw->writer);
+	rw->writer = false;
+	if (rw->waiting_writer_cnt > 0)
+		cond_signal (&rw->writer_ok, &rw->lock);
+	else
+		cond_broadcast (&rw->readers_ok, &rw->lock);
+	lock_release (&rw->lock);
+}
@@ -4,6 +4,7 @@
 #include <random.h>
 #include <stdio.h>
 #include <string.h>
+#include "devices/timer.h"
 #include "threads/flags.h"
 #include "threads/interrupt.h"
 #include "threads/intr-stubs.h"
@@ -23,12 +24,8 @@
 /* 기본 스레드의 임의 값 이 값을 수정하지 마십시오. */
 #define THREAD_BASIC 0xd42df210
 
-#define min(a, b) (((a) < (b)) ? (a) : (b))
-
 /* THREAD_READY 상태의 프로세스 목록, 즉 실행할 준비가 되었지만 실제로 실행되지는 않은 프로세스의 목록입니다. */
 static struct list ready_list;
-// 자고 있는 스레드 리스트
-static struct list sleep_list;
 /* 유휴 스레드. */
 static struct thread *idle_thread;
 
@@ -46,13 +43,9 @@ static long long idle_ticks; /* 유휴 상태로 보낸 타이머 틱 수입니
 static long long kernel_ticks; /* 커널 스레드의 타이머 틱 수입니다. */
 static long long user_ticks; /* 사용자 프로그램의 타이머 틱 수입니다. */
 
-static long long next_tick_to_awake;
-
 /* 스케줄링. */
 #define TIME_SLICE 4 /* 각 스레드에 부여할 타이머 틱 수입니다. */
 static unsigned thread_ticks; /* 마지막 양보 이후 타이머 틱 수입니다. */
-// // sleep list에서 대기중인 스레드들의 wakeup_tick 최솟값
-// static unsigned next_tick_to_awake;
 /* false(기본값)이면 라운드 로빈 스케줄러를 사용합니다.
    true이면 multi-level feedback queue scheduler를 사용합니다.
    커널 명령줄 옵션 "-o mlfqs"로 제어합니다. */
@@ -61,6 +54,7 @@ bool thread_mlfqs;
 
 static void kernel_thread (thread_func *, void *aux);
 static void idle (void *aux UNUSED);
+static void thread_wake (void *t);
 
 static struct thread *next_thread_to_run (void);
 static void init_thread (struct thread *, const char *name, int priority);
@@ -109,8 +103,6 @@ thread_init (void) {
 	lock_init (&tid_lock);
 	list_init (&ready_list);
 	list_init (&destruction_req);
-	list_init (&sleep_list);
-	next_tick_to_awake = INT64_MAX;
 
 	/* 실행 중인 스레드에 대한 스레드 구조를 설정합니다. */
 	initial_thread = running_thread ();
@@ -231,16 +223,6 @@ thread_create (const char *name, int priority,
 	return tid;
 }
 
-static bool
-thread_less (const struct list_elem *a_, const struct list_elem *b_,
-            void *aux UNUSED) 
-{
-  const struct thread *a = list_entry (a_, struct thread, elem);
-  const struct thread *b = list_entry (b_, struct thread, elem);
-  
-  return a->wakeup_tick < b->wakeup_tick;
-}
-
 static bool
 priority_more (const struct list_elem *a_, const struct list_elem *b_,
             void *aux UNUSED) 
@@ -282,7 +264,11 @@ thread_unblock (struct thread *t) {
 	t->status = THREAD_READY;
 
 	if (thread_current() != idle_thread && t->priority > thread_current()->priority) {
-		thread_yield();
+		// 인터럽트 핸들러 안에서는 양보할 수 없으므로 핸들러가 끝날 때 양보한다.
+		if (intr_context ())
+			intr_yield_on_return ();
+		else
+			thread_yield();
 	}
 	intr_set_level (old_level);
 }
@@ -415,8 +401,14 @@ idle (void *idle_started_ UNUSED) {
 	for (;;) {
 		/* Let someone else run. */
 		intr_disable ();
+		if (!list_empty (&ready_list))
+			timer_idle_exit ();
 		thread_block ();
 
+		/* Stop the periodic timer interrupt until the next sleeping
+		   thread is due, if that is a while away. */
+		timer_idle_enter ();
+
 		/* Re-enable interrupts and wait for the next one.
 
 		   The `sti' instruction disables interrupts until the
@@ -463,6 +455,7 @@ init_thread (struct thread *t, const char *name, int priority) {
 	list_init (&t->donor_list);
 	list_init (&t->child_list);
 	t->running_file = NULL;
+	timeout_init (&t->sleep_timeout, thread_wake, t);
 
 	sema_init (&t->fork_sema, 0);
 	sema_init (&t->wait_sema, 0);
@@ -647,54 +640,30 @@ allocate_tid (void) {
 	return tid;
 }
 
+// 슬립 타임아웃이 만료되면 타이머 인터럽트 핸들러가 부른다.
+static void thread_wake(void *t) {
+	thread_unblock(t);
+}
+
 void thread_sleep(int64_t ticks) {
 	struct thread *th_curr = thread_current();
-	
 	enum intr_level old_level;
-	old_level = intr_disable();
 
-	th_curr->wakeup_tick = ticks;
-	if (th_curr != idle_thread) {
-		list_insert_ordered(&sleep_list, &th_curr->elem, thread_less, NULL);
-	}
-	update_next_tick_to_awake(ticks);
-	do_schedule(THREAD_BLOCKED);
+	ASSERT (th_curr != idle_thread);
+	old_level = intr_disable();
+	// 정렬된 리스트 대신 타이머 휠에 넣으므로 O(1)이다.
+	timeout_add(&th_curr->sleep_timeout, ticks);
+	thread_block();
 	intr_set_level(old_level);
 }
 
-int64_t get_next_tick_to_awake(void) {
-	return next_tick_to_awake;
-}
-
-void update_next_tick_to_awake(int64_t ticks) {
-	next_tick_to_awake = min(next_tick_to_awake, ticks);
-}
-
-void thread_awake(int64_t ticks) {
-	struct list_elem *sleep_curr_elem = list_begin(&sleep_list);
-	struct thread *sleep_curr_t;
-	next_tick_to_awake = INT64_MAX;
-	
+void thread_sleep_ns(int64_t ns) {
+	struct thread *th_curr = thread_current();
 	enum intr_level old_level;
-	old_level = intr_disable();
 
-	while (sleep_curr_elem != list_end(&sleep_list)){
-		sleep_curr_t = list_entry(sleep_curr_elem, struct thread, elem);
-
-		if (sleep_curr_t->wakeup_tick > ticks )
-		{
-			update_next_tick_to_awake(sleep_curr_t->wakeup_tick);
-			break;
-		}
-		sleep_curr_elem = list_remove(&sleep_curr_t->elem);
-		thread_unblock(sleep_curr_t); // sleep_awake() 안의 thread_yield()를 뺐더니 깨졌던 알람 테게들이 통과했다~!
-
-		// 오류났던 코드: 
-		// thread_unblock(sleep_curr_thread);
-		// list_pop_front(&sleep_list);
-		// sleep_curr_elem = list_begin(&sleep_list);
-		// sleep_curr_thread가 여전히 sleep_list의 맨 앞 요소인 상태에서 ready_list에 list_push_back이 되어, 마치 sleep_list의 맨 앞과 ready_list의 맨 뒤가 연결되버리는 오류 상황이 발생했다.
-		// 그래서 다음 스레드에 대한 thread_awake() 수행의 thread_unblock() 중 ASSERT (t->status == THREAD_BLOCKED);에서 계속 터졌었다. 이미 ready인 상태의 스레드들이 thread_unblock()에 들어온 것.
-	}
+	ASSERT (th_curr != idle_thread);
+	old_level = intr_disable();
+	timeout_add_ns(&th_curr->sleep_timeout, ns);
+	thread_block();
 	intr_set_level(old_level);
-}
\ No newline at end of file
+}
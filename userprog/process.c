@@ -200,6 +200,10 @@ __do_fork (void *aux) {
 		}
 	}
 	current->next_fd = parent->next_fd;
+#ifdef FILESYS
+	if (parent->cwd != NULL && (current->cwd = dir_reopen (parent->cwd)) == NULL)
+		goto error;
+#endif
 	process_init ();
 
 	/* Finally, switch to the newly created process. */
@@ -307,6 +311,10 @@ process_exit (void) {
 
 	palloc_free_multiple(curr->fdt, FDT_PAGES);
 	file_close(curr->running_file);
+#ifdef FILESYS
+	dir_close (curr->cwd);
+	curr->cwd = NULL;
+#endif
 
 	process_cleanup();
 	sema_up(&curr->wait_sema); // 2. 자식 스레드의 수행 종료를 부모에게 알리는 것. wait_sema의 waiter 큐에 있던 부모가 ready list에 들어가게 되고, 현재 실행 중인 자식 스레드는 계속 자기 수행 실행.
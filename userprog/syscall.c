@@ -1,4 +1,5 @@
 #include "userprog/syscall.h"
+#include <limits.h>
 #include <stdio.h>
 #include <syscall-nr.h>
 #include "threads/interrupt.h"
@@ -10,15 +11,25 @@
 #include "filesys/filesys.h"
 #include "userprog/process.h"
 #include "filesys/file.h"
+#include "filesys/directory.h"
+#include "filesys/inode.h"
 #include "threads/synch.h"
 #include "lib/string.h"
 #include "threads/palloc.h"
+#include "devices/disk.h"
+#include "devices/input.h"
+#include "devices/timer.h"
 
 
 typedef int pid_t;
 #define PID_ERROR ((pid_t) -1)
 
-struct lock filesys_lock;
+/* lib/user/syscall.h 의 struct iovec 과 같아야 한다. */
+struct iovec {
+	void *iov_base;
+	size_t iov_len;
+};
+#define IOV_MAX 64
 
 void syscall_entry (void);
 void syscall_handler (struct intr_frame *);
@@ -52,12 +63,26 @@ unsigned tell(int fd);
 void close(int fd);
 void *mmap(void *addr, size_t length, int writable, int fd, off_t offset);
 void munmap (void *addr);
+bool chdir (const char *dir);
+bool mkdir (const char *dir);
+bool readdir (int fd, char *name);
+bool isdir (int fd);
+int inumber (int fd);
+int pread (int fd, void *buffer, unsigned size, off_t offset);
+int pwrite (int fd, const void *buffer, unsigned size, off_t offset);
+int readv (int fd, const struct iovec *iov, int iovcnt);
+int writev (int fd, const struct iovec *iov, int iovcnt);
+int sendfile (int out_fd, int in_fd, off_t *offset, unsigned count);
+int getdents (int fd, struct dirent *ents, unsigned cnt);
+int fallocate (int fd, off_t offset, off_t len);
+int symlink (const char *target, const char *linkpath);
+int link (const char *oldpath, const char *newpath);
+int disk_stats (int chan_no, int dev_no, struct disk_stats *stats);
+void check_valid_iovec(const struct iovec *iov, int iovcnt, void *rsp, bool to_write);
 static struct file * find_file_by_fd (int fd) ;
 
 void
 syscall_init (void) {
-	lock_init(&filesys_lock);
-
 	write_msr(MSR_STAR, ((uint64_t)SEL_UCSEG - 0x10) << 48  |
 			((uint64_t)SEL_KCSEG) << 32);
 	write_msr(MSR_LSTAR, (uint64_t) syscall_entry);
@@ -126,6 +151,68 @@ syscall_handler (struct intr_frame *f ) {
 		case SYS_MUNMAP:
 			munmap(f->R.rdi);
 			break;
+		case SYS_CHDIR:
+			f->R.rax = chdir((const char *) f->R.rdi);
+			break;
+		case SYS_MKDIR:
+			f->R.rax = mkdir((const char *) f->R.rdi);
+			break;
+		case SYS_READDIR:
+			check_valid_buffer((void *) f->R.rsi, NAME_MAX + 1, (void *) f->rsp, 1);
+			f->R.rax = readdir(f->R.rdi, (char *) f->R.rsi);
+			break;
+		case SYS_ISDIR:
+			f->R.rax = isdir(f->R.rdi);
+			break;
+		case SYS_INUMBER:
+			f->R.rax = inumber(f->R.rdi);
+			break;
+		case SYS_SYMLINK:
+			f->R.rax = symlink((const char *) f->R.rdi, (const char *) f->R.rsi);
+			break;
+		case SYS_LINK:
+			f->R.rax = link((const char *) f->R.rdi, (const char *) f->R.rsi);
+			break;
+		case SYS_CLOCK_NS:
+			f->R.rax = timer_ns();
+			break;
+		case SYS_DISK_STATS:
+			check_valid_buffer((void *) f->R.rdx, sizeof (struct disk_stats), (void *) f->rsp, 1);
+			f->R.rax = disk_stats(f->R.rdi, f->R.rsi, (struct disk_stats *) f->R.rdx);
+			break;
+		case SYS_PREAD:
+			check_valid_buffer((void *) f->R.rsi, f->R.rdx, (void *) f->rsp, 1);
+			f->R.rax = pread(f->R.rdi, (void *) f->R.rsi, f->R.rdx, f->R.r10);
+			break;
+		case SYS_PWRITE:
+			check_valid_buffer((void *) f->R.rsi, f->R.rdx, (void *) f->rsp, 0);
+			f->R.rax = pwrite(f->R.rdi, (const void *) f->R.rsi, f->R.rdx, f->R.r10);
+			break;
+		case SYS_READV:
+			check_valid_iovec((const struct iovec *) f->R.rsi, f->R.rdx, (void *) f->rsp, 1);
+			f->R.rax = readv(f->R.rdi, (const struct iovec *) f->R.rsi, f->R.rdx);
+			break;
+		case SYS_WRITEV:
+			check_valid_iovec((const struct iovec *) f->R.rsi, f->R.rdx, (void *) f->rsp, 0);
+			f->R.rax = writev(f->R.rdi, (const struct iovec *) f->R.rsi, f->R.rdx);
+			break;
+		case SYS_GETDENTS:
+			// 버퍼 크기가 unsigned를 넘으면 잘려서 일부만 검사되므로 거부한다.
+			if (f->R.rdx > UINT_MAX / sizeof (struct dirent)) {
+				f->R.rax = -1;
+				break;
+			}
+			check_valid_buffer((void *) f->R.rsi, f->R.rdx * sizeof (struct dirent), (void *) f->rsp, 1);
+			f->R.rax = getdents(f->R.rdi, (struct dirent *) f->R.rsi, f->R.rdx);
+			break;
+		case SYS_FALLOCATE:
+			f->R.rax = fallocate(f->R.rdi, f->R.rsi, f->R.rdx);
+			break;
+		case SYS_SENDFILE:
+			if (f->R.rdx != 0)
+				check_valid_buffer((void *) f->R.rdx, sizeof (off_t), (void *) f->rsp, 1);
+			f->R.rax = sendfile(f->R.rdi, f->R.rsi, (off_t *) f->R.rdx, f->R.r10);
+			break;
 		default:
 			printf ("system call!\n");
 			thread_exit ();		
@@ -198,6 +285,17 @@ void check_valid_buffer(void *buffer, unsigned size, void *rsp, bool to_write) {
 	}
 }
 
+/* iovec 배열과 그것이 가리키는 버퍼들을 모두 검사한다. */
+void check_valid_iovec(const struct iovec *iov, int iovcnt, void *rsp, bool to_write) {
+	if (iovcnt <= 0 || iovcnt > IOV_MAX)
+		return;
+	check_address((void *) iov);
+	check_valid_buffer((void *) iov, iovcnt * sizeof *iov, rsp, 0);
+	for (int i = 0; i < iovcnt; i++)
+		if (iov[i].iov_len > 0)
+			check_valid_buffer(iov[i].iov_base, iov[i].iov_len, rsp, to_write);
+}
+
 void halt(void) {
 	power_off();
 }
@@ -283,61 +381,62 @@ int filesize (int fd) {
 
 int read (int fd, void *buffer, unsigned size) {
 	check_address(buffer);
-	lock_acquire(&filesys_lock);
 	off_t read_size = 0;
 	char *read_buffer = (char *)buffer;
 
 	struct file *file_ptr = find_file_by_fd(fd);
+	// STDIN 표시는 NULL과 같으므로 NULL 검사보다 먼저 fd 번호로 가려낸다.
+	if (fd == 0 && file_ptr == STDIN) { // 표준 입력일 때. 키보드 입력만 받음.
+		// 줄 단위 처리는 input_read()가 한 곳에서 맡고, 한 번에 여러 바이트를 옮긴다.
+		return input_read(read_buffer, size);
+	}
 	if (file_ptr == NULL || file_ptr == STDOUT){
-		lock_release(&filesys_lock);
 		return -1;
 	}
 
-
-	if (file_ptr == STDIN) { // 표준 입력일 때. 키보드 입력만 받음.
-		while (read_size < size) {
-			char key = input_getc();
-			*read_buffer++ = key;
-			read_size++;
-			if (key == '\0'){
-				break;
-			}
-		}
-		lock_release(&filesys_lock);
-		return read_size;
+	if (inode_is_dir(file_get_inode(file_ptr))) { // 디렉터리는 read로 읽을 수 없다.
+		return -1;
 	}
 	else { // 표준 입력이 아닐 때. 즉, 파일의 데이터를 읽어온다.
 		read_size = file_read(file_ptr, read_buffer, size);
-		lock_release(&filesys_lock);
 		return read_size;
 	}
 }
 
 int write (int fd, const void *buffer, unsigned size) {
 	check_address(buffer);
-	lock_acquire(&filesys_lock);
 	off_t written_size = 0;
 	char *write_buffer = (char *)buffer;
 
 	/* STDOUT */
 	if (fd == 1) { // 표준 출력일 때. 버퍼에 쌓여있는 데이터(문자열)을 화면에 출력함.
-		putbuf(write_buffer, size);
-		lock_release(&filesys_lock);
+		// putbuf()는 인터럽트를 끈 채로 버퍼를 읽으므로, 페이지 폴트가 날 수 있는
+		// 사용자 메모리 대신 커널 페이지에 한 페이지씩 옮겨서 넘긴다.
+		char *kbuf = palloc_get_page(0);
+		if (kbuf == NULL)
+			return -1;
+		for (unsigned done = 0; done < size; ) {
+			unsigned chunk = size - done < PGSIZE ? size - done : PGSIZE;
+			memcpy(kbuf, write_buffer + done, chunk);
+			putbuf(kbuf, chunk);
+			done += chunk;
+		}
+		palloc_free_page(kbuf);
 		return size;
 	}
 	else { // 표준 출력이 아닐 때. 버퍼에 쌓여있는 데이터(문자열)를 파일에 기록한다.
 		struct file *file_ptr = find_file_by_fd(fd);
 		// 아래의 예외처리는 틀렸다. write()의 경우 file_ptr가 NULL인 것이 논리적으로 다분히 가능하기 때문이다.
 		if (file_ptr == NULL){
-			lock_release(&filesys_lock);
 			exit(-1);
 		}
+		if (inode_is_dir(file_get_inode(file_ptr))) { // 디렉터리에는 쓸 수 없다.
+			return -1;
+		}
 		written_size = file_write(file_ptr, write_buffer, size);
 		if (written_size < 0) {
-			lock_release(&filesys_lock);
 			exit(-1);
 		}
-		lock_release(&filesys_lock);
 		return written_size;
 	}
 }
@@ -376,6 +475,233 @@ void close(int fd)
 	file_close(fileobj);
 }
 
+bool chdir (const char *dir) {
+	check_address((void *) dir);
+	return filesys_chdir(dir);
+}
+
+bool mkdir (const char *dir) {
+	check_address((void *) dir);
+	return filesys_mkdir(dir);
+}
+
+bool readdir (int fd, char *name) {
+	check_address(name);
+	struct file *file_ptr = find_file_by_fd(fd);
+	if (file_ptr == NULL || !inode_is_dir(file_get_inode(file_ptr)))
+		return false;
+
+	// 디렉터리 안에서의 위치는 file의 pos에 저장해 둔다.
+	struct dir *dir = dir_open(inode_reopen(file_get_inode(file_ptr)));
+	if (dir == NULL)
+		return false;
+	dir_seek(dir, file_tell(file_ptr));
+	// 이름은 커널 버퍼에 받은 뒤, 파일 시스템의 락을 모두 놓고 나서 옮긴다.
+	char kname[NAME_MAX + 1];
+	bool success = dir_readdir(dir, kname);
+	file_seek(file_ptr, dir_tell(dir));
+	dir_close(dir);
+	if (success)
+		memcpy(name, kname, strlen(kname) + 1);
+	return success;
+}
+
+// readdir()과 같지만 한 번에 CNT개까지 읽는다.
+int getdents (int fd, struct dirent *ents, unsigned cnt) {
+	check_address(ents);
+	struct file *file_ptr = find_file_by_fd(fd);
+	if (file_ptr == NULL || !inode_is_dir(file_get_inode(file_ptr)))
+		return -1;
+
+	struct dir *dir = dir_open(inode_reopen(file_get_inode(file_ptr)));
+	if (dir == NULL)
+		return -1;
+	dir_seek(dir, file_tell(file_ptr));
+	int read_cnt = dir_read_entries(dir, ents, cnt);
+	file_seek(file_ptr, dir_tell(dir));
+	dir_close(dir);
+	return read_cnt;
+}
+
+bool isdir (int fd) {
+	struct file *file_ptr = find_file_by_fd(fd);
+	if (file_ptr == NULL)
+		return false;
+	return inode_is_dir(file_get_inode(file_ptr));
+}
+
+int inumber (int fd) {
+	struct file *file_ptr = find_file_by_fd(fd);
+	if (file_ptr == NULL)
+		return -1;
+	return inode_get_inumber(file_get_inode(file_ptr));
+}
+
+int pread (int fd, void *buffer, unsigned size, off_t offset) {
+	check_address(buffer);
+	struct file *file_ptr = find_file_by_fd(fd);
+	// 표준 입출력과 디렉터리는 위치를 지정해서 읽을 수 없다.
+	if (file_ptr == NULL || offset < 0
+			|| inode_is_dir(file_get_inode(file_ptr)))
+		return -1;
+	// file_read_at()은 파일의 현재 위치를 바꾸지 않는다.
+	return file_read_at(file_ptr, buffer, size, offset);
+}
+
+int pwrite (int fd, const void *buffer, unsigned size, off_t offset) {
+	check_address((void *) buffer);
+	struct file *file_ptr = find_file_by_fd(fd);
+	if (file_ptr == NULL || offset < 0
+			|| inode_is_dir(file_get_inode(file_ptr)))
+		return -1;
+	return file_write_at(file_ptr, buffer, size, offset);
+}
+
+// 버퍼마다 read()를 부르므로 표준 입력과 파일 모두 읽을 수 있고,
+// 파일의 위치는 읽은 만큼 나아간다. 파일 끝에 닿으면 멈춘다.
+int readv (int fd, const struct iovec *iov, int iovcnt) {
+	int total = 0;
+
+	if (iovcnt <= 0 || iovcnt > IOV_MAX)
+		return -1;
+	for (int i = 0; i < iovcnt; i++) {
+		if (iov[i].iov_len == 0)
+			continue;
+		int n = read(fd, iov[i].iov_base, iov[i].iov_len);
+		if (n < 0)
+			return total > 0 ? total : -1;
+		total += n;
+		if ((size_t) n < iov[i].iov_len)
+			break;
+	}
+	return total;
+}
+
+int writev (int fd, const struct iovec *iov, int iovcnt) {
+	int total = 0;
+
+	if (iovcnt <= 0 || iovcnt > IOV_MAX)
+		return -1;
+	for (int i = 0; i < iovcnt; i++) {
+		if (iov[i].iov_len == 0)
+			continue;
+		int n = write(fd, iov[i].iov_base, iov[i].iov_len);
+		if (n < 0)
+			return total > 0 ? total : -1;
+		total += n;
+		if ((size_t) n < iov[i].iov_len)
+			break;
+	}
+	return total;
+}
+
+// in_fd 의 데이터를 커널 안에서 한 페이지씩 out_fd 로 옮긴다.
+// 사용자 버퍼를 거치지 않으므로 바이트 단위 검사도 없다.
+// offset 이 NULL 이면 in_fd 의 현재 위치부터 읽고 그 위치를 옮기며,
+// 아니면 *offset 부터 읽고 *offset 을 갱신한다.
+int sendfile (int out_fd, int in_fd, off_t *offset, unsigned count) {
+	struct file *in = find_file_by_fd(in_fd);
+	struct file *out = NULL;
+
+	if (in == NULL || inode_is_dir(file_get_inode(in)))
+		return -1;
+	if (out_fd != 1) { // 표준 출력이 아니면 파일에 쓴다.
+		out = find_file_by_fd(out_fd);
+		if (out == NULL || inode_is_dir(file_get_inode(out)))
+			return -1;
+	}
+
+	off_t pos = offset != NULL ? *offset : file_tell(in);
+	if (pos < 0)
+		return -1;
+	char *buffer = palloc_get_page(0);
+	if (buffer == NULL)
+		return -1;
+
+	int total = 0;
+	while (count > 0) {
+		int chunk = count < PGSIZE ? count : PGSIZE;
+		int read_size = file_read_at(in, buffer, chunk, pos);
+		if (read_size <= 0)
+			break;
+
+		int written_size = read_size;
+		if (out == NULL)
+			putbuf(buffer, read_size);
+		else
+			written_size = file_write(out, buffer, read_size);
+
+		pos += written_size;
+		total += written_size;
+		count -= written_size;
+		if (written_size < read_size)
+			break;
+	}
+	palloc_free_page(buffer);
+
+	if (offset != NULL)
+		*offset = pos;
+	else
+		file_seek(in, pos);
+	return total;
+}
+
+// OFFSET 부터 LEN 바이트 중 비어 있는 곳에 연속된 섹터를 미리 할당한다.
+// 0을 쓰지 않고 "아직 쓰지 않음"으로 표시만 하며, 필요하면 파일을 늘린다.
+int fallocate (int fd, off_t offset, off_t len) {
+	struct file *file_ptr = find_file_by_fd(fd);
+	if (file_ptr == NULL || inode_is_dir(file_get_inode(file_ptr)))
+		return -1;
+	return inode_preallocate(file_get_inode(file_ptr), offset, len) ? 0 : -1;
+}
+
+// LINKPATH에 TARGET을 가리키는 심볼릭 링크를 만든다. TARGET은 없어도 된다.
+// TARGET은 널 문자까지 한 페이지 안에 들어가야 하며, 한 바이트씩 검사한 뒤
+// 커널 페이지로 복사해서 넘긴다.
+int symlink (const char *target, const char *linkpath) {
+	check_address((void *) linkpath);
+	size_t len = 0;
+	for (;;) {
+		check_address((void *) (target + len));
+		check_valid_buffer((void *) (target + len), 1, NULL, 0);
+		if (target[len] == '\0')
+			break;
+		if (++len == PGSIZE)
+			return -1;
+	}
+
+	char *copy = palloc_get_page(0);
+	if (copy == NULL)
+		return -1;
+	memcpy(copy, target, len + 1);
+	int result = filesys_symlink(copy, linkpath) ? 0 : -1;
+	palloc_free_page(copy);
+	return result;
+}
+
+// OLDPATH 파일에 NEWPATH라는 이름을 하나 더 붙인다. 디렉터리는 안 된다.
+int link (const char *oldpath, const char *newpath) {
+	check_address((void *) oldpath);
+	check_address((void *) newpath);
+	return filesys_link(oldpath, newpath) ? 0 : -1;
+}
+
+// CHAN_NO번 채널의 DEV_NO번 디스크의 통계를 STATS에 복사한다.
+// 디스크가 없으면 -1을 돌려준다.
+// disk_get_stats()는 인터럽트를 끈 채로 복사하므로, 페이지 폴트가 날 수 있는
+// 사용자 메모리 대신 커널 스택에 받은 뒤 옮긴다.
+int disk_stats (int chan_no, int dev_no, struct disk_stats *stats) {
+	if (chan_no < 0 || (dev_no != 0 && dev_no != 1))
+		return -1;
+	struct disk *d = disk_get(chan_no, dev_no);
+	if (d == NULL)
+		return -1;
+	struct disk_stats copy;
+	disk_get_stats(d, &copy);
+	memcpy(stats, &copy, sizeof copy);
+	return 0;
+}
+
 int add_file_to_fdt (struct file *file) {
 	struct thread *curr  = thread_current();
 	struct file **fdt = curr->fdt;
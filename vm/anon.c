@@ -1,9 +1,13 @@
 /* anon.c: Implementation of page for non-disk image (a.k.a. anonymous page). */
 
 #include "vm/vm.h"
+#include <stdlib.h>
 #include "devices/disk.h"
 #include "lib/string.h"
 #include "lib/kernel/bitmap.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
 
 
 /* DO NOT MODIFY BELOW LINE */
@@ -26,14 +30,139 @@ static const struct page_operations anon_ops = {
 struct bitmap *swap_table;
 int bitcnt;
 const size_t SECTORS_PER_PAGE = PGSIZE/DISK_SECTOR_SIZE;
-/* Initialize the data for anonymous pages */
 
+/* 스왑 디스크들. -swap=CH:DEV,... 옵션으로 여러 개를 주면 슬롯을 디스크들에
+   번갈아 놓아서(striping) 연속된 스왑 I/O가 여러 디스크에 나뉘어 동시에
+   진행된다. 옵션이 없으면 hd1:1 하나만 쓴다. */
+#define SWAP_DISKS_MAX 4
+static struct disk *swap_disks[SWAP_DISKS_MAX];
+static size_t swap_disk_cnt;
+const char *swap_disk_list;
+
+/* 진행 중인 스왑 아웃 쓰기.
+   페이지 내용을 커널 풀의 페이지에 복사한 뒤 쓰기를 디스크 큐에 넣고 바로
+   돌아오므로, 프레임은 곧바로 다른 페이지가 쓸 수 있고 그 페이지를 읽어오는
+   I/O(파일 시스템 디스크일 수도 있음)가 이 쓰기와 동시에 진행된다. */
+struct swap_write {
+	struct disk_request request;
+	struct list_elem elem;
+	size_t slot;            /* 쓰는 슬롯 */
+	void *data;             /* 페이지 내용 사본 */
+	bool written;           /* 쓰기가 끝났는가? (인터럽트 핸들러가 설정) */
+	bool swapped_in;        /* 끝나기 전에 다시 읽혀서 슬롯이 비었는가? */
+};
+
+/* 동시에 진행할 수 있는 스왑 아웃 쓰기 수. 사본이 커널 풀을 쓰므로 제한한다. */
+#define SWAP_WRITES_MAX 16
+static struct list swap_writes;
+static size_t swap_write_cnt;
+
+/* swap_table과 swap_writes를 보호한다. */
+static struct lock swap_lock;
+
+/* Parses "CH:DEV" in STR into the disk it names, or returns a null
+   pointer if it names no disk. */
+static struct disk *
+parse_swap_disk (const char *str) {
+	const char *colon = strchr (str, ':');
+
+	if (colon == NULL)
+		return NULL;
+	return disk_get (atoi (str), atoi (colon + 1));
+}
+
+/* Initialize the data for anonymous pages */
 void
 vm_anon_init (void) {
 	/* TODO: Set up the swap_disk. */
 	swap_disk = disk_get(1,1);
-	size_t swap_size = disk_size(swap_disk) / SECTORS_PER_PAGE;
-	swap_table = bitmap_create(swap_size);
+	if (swap_disk_list != NULL) {
+		char list[32];
+		char *name, *save_ptr;
+
+		strlcpy (list, swap_disk_list, sizeof list);
+		for (name = strtok_r (list, ",", &save_ptr); name != NULL;
+				name = strtok_r (NULL, ",", &save_ptr)) {
+			struct disk *d = parse_swap_disk (name);
+			if (d == NULL)
+				PANIC ("no swap disk %s", name);
+			if (swap_disk_cnt < SWAP_DISKS_MAX)
+				swap_disks[swap_disk_cnt++] = d;
+		}
+		swap_disk = swap_disks[0];
+	} else if (swap_disk != NULL)
+		swap_disks[swap_disk_cnt++] = swap_disk;
+
+	/* 슬롯 i는 디스크 i % swap_disk_cnt에 있으므로 가장 작은 디스크에
+	   맞춘다. */
+	size_t swap_size = 0;
+	for (size_t i = 0; i < swap_disk_cnt; i++) {
+		size_t pages = disk_size(swap_disks[i]) / SECTORS_PER_PAGE;
+		if (i == 0 || pages < swap_size)
+			swap_size = pages;
+	}
+	for (size_t i = 0; i < swap_disk_cnt; i++)
+		disk_set_user(swap_disks[i], DISK_USER_SWAP);
+	swap_table = bitmap_create(swap_size * swap_disk_cnt);
+	list_init(&swap_writes);
+	swap_write_cnt = 0;
+	lock_init(&swap_lock);
+}
+
+/* 슬롯 SLOT이 있는 디스크 */
+static struct disk *
+slot_disk (size_t slot) {
+	return swap_disks[slot % swap_disk_cnt];
+}
+
+/* 슬롯 SLOT이 디스크에서 시작하는 섹터 */
+static disk_sector_t
+slot_sector (size_t slot) {
+	return slot / swap_disk_cnt * SECTORS_PER_PAGE;
+}
+
+/* 스왑 아웃 쓰기가 끝났을 때 인터럽트 핸들러에서 불린다. */
+static void
+swap_write_done (struct disk_request *r UNUSED, void *w_) {
+	struct swap_write *w = w_;
+	w->written = true;
+}
+
+/* 끝난 스왑 아웃 쓰기들을 정리한다. 쓰는 도중에 다시 읽혀 간 슬롯은
+   이제야 비운다. 그 전에 비우면 새 쓰기가 같은 슬롯에 들어가서 디스크
+   큐에서 옛 쓰기보다 먼저 처리될 수 있다. swap_lock을 잡고 호출한다. */
+static void
+reap_swap_writes (void) {
+	struct list_elem *e = list_begin(&swap_writes);
+
+	while (e != list_end(&swap_writes)) {
+		struct swap_write *w = list_entry(e, struct swap_write, elem);
+
+		if (!w->written) {
+			e = list_next(e);
+			continue;
+		}
+		e = list_remove(e);
+		if (w->swapped_in)
+			bitmap_reset(swap_table, w->slot);
+		palloc_free_page(w->data);
+		free(w);
+		swap_write_cnt--;
+	}
+}
+
+/* 슬롯 SLOT에 아직 진행 중인 쓰기를 찾는다. swap_lock을 잡고 호출한다. */
+static struct swap_write *
+find_swap_write (size_t slot) {
+	struct list_elem *e;
+
+	for (e = list_begin(&swap_writes); e != list_end(&swap_writes);
+			e = list_next(e)) {
+		struct swap_write *w = list_entry(e, struct swap_write, elem);
+		if (w->slot == slot && !w->swapped_in)
+			return w;
+	}
+	return NULL;
 }
 
 bool
@@ -60,15 +189,32 @@ anon_swap_in (struct page *page, void *kva) {
 	// 스왑 아웃을 할 때 저장해 두었던 섹터(슬롯)를 가져옴
 	int empty_slot = anon_page->swap_sector;
 
+	lock_acquire(&swap_lock);
+	reap_swap_writes();
+
 	// 스왑테이블에 해당 슬롯(섹터)가 있는지 확인
-	if (bitmap_test(swap_table, empty_slot) == false)
+	if (bitmap_test(swap_table, empty_slot) == false) {
+		lock_release(&swap_lock);
 		return false;
-	
-	for (int i = 0; i < SECTORS_PER_PAGE; i++)
-	{
-		disk_read(swap_disk, empty_slot * SECTORS_PER_PAGE + i, kva + DISK_SECTOR_SIZE *i);
 	}
+
+	// 아직 쓰는 중이면 디스크까지 갈 필요 없이 사본에서 가져온다.
+	struct swap_write *w = find_swap_write(empty_slot);
+	if (w != NULL) {
+		memcpy(kva, w->data, PGSIZE);
+		w->swapped_in = true;
+		lock_release(&swap_lock);
+		return true;
+	}
+	lock_release(&swap_lock);
+
+	// 한 페이지의 섹터들은 연속되어 있으므로 명령 하나로 읽는다.
+	// 슬롯은 읽는 동안 사용 중으로 남아 있으므로 잠금 없이 읽어도 된다.
+	disk_read_multiple(slot_disk(empty_slot), slot_sector(empty_slot), kva, SECTORS_PER_PAGE);
+
+	lock_acquire(&swap_lock);
 	bitmap_set(swap_table, empty_slot, false);
+	lock_release(&swap_lock);
 
 	return true;
 }
@@ -78,9 +224,13 @@ static bool
 anon_swap_out (struct page *page) {
 	struct anon_page *anon_page = &page->anon;
 
-	int empty_slot = bitmap_scan (swap_table, 0, 1, false);
+	lock_acquire(&swap_lock);
+	reap_swap_writes();
+
+	size_t empty_slot = bitmap_scan_and_flip (swap_table, 0, 1, false);
 
 	if ((empty_slot) == BITMAP_ERROR) {
+		lock_release(&swap_lock);
         return false;
     }
     /* 
@@ -89,17 +239,45 @@ anon_swap_out (struct page *page) {
 	SECTORS_PER_PAGE = PGSIZE / DISK_SECTOR_SIZE; 8 = 4096 / 512
 	swap_size = disk_size(swap_disk)/SECTORS_PER_PAGE; 
     */
-   	for (int i = 0; i<SECTORS_PER_PAGE; i++){
-		disk_write(swap_disk, empty_slot*SECTORS_PER_PAGE+i, page->va+DISK_SECTOR_SIZE*i);
+	/* 쓰기가 너무 많이 밀려 있으면 가장 오래된 것이 끝나기를 기다린다. */
+	if (swap_write_cnt >= SWAP_WRITES_MAX) {
+		struct swap_write *oldest = list_entry(list_front(&swap_writes),
+				struct swap_write, elem);
+		disk_wait(&oldest->request);
+		reap_swap_writes();
+	}
+
+	/* 사본을 떠서 쓰기를 큐에 넣고 기다리지 않는다. 사본을 만들 메모리가
+	   없으면 프레임에서 바로 쓰고 끝날 때까지 기다린다.
+	   프레임의 커널 주소로 써야 디스크가 DMA로 읽을 수 있고,
+	   다른 프로세스의 페이지를 내보낼 때도 올바른 내용을 쓴다. */
+	struct swap_write *w = malloc(sizeof *w);
+	void *data = palloc_get_page(0);
+	if (w != NULL && data != NULL) {
+		memcpy(data, page->frame->kva, PGSIZE);
+		w->slot = empty_slot;
+		w->data = data;
+		w->written = false;
+		w->swapped_in = false;
+		disk_request_init(&w->request, slot_disk(empty_slot), slot_sector(empty_slot), data, SECTORS_PER_PAGE, true);
+		disk_submit(&w->request, swap_write_done, w);
+		list_push_back(&swap_writes, &w->elem);
+		swap_write_cnt++;
+	} else {
+		free(w);
+		if (data != NULL)
+			palloc_free_page(data);
+		disk_write_multiple(slot_disk(empty_slot), slot_sector(empty_slot), page->frame->kva, SECTORS_PER_PAGE);
 	}
+	lock_release(&swap_lock);
 
     /*
-    swap table의 해당 페이지에 대한 swap slot의 비트를 true로 바꿔주고
+    swap slot의 비트는 위에서 true로 바꿨다.
     해당 페이지의 PTE에서 present bit을 0으로 바꿔준다.
     이제 프로세스가 이 페이지에 접근하면 page fault가 뜬다.
+    내보내는 스레드가 아니라 페이지 주인의 페이지 테이블에서 지워야 한다.
     */
-	bitmap_set(swap_table,empty_slot, true);
-	pml4_clear_page(thread_current()->pml4, page->va);
+	pml4_clear_page(page->owner->pml4, page->va);
 
 	/* 페이지의 swap_index 값을 이 페이지가 저장된 swap slot의 번호로 써준다.*/
 	anon_page->swap_sector = empty_slot;
@@ -110,4 +288,11 @@ anon_swap_out (struct page *page) {
 static void
 anon_destroy (struct page *page) {
 	struct anon_page *anon_page = &page->anon;
+
+	/* frame table에서도 빼줘야 evict할 때 해제된 page를 보지 않음.
+	   swap out된 page의 frame은 이미 다른 page가 쓰고 있을 수 있음 */
+	if (page->frame != NULL && page->frame->page == page) {
+		pml4_clear_page(page->owner->pml4, page->va);
+		vm_frame_free(page->frame);
+	}
 }
@@ -32,6 +32,21 @@ file_backed_initializer (struct page *page, enum vm_type type, void *kva) {
 	page->operations = &file_ops;
 
 	struct file_page *file_page = &page->file;
+	return true;
+}
+
+/* Maps PAGE to the page cache's copy of its part of the file,
+ * reading it in if it is not cached yet.  The mapping is shared with
+ * every other process that maps the same part of the file and with
+ * read() and write() on it. */
+bool
+file_backed_claim (struct page *page) {
+	/* uninit.aux에 있는 segment는 초기화 후에도 그대로 남아 있음 */
+	struct segment *seg = (struct segment*)page->uninit.aux;
+
+	if (VM_TYPE(page->operations->type) == VM_UNINIT)
+		file_backed_initializer(page, VM_FILE, NULL);
+	return page_cache_map(page, file_get_inode(seg->file), seg->offset);
 }
 
 /* Swap in the page by read contents from the file. */
@@ -68,22 +83,8 @@ file_backed_swap_in (struct page *page, void *kva) {
 /* Swap out the page by writeback contents to the file. */
 static bool
 file_backed_swap_out (struct page *page) {
-	struct thread *curr = thread_current();
-	
-	struct file_page *file_page UNUSED = &page->file;
-	
-	if (page == NULL)
-		return NULL;
-	struct segment *seg = (struct segment*)page->uninit.aux;
-
-	if (pml4_is_dirty(curr->pml4, page->va)){
-		
-		file_write_at(seg->file, page->va, seg->read_bytes, seg->offset);
-
-		pml4_set_dirty(curr->pml4, page->va, 0);
-	}
-
-	pml4_clear_page(curr->pml4, page->va);
+	/* 프레임은 page cache 소유이므로 매핑만 끊고, 수정된 내용은 기록 */
+	page_cache_unmap(page);
 	return true;
 }
 
@@ -91,6 +92,7 @@ file_backed_swap_out (struct page *page) {
 static void
 file_backed_destroy (struct page *page) {
 	struct file_page *file_page UNUSED = &page->file;
+	page_cache_unmap(page);
 }
 
 /* Do the mmap */
@@ -149,19 +151,13 @@ do_munmap (void *addr) {
 		struct page *page = spt_find_page(&curr->spt, addr);
 		// 페이지가 없다면 do_munmap 함수 종료, 이게 while 문 종료 조건
 		if (page == NULL)
-			return NULL;
-		//unitit.aux에는 페이지 할당시 사용된 struct segment 가 있음. -> 해제할 페이지의 정보를 얻기위한 구조체
-		struct segment *seg = (struct segment*)page->uninit.aux;
-
-		//메모리에서 해제할 페이지의 dirt bit이 1인지 확인
-		if (pml4_is_dirty(curr->pml4, page->va)){
-			// 변경사항을 디스크 파일에 업데이트
-			file_write_at(seg->file, addr, seg->read_bytes, seg->offset);
-			// dirty bit 를 다시 0으로 바꿔 줌
-			pml4_set_dirty(curr->pml4, page->va, 0);
-		}
-		// 페이지를 pml4에서 삭제
-		pml4_clear_page(curr->pml4, page->va);
+			return;
+		// mmap된 페이지가 아니면 여기서 끝
+		if (page_get_type(page) != VM_FILE)
+			return;
+		// 수정된 내용은 파일에 기록하고 page cache 매핑을 끊음
+		if (VM_TYPE(page->operations->type) == VM_FILE)
+			page_cache_unmap(page);
 		// 다음 페이지로 이동
 		addr += PGSIZE;
 	}